@@ -112,8 +112,26 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
   MmcHostInstance->BlockIo.WriteBlocks = MmcWriteBlocks;
   MmcHostInstance->BlockIo.FlushBlocks = MmcFlushBlocks;
 
+  MmcHostInstance->BlockIo2.Media = MmcHostInstance->BlockIo.Media;
+  MmcHostInstance->BlockIo2.Reset = MmcResetEx;
+  MmcHostInstance->BlockIo2.ReadBlocksEx = MmcReadBlocksEx;
+  MmcHostInstance->BlockIo2.WriteBlocksEx = MmcWriteBlocksEx;
+  MmcHostInstance->BlockIo2.FlushBlocksEx = MmcFlushBlocksEx;
+
   MmcHostInstance->MmcHost = MmcHost;
 
+  // Timer serving the non-blocking BlockIo2 requests, armed while any is queued
+  InitializeListHead (&MmcHostInstance->RequestQueue);
+  Status = gBS->CreateEvent (
+                EVT_NOTIFY_SIGNAL | EVT_TIMER,
+                TPL_CALLBACK,
+                MmcProcessRequests,
+                MmcHostInstance,
+                &MmcHostInstance->RequestEvent);
+  if (EFI_ERROR (Status)) {
+    goto FREE_MEDIA;
+  }
+
   // Create DevicePath for the new MMC Host
   Status = MmcHost->BuildDevicePath (MmcHost, &NewDevicePathNode);
   if (EFI_ERROR (Status)) {
@@ -132,6 +150,7 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
   Status = gBS->InstallMultipleProtocolInterfaces (
                 &MmcHostInstance->MmcHandle,
                 &gEfiBlockIoProtocolGuid,&MmcHostInstance->BlockIo,
+                &gEfiBlockIo2ProtocolGuid,&MmcHostInstance->BlockIo2,
                 &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
                 NULL
                 );
@@ -145,6 +164,9 @@ FREE_DEVICE_PATH:
   FreePool(DevicePath);
 
 FREE_MEDIA:
+  if (MmcHostInstance->RequestEvent != NULL) {
+    gBS->CloseEvent (MmcHostInstance->RequestEvent);
+  }
   FreePool(MmcHostInstance->BlockIo.Media);
 
 FREE_INSTANCE:
@@ -159,10 +181,15 @@ EFI_STATUS DestroyMmcHostInstance (
 {
   EFI_STATUS Status;
 
+  // Drop whatever is still queued
+  MmcAbortRequests (MmcHostInstance, EFI_ABORTED);
+  gBS->CloseEvent (MmcHostInstance->RequestEvent);
+
   // Uninstall Protocol Interfaces
   Status = gBS->UninstallMultipleProtocolInterfaces (
         MmcHostInstance->MmcHandle,
         &gEfiBlockIoProtocolGuid,&(MmcHostInstance->BlockIo),
+        &gEfiBlockIo2ProtocolGuid,&(MmcHostInstance->BlockIo2),
         &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
         NULL
         );
@@ -362,6 +389,9 @@ CheckCardsCallback (
     ASSERT(MmcHostInstance != NULL);
 
     if (MmcHostInstance->MmcHost->IsCardPresent (MmcHostInstance->MmcHost) == !MmcHostInstance->Initialized) {
+      // Requests queued for the previous media cannot complete
+      MmcAbortRequests (MmcHostInstance, EFI_NO_MEDIA);
+
       MmcHostInstance->State = MmcHwInitializationState;
       MmcHostInstance->BlockIo.Media->MediaPresent = !MmcHostInstance->Initialized;
       MmcHostInstance->Initialized = !MmcHostInstance->Initialized;
@@ -380,6 +410,17 @@ CheckCardsCallback (
       if (EFI_ERROR(Status)) {
         Print(L"MMC Card: Error reinstalling BlockIo interface\n");
       }
+
+      Status = gBS->ReinstallProtocolInterface (
+                    (MmcHostInstance->MmcHandle),
+                    &gEfiBlockIo2ProtocolGuid,
+                    &(MmcHostInstance->BlockIo2),
+                    &(MmcHostInstance->BlockIo2)
+                    );
+
+      if (EFI_ERROR(Status)) {
+        Print(L"MMC Card: Error reinstalling BlockIo2 interface\n");
+      }
     }
 
     CurrentLink = CurrentLink->ForwardLink;
@@ -20,6 +20,7 @@
 
 #include <Protocol/DiskIo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/MmcHost.h>
 
@@ -31,6 +32,7 @@
 
 #define MMC_IOBLOCKS_READ       0
 #define MMC_IOBLOCKS_WRITE      1
+#define MMC_IOBLOCKS_FLUSH      2
 
 #define MMC_OCR_POWERUP             0x80000000
 
@@ -138,6 +140,7 @@ typedef struct  {
   OCR       OCRData;
   CID       CIDData;
   CSD       CSDData;
+  BOOLEAN   SetBlockCount;  // Card takes CMD23 ahead of CMD18/CMD25
 } CARD_INFO;
 
 typedef struct _MMC_HOST_INSTANCE {
@@ -148,16 +151,39 @@ typedef struct _MMC_HOST_INSTANCE {
 
   MMC_STATE                 State;
   EFI_BLOCK_IO_PROTOCOL     BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL    BlockIo2;
   CARD_INFO                 CardInfo;
   EFI_MMC_HOST_PROTOCOL     *MmcHost;
 
   BOOLEAN                   Initialized;
+
+  // Non-blocking BlockIo2 requests, served by RequestEvent
+  LIST_ENTRY                RequestQueue;
+  EFI_EVENT                 RequestEvent;
 } MMC_HOST_INSTANCE;
 
 #define MMC_HOST_INSTANCE_SIGNATURE                 SIGNATURE_32('m', 'm', 'c', 'h')
 #define MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(a)     CR (a, MMC_HOST_INSTANCE, BlockIo, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(a)    CR (a, MMC_HOST_INSTANCE, BlockIo2, MMC_HOST_INSTANCE_SIGNATURE)
 #define MMC_HOST_INSTANCE_FROM_LINK(a)              CR (a, MMC_HOST_INSTANCE, Link, MMC_HOST_INSTANCE_SIGNATURE)
 
+typedef struct {
+  UINTN                     Signature;
+  LIST_ENTRY                Link;
+  EFI_BLOCK_IO2_TOKEN       *Token;
+  UINTN                     Transfer;
+  UINT32                    MediaId;
+  EFI_LBA                   Lba;          // Next block to transfer
+  UINTN                     BufferSize;   // Bytes left to transfer
+  VOID                      *Buffer;
+} MMC_IO2_REQUEST;
+
+#define MMC_IO2_REQUEST_SIGNATURE                   SIGNATURE_32('m', 'm', 'c', 'r')
+#define MMC_IO2_REQUEST_FROM_LINK(a)                CR (a, MMC_IO2_REQUEST, Link, MMC_IO2_REQUEST_SIGNATURE)
+
+// Period of the BlockIo2 request timer, in 100ns units (1ms)
+#define MMC_IO2_REQUEST_PERIOD                      10000
+
 
 EFI_STATUS
 EFIAPI
@@ -303,6 +329,165 @@ MmcFlushBlocks (
   IN EFI_BLOCK_IO_PROTOCOL  *This
   );
 
+/**
+  Reset the block device hardware.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.Reset(). Pending
+  non-blocking requests are aborted.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  ExtendedVerification   Indicates that the driver may perform a more exhaustive
+                                 verification operation of the device during reset.
+
+  @retval EFI_SUCCESS            The device was reset.
+  @retval EFI_DEVICE_ERROR       The device is not functioning properly and could not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  );
+
+/**
+  Read BufferSize bytes from Lba into Buffer.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx(). When
+  Token->Event is not NULL the request is queued, and the event is signaled
+  once it has been transferred.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                Id of the media, changes every time the media is replaced.
+  @param  Lba                    The starting Logical Block Address to read from.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             Size of Buffer, must be a multiple of device block size.
+  @param  Buffer                 A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS            The read request was queued if Token->Event is not NULL,
+                                 or the data was read correctly from the device.
+  @retval EFI_DEVICE_ERROR       The device reported an error while performing the read.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER  The read request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                   *Buffer
+  );
+
+/**
+  Write BufferSize bytes from Buffer to Lba.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx(). When
+  Token->Event is not NULL the request is queued, and the event is signaled
+  once it has been transferred.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                The media ID that the write request is for.
+  @param  Lba                    The starting logical block address to be written.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             Size of Buffer, must be a multiple of device block size.
+  @param  Buffer                 A pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS            The write request was queued if Token->Event is not NULL,
+                                 or the data was written correctly to the device.
+  @retval EFI_WRITE_PROTECTED    The device can not be written to.
+  @retval EFI_DEVICE_ERROR       The device reported an error while performing the write.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER  The write request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  );
+
+/**
+  Flush the Block Device.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx(). When
+  Token->Event is not NULL the event is signaled once the requests queued
+  before the flush have been transferred.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  Token                  A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS            The flush request was queued if Token->Event is not NULL,
+                                 or all outstanding data was written to the device.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
+/**
+  Timer notification serving the queued BlockIo2 requests of a card.
+
+  @param  Event                  The request timer event.
+  @param  Context                The MMC_HOST_INSTANCE the requests were queued on.
+
+**/
+VOID
+EFIAPI
+MmcProcessRequests (
+  IN EFI_EVENT              Event,
+  IN VOID                   *Context
+  );
+
+/**
+  Complete every queued BlockIo2 request of a card with the given status.
+
+  @param  MmcHostInstance        The card whose requests are dropped.
+  @param  Status                 The TransactionStatus the tokens are completed with.
+
+**/
+VOID
+MmcAbortRequests (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN EFI_STATUS             Status
+  );
+
+EFI_STATUS
+MmcIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  );
+
+UINTN
+MmcGetMaxBlockCount (
+  IN EFI_MMC_HOST_PROTOCOL  *MmcHost
+  );
+
 EFI_STATUS
 MmcNotifyState (
   IN MMC_HOST_INSTANCE      *MmcHostInstance,
@@ -126,6 +126,28 @@ MmcStopTransmission (
 #define MMCI0_BLOCKLEN 512
 #define MMCI0_TIMEOUT  10000
 
+// CMD23 carries the block count in bits [15:0].
+#define MMC_MAX_SET_BLOCK_COUNT  0xFFFF
+
+/**
+  Return the number of blocks the host moves with a single command.
+**/
+UINTN
+MmcGetMaxBlockCount (
+  IN EFI_MMC_HOST_PROTOCOL  *MmcHost
+  )
+{
+  UINTN  MaxBlockCount;
+
+  MaxBlockCount = 1;
+  if (MMC_HOST_HAS_GETMAXBLOCKCOUNT (MmcHost)) {
+    MaxBlockCount = MIN (MmcHost->GetMaxBlockCount (MmcHost), MMC_MAX_SET_BLOCK_COUNT);
+    MaxBlockCount = MAX (MaxBlockCount, 1);
+  }
+
+  return MaxBlockCount;
+}
+
 EFI_STATUS
 MmcIoBlocks (
   IN EFI_BLOCK_IO_PROTOCOL    *This,
@@ -145,6 +167,8 @@ MmcIoBlocks (
   EFI_MMC_HOST_PROTOCOL   *MmcHost;
   UINTN                   BytesRemainingToBeTransfered;
   UINTN                   BlockCount;
+  UINTN                   MaxBlockCount;
+  UINTN                   TransferSize;
 
   BlockCount = 1;
   MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
@@ -189,9 +213,15 @@ MmcIoBlocks (
     return EFI_INVALID_PARAMETER;
   }
 
+  // Move as many blocks per command as the host allows.
+  MaxBlockCount = MmcGetMaxBlockCount (MmcHost);
+
   BytesRemainingToBeTransfered = BufferSize;
   while (BytesRemainingToBeTransfered > 0) {
 
+    BlockCount = MIN (BytesRemainingToBeTransfered / This->Media->BlockSize, MaxBlockCount);
+    TransferSize = BlockCount * This->Media->BlockSize;
+
     // Check if the Card is in Ready status
     CmdArg = MmcHostInstance->CardInfo.RCA << 16;
     Response[0] = 0;
@@ -217,12 +247,22 @@ MmcIoBlocks (
       CmdArg = Lba * This->Media->BlockSize;
     }
 
+    // Announce the number of blocks so the card stops by itself. Cards
+    // without CMD23 are stopped with CMD12 once the data is through.
+    if (BlockCount > 1 && MmcHostInstance->CardInfo.SetBlockCount) {
+      Status = MmcHost->SendCommand (MmcHost, MMC_CMD23, BlockCount);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "MmcIoBlocks(MMC_CMD23): Error %r\n", Status));
+        return Status;
+      }
+    }
+
     if (Transfer == MMC_IOBLOCKS_READ) {
-      // Read a single block
-      Cmd = MMC_CMD17;
+      // Read a single block, or several
+      Cmd = (BlockCount > 1) ? MMC_CMD18 : MMC_CMD17;
     } else {
-      // Write a single block
-      Cmd = MMC_CMD24;
+      // Write a single block, or several
+      Cmd = (BlockCount > 1) ? MMC_CMD25 : MMC_CMD24;
     }
     Status = MmcHost->SendCommand (MmcHost, Cmd, CmdArg);
     if (EFI_ERROR (Status)) {
@@ -231,8 +271,8 @@ MmcIoBlocks (
     }
 
     if (Transfer == MMC_IOBLOCKS_READ) {
-      // Read one block of Data
-      Status = MmcHost->ReadBlockData (MmcHost, Lba, This->Media->BlockSize, Buffer);
+      // Read the block(s) of Data
+      Status = MmcHost->ReadBlockData (MmcHost, Lba, TransferSize, Buffer);
       if (EFI_ERROR (Status)) {
         DEBUG ((EFI_D_BLKIO, "MmcIoBlocks(): Error Read Block Data and Status = %r\n", Status));
         MmcStopTransmission (MmcHost);
@@ -244,8 +284,8 @@ MmcIoBlocks (
         return Status;
       }
     } else {
-      // Write one block of Data
-      Status = MmcHost->WriteBlockData (MmcHost, Lba, This->Media->BlockSize, Buffer);
+      // Write the block(s) of Data
+      Status = MmcHost->WriteBlockData (MmcHost, Lba, TransferSize, Buffer);
       if (EFI_ERROR (Status)) {
         DEBUG ((EFI_D_BLKIO, "MmcIoBlocks(): Error Write Block Data and Status = %r\n", Status));
         MmcStopTransmission (MmcHost);
@@ -253,6 +293,15 @@ MmcIoBlocks (
       }
     }
 
+    // Open-ended multi-block transfers end with CMD12
+    if (BlockCount > 1 && !MmcHostInstance->CardInfo.SetBlockCount) {
+      Status = MmcStopTransmission (MmcHost);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "MmcIoBlocks(MMC_CMD12): Error %r\n", Status));
+        return Status;
+      }
+    }
+
     // Command 13 - Read status and wait for programming to complete (return to tran)
     Timeout = MMCI0_TIMEOUT;
     CmdArg = MmcHostInstance->CardInfo.RCA << 16;
@@ -276,9 +325,9 @@ MmcIoBlocks (
       return Status;
     }
 
-    BytesRemainingToBeTransfered -= This->Media->BlockSize;
+    BytesRemainingToBeTransfered -= TransferSize;
     Lba    += BlockCount;
-    Buffer = (UINT8 *)Buffer + This->Media->BlockSize;
+    Buffer = (UINT8 *)Buffer + TransferSize;
   }
 
   return EFI_SUCCESS;
@@ -294,7 +343,15 @@ MmcReadBlocks (
   OUT VOID                    *Buffer
   )
 {
-  return MmcIoBlocks (This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  // Keep the BlockIo2 request timer off the host for the transfer
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = MmcIoBlocks (This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
 }
 
 EFI_STATUS
@@ -307,7 +364,15 @@ MmcWriteBlocks (
   IN VOID                     *Buffer
   )
 {
-  return MmcIoBlocks (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  // Keep the BlockIo2 request timer off the host for the transfer
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = MmcIoBlocks (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
 }
 
 EFI_STATUS
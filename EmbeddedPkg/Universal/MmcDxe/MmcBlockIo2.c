@@ -0,0 +1,304 @@
+/** @file
+  Block IO 2 protocol implementation for the MMC DXE driver.
+
+  Non-blocking requests are queued on the card and served by a timer event,
+  one chunk of at most a host command worth of blocks per tick, so the
+  caller keeps running between chunks. Each token is signaled as soon as
+  its request has been transferred.
+
+  Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+
+  This program and the accompanying materials are licensed and made
+  available under the terms and conditions of the BSD License which
+  accompanies this distribution.  The full text of the license may be
+  found at http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS"
+  BASIS, WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER
+  EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "Mmc.h"
+
+// Smallest number of blocks served per tick, for hosts without multi-block
+// support.
+#define MMC_IO2_MIN_CHUNK_BLOCKS  128
+
+STATIC
+VOID
+MmcCompleteRequest (
+  IN MMC_IO2_REQUEST        *Request,
+  IN EFI_STATUS             Status
+  )
+{
+  RemoveEntryList (&Request->Link);
+  Request->Token->TransactionStatus = Status;
+  gBS->SignalEvent (Request->Token->Event);
+  FreePool (Request);
+}
+
+VOID
+MmcAbortRequests (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN EFI_STATUS             Status
+  )
+{
+  EFI_TPL                 OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  while (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    MmcCompleteRequest (
+      MMC_IO2_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue)),
+      Status);
+  }
+  gBS->SetTimer (MmcHostInstance->RequestEvent, TimerCancel, 0);
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+VOID
+EFIAPI
+MmcProcessRequests (
+  IN EFI_EVENT              Event,
+  IN VOID                   *Context
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  MMC_IO2_REQUEST         *Request;
+  EFI_STATUS              Status;
+  UINTN                   BlockSize;
+  UINTN                   ChunkSize;
+
+  MmcHostInstance = (MMC_HOST_INSTANCE *)Context;
+
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    gBS->SetTimer (MmcHostInstance->RequestEvent, TimerCancel, 0);
+    return;
+  }
+
+  Request = MMC_IO2_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue));
+
+  // Everything queued before a flush has been written by now
+  if (Request->Transfer == MMC_IOBLOCKS_FLUSH) {
+    MmcCompleteRequest (Request, EFI_SUCCESS);
+    return;
+  }
+
+  BlockSize = MmcHostInstance->BlockIo.Media->BlockSize;
+  ChunkSize = MAX (MmcGetMaxBlockCount (MmcHostInstance->MmcHost), MMC_IO2_MIN_CHUNK_BLOCKS) * BlockSize;
+  ChunkSize = MIN (ChunkSize, Request->BufferSize);
+
+  Status = MmcIoBlocks (&MmcHostInstance->BlockIo, Request->Transfer, Request->MediaId,
+                        Request->Lba, ChunkSize, Request->Buffer);
+  if (EFI_ERROR (Status)) {
+    MmcCompleteRequest (Request, Status);
+    return;
+  }
+
+  Request->Lba        += ChunkSize / BlockSize;
+  Request->Buffer      = (UINT8 *)Request->Buffer + ChunkSize;
+  Request->BufferSize -= ChunkSize;
+  if (Request->BufferSize == 0) {
+    MmcCompleteRequest (Request, EFI_SUCCESS);
+  }
+}
+
+STATIC
+EFI_STATUS
+MmcQueueRequest (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN EFI_BLOCK_IO2_TOKEN    *Token,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  )
+{
+  MMC_IO2_REQUEST         *Request;
+  EFI_TPL                 OldTpl;
+
+  Request = AllocatePool (sizeof (MMC_IO2_REQUEST));
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Request->Signature  = MMC_IO2_REQUEST_SIGNATURE;
+  Request->Token      = Token;
+  Request->Transfer   = Transfer;
+  Request->MediaId    = MediaId;
+  Request->Lba        = Lba;
+  Request->BufferSize = BufferSize;
+  Request->Buffer     = Buffer;
+
+  Token->TransactionStatus = EFI_NOT_READY;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    gBS->SetTimer (MmcHostInstance->RequestEvent, TimerPeriodic, MMC_IO2_REQUEST_PERIOD);
+  }
+  InsertTailList (&MmcHostInstance->RequestQueue, &Request->Link);
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+MmcIoBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINTN                  Transfer,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN OUT VOID                   *Buffer
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_BLOCK_IO_MEDIA      *Media;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+  Media = This->Media;
+
+  // Blocking request, same as through BlockIo
+  if (Token == NULL || Token->Event == NULL) {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    Status = MmcIoBlocks (&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    gBS->RestoreTPL (OldTpl);
+    return Status;
+  }
+
+  // Errors are reported now rather than through the token
+  if (Media->MediaId != MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+
+  if ((Transfer == MMC_IOBLOCKS_WRITE) && Media->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if ((BufferSize % Media->BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  if ((Lba + (BufferSize / Media->BlockSize)) > (Media->LastBlock + 1)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Media->IoAlign > 2) && (((UINTN)Buffer & (Media->IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+    return EFI_SUCCESS;
+  }
+
+  return MmcQueueRequest (MmcHostInstance, Token, Transfer, MediaId, Lba, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  MmcAbortRequests (MmcHostInstance, EFI_ABORTED);
+
+  return MmcReset (&MmcHostInstance->BlockIo, ExtendedVerification);
+}
+
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                   *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_READ, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_TPL                 OldTpl;
+  EFI_STATUS              Status;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  if (!This->Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+
+  // Nothing is cached, but a blocking flush still has to wait for the
+  // writes queued so far. Serve them here, at the TPL of the request timer.
+  if (Token == NULL || Token->Event == NULL) {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    while (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+      MmcProcessRequests (MmcHostInstance->RequestEvent, MmcHostInstance);
+    }
+    gBS->RestoreTPL (OldTpl);
+    return EFI_SUCCESS;
+  }
+
+  // Otherwise complete the token behind the writes already queued. The
+  // timer must not retire the last request between the check and the
+  // queueing.
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+    Status = EFI_SUCCESS;
+  } else {
+    Status = MmcQueueRequest (MmcHostInstance, Token, MMC_IOBLOCKS_FLUSH,
+                              This->Media->MediaId, 0, 0, NULL);
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
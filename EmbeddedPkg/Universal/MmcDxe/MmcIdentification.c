@@ -149,6 +149,10 @@ EmmcIdentificationMode (
 
   // Setup card type
   MmcHostInstance->CardInfo.CardType = EMMC_CARD;
+
+  // CMD23 (SET_BLOCK_COUNT) is mandatory for every card with an ECSD, so
+  // multi-block transfers can use pre-defined block counts.
+  MmcHostInstance->CardInfo.SetBlockCount = TRUE;
   return EFI_SUCCESS;
 }
 
@@ -482,6 +482,102 @@ DumpMemoryProfileMemoryRange (
   return (VOID *) Descriptor;
 }
 
+/**
+  Dump memory profile pool class information.
+
+  @param[in] ClassIndex         Pool class index.
+  @param[in] PoolClass          Pointer to memory profile pool class.
+
+  @return Pointer to next memory profile pool class.
+
+**/
+MEMORY_PROFILE_POOL_CLASS *
+DumpMemoryProfilePoolClass (
+  IN UINTN                      ClassIndex,
+  IN MEMORY_PROFILE_POOL_CLASS  *PoolClass
+  )
+{
+  if (PoolClass->Header.Signature != MEMORY_PROFILE_POOL_CLASS_SIGNATURE) {
+    return NULL;
+  }
+  Print (L"  MEMORY_PROFILE_POOL_CLASS (0x%x)\n", ClassIndex);
+  Print (L"    Signature                   - 0x%08x\n", PoolClass->Header.Signature);
+  Print (L"    Length                      - 0x%04x\n", PoolClass->Header.Length);
+  Print (L"    Revision                    - 0x%04x\n", PoolClass->Header.Revision);
+  Print (L"    BlockSize                   - 0x%08x\n", PoolClass->BlockSize);
+  Print (L"    AllocationCount             - 0x%016lx\n", PoolClass->AllocationCount);
+  Print (L"    FreeCount                   - 0x%016lx\n", PoolClass->FreeCount);
+  Print (L"    MagazineHits                - 0x%016lx\n", PoolClass->MagazineHits);
+  Print (L"    SlabPages                   - 0x%016lx\n", PoolClass->SlabPages);
+  Print (L"    BlocksInUse                 - 0x%016lx\n", PoolClass->BlocksInUse);
+  if (PoolClass->SlabPages != 0) {
+    Print (
+      L"    SlabUtilization             - %ld%%\n",
+      DivU64x64Remainder (
+        MultU64x32 (PoolClass->BlocksInUse, PoolClass->BlockSize * 100),
+        EFI_PAGES_TO_SIZE (PoolClass->SlabPages),
+        NULL
+        )
+      );
+  }
+
+  return (MEMORY_PROFILE_POOL_CLASS *) ((UINTN) PoolClass + PoolClass->Header.Length);
+}
+
+/**
+  Dump memory profile pool statistics.
+
+  @param[in] PoolStats          Pointer to memory profile pool statistics.
+
+  @return Pointer to the end of memory profile pool statistics buffer.
+
+**/
+VOID *
+DumpMemoryProfilePoolStats (
+  IN MEMORY_PROFILE_POOL_STATS  *PoolStats
+  )
+{
+  MEMORY_PROFILE_POOL_CLASS     *PoolClass;
+  UINTN                         ClassIndex;
+
+  if (PoolStats->Header.Signature != MEMORY_PROFILE_POOL_STATS_SIGNATURE) {
+    return NULL;
+  }
+  Print (L"MEMORY_PROFILE_POOL_STATS\n");
+  Print (L"  Signature                     - 0x%08x\n", PoolStats->Header.Signature);
+  Print (L"  Length                        - 0x%04x\n", PoolStats->Header.Length);
+  Print (L"  Revision                      - 0x%04x\n", PoolStats->Header.Revision);
+  Print (L"  PoolPages                     - 0x%016lx\n", PoolStats->PoolPages);
+  Print (L"  UsedBytes                     - 0x%016lx\n", PoolStats->UsedBytes);
+  Print (L"  AllocationCount               - 0x%016lx\n", PoolStats->AllocationCount);
+  Print (L"  FreeCount                     - 0x%016lx\n", PoolStats->FreeCount);
+  Print (L"  Overhead                      - 0x%08x\n", PoolStats->Overhead);
+  Print (L"  ClassCount                    - 0x%08x\n", PoolStats->ClassCount);
+  if (PoolStats->PoolPages != 0) {
+    //
+    // Share of the pool pages not handed out, that is free blocks and slack
+    //
+    Print (
+      L"  Fragmentation                 - %ld%%\n",
+      100 - DivU64x64Remainder (
+              MultU64x32 (PoolStats->UsedBytes, 100),
+              EFI_PAGES_TO_SIZE (PoolStats->PoolPages),
+              NULL
+              )
+      );
+  }
+
+  PoolClass = (MEMORY_PROFILE_POOL_CLASS *) ((UINTN) PoolStats + PoolStats->Header.Length);
+  for (ClassIndex = 0; ClassIndex < PoolStats->ClassCount; ClassIndex++) {
+    PoolClass = DumpMemoryProfilePoolClass (ClassIndex, PoolClass);
+    if (PoolClass == NULL) {
+      return NULL;
+    }
+  }
+
+  return (VOID *) PoolClass;
+}
+
 /**
   Scan memory profile by Signature.
 
@@ -533,6 +629,7 @@ DumpMemoryProfile (
   MEMORY_PROFILE_CONTEXT        *Context;
   MEMORY_PROFILE_FREE_MEMORY    *FreeMemory;
   MEMORY_PROFILE_MEMORY_RANGE   *MemoryRange;
+  MEMORY_PROFILE_POOL_STATS     *PoolStats;
 
   Context = (MEMORY_PROFILE_CONTEXT *) ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_CONTEXT_SIGNATURE);
   if (Context != NULL) {
@@ -548,6 +645,11 @@ DumpMemoryProfile (
   if (MemoryRange != NULL) {
     DumpMemoryProfileMemoryRange (MemoryRange);
   }
+
+  PoolStats = (MEMORY_PROFILE_POOL_STATS *) ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_POOL_STATS_SIGNATURE);
+  if (PoolStats != NULL) {
+    DumpMemoryProfilePoolStats (PoolStats);
+  }
 }
 
 /**
@@ -0,0 +1,290 @@
+/** @file
+  Micro-benchmark of the Internet checksum of the network library.
+
+  Checks NetblockChecksum () against a reference that sums the data one
+  16-bit word at a time, on random data at random offsets and lengths,
+  and NetUpdateChecksum () against a checksum recomputed over the whole
+  data. The check does not depend on the TimerLib. Then prints the
+  throughput of both on typical packet sizes, if the platform reports the
+  frequency of its performance counter.
+
+  Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/NetLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiLib.h>
+
+#define BENCH_BUFFER_SIZE     SIZE_1MB
+#define BENCH_CHECK_ROUNDS    4096
+#define BENCH_BYTES           SIZE_256MB
+#define BENCH_SEED            0x9e3779b97f4a7c15ULL
+
+STATIC UINT64         mCounterFrequency;
+STATIC UINT64         mRandom;
+
+//
+// Packet sizes measured: small headers, an Ethernet frame, a jumbo frame
+// and the largest IP datagram.
+//
+STATIC CONST UINT32   mBenchSizes[] = { 20, 64, 1500, 9000, 65535 };
+
+/**
+  Return a pseudo-random number, from a 64-bit xorshift generator.
+
+  @return  The next pseudo-random number.
+
+**/
+STATIC
+UINT32
+BenchRandom (
+  VOID
+  )
+{
+  mRandom ^= LShiftU64 (mRandom, 13);
+  mRandom ^= RShiftU64 (mRandom, 7);
+  mRandom ^= LShiftU64 (mRandom, 17);
+
+  return (UINT32) mRandom;
+}
+
+/**
+  Reference checksum, summing the data one 16-bit word at a time. The
+  sum is 64 bits wide so that it can't overflow on the whole buffer.
+
+  @param  Bulk   Pointer to the data.
+  @param  Len    Length of the data, in bytes.
+
+  @return  The checksum of the data.
+
+**/
+STATIC
+UINT16
+BenchReferenceChecksum (
+  IN UINT8          *Bulk,
+  IN UINT32         Len
+  )
+{
+  UINT64            Sum;
+
+  Sum = 0;
+
+  while (Len > 1) {
+    Sum  += ReadUnaligned16 ((UINT16 *) Bulk);
+    Bulk += 2;
+    Len  -= 2;
+  }
+
+  if (Len > 0) {
+    Sum += *Bulk;
+  }
+
+  while (RShiftU64 (Sum, 16) != 0) {
+    Sum = (Sum & 0xffff) + RShiftU64 (Sum, 16);
+  }
+
+  return (UINT16) Sum;
+}
+
+/**
+  Print the throughput of a checksum.
+
+  @param  Name    Name of the checksum.
+  @param  Size    Size of the data checksummed each time.
+  @param  Bytes   Number of bytes checksummed.
+  @param  Ticks   Performance counter ticks it took.
+
+**/
+STATIC
+VOID
+BenchReport (
+  IN CONST CHAR16   *Name,
+  IN UINT32         Size,
+  IN UINT64         Bytes,
+  IN UINT64         Ticks
+  )
+{
+  UINT64            Rate;
+
+  Rate = 0;
+  if (Ticks != 0) {
+    Rate = DivU64x64Remainder (MultU64x64 (Bytes, mCounterFrequency), MultU64x32 (Ticks, SIZE_1MB), NULL);
+  }
+
+  Print (L"%-10s %6d bytes %8ld MB/s\n", Name, Size, Rate);
+}
+
+/**
+  Check NetblockChecksum () and NetUpdateChecksum () on random data.
+
+  @param  Buffer   A BENCH_BUFFER_SIZE buffer.
+
+  @retval TRUE     All the checksums are right.
+  @retval FALSE    A checksum differs from the reference.
+
+**/
+STATIC
+BOOLEAN
+BenchCheck (
+  IN UINT8          *Buffer
+  )
+{
+  UINTN             Round;
+  UINT32            Offset;
+  UINT32            Len;
+  UINT32            Index;
+  UINT32            Field;
+  UINT8             Old[4];
+  UINT8             New[4];
+  UINT16            Expected;
+  UINT16            Actual;
+
+  for (Round = 0; Round < BENCH_CHECK_ROUNDS; Round++) {
+    //
+    // Mostly packet sized data, sometimes up to the whole buffer, at
+    // any alignment. All ones data is where 0 and 0xffff could mix up.
+    //
+    Offset = BenchRandom () % 64;
+    if ((Round % 16) == 0) {
+      Len = BenchRandom () % (BENCH_BUFFER_SIZE - Offset);
+    } else {
+      Len = BenchRandom () % 9100;
+    }
+
+    for (Index = 0; Index < Len; Index++) {
+      Buffer[Offset + Index] = ((Round % 8) == 1) ? 0xff : (UINT8) BenchRandom ();
+    }
+
+    Expected = BenchReferenceChecksum (Buffer + Offset, Len);
+    Actual   = NetblockChecksum (Buffer + Offset, Len);
+    if (Actual != Expected) {
+      Print (L"NetblockChecksum: offset %d length %d: 0x%04x, expected 0x%04x\n", Offset, Len, Actual, Expected);
+      return FALSE;
+    }
+
+    //
+    // Rewrite an aligned 32-bit field, like an IPv4 address.
+    //
+    if (Len < sizeof (Old)) {
+      continue;
+    }
+
+    Field = (BenchRandom () % (Len - sizeof (Old) + 1)) & ~1U;
+    CopyMem (Old, Buffer + Offset + Field, sizeof (Old));
+    for (Index = 0; Index < sizeof (New); Index++) {
+      New[Index] = (UINT8) BenchRandom ();
+    }
+
+    Expected = (UINT16) ~NetblockChecksum (Buffer + Offset, Len);
+    Actual   = NetUpdateChecksum (Expected, Old, New, sizeof (Old));
+
+    CopyMem (Buffer + Offset + Field, New, sizeof (New));
+    Expected = (UINT16) ~BenchReferenceChecksum (Buffer + Offset, Len);
+
+    //
+    // 0 and 0xffff are the same in one's complement.
+    //
+    if ((Actual != Expected) &&
+        !(((Actual == 0) || (Actual == 0xffff)) && ((Expected == 0) || (Expected == 0xffff)))) {
+      Print (L"NetUpdateChecksum: offset %d length %d: 0x%04x, expected 0x%04x\n", Offset, Len, Actual, Expected);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The checksums are right.
+  @retval EFI_ABORTED       A checksum is wrong.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  UINT8         *Buffer;
+  UINTN         SizeIndex;
+  UINT32        Size;
+  UINT64        Count;
+  UINT64        Index;
+  UINT64        Start;
+  UINT64        Ticks;
+  UINT16        Sum;
+
+  //
+  // A fixed seed, so that a failure can be reproduced.
+  //
+  mRandom = BENCH_SEED;
+
+  Buffer = AllocatePool (BENCH_BUFFER_SIZE);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!BenchCheck (Buffer)) {
+    FreePool (Buffer);
+    return EFI_ABORTED;
+  }
+
+  Print (L"%d random buffers checked\n", BENCH_CHECK_ROUNDS);
+
+  mCounterFrequency = GetPerformanceCounterProperties (NULL, NULL);
+  if (mCounterFrequency == 0) {
+    Print (L"No performance counter, throughput not measured\n");
+    FreePool (Buffer);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // The sum is printed so the loops can't be optimized away.
+  //
+  Sum = 0;
+  for (SizeIndex = 0; SizeIndex < sizeof (mBenchSizes) / sizeof (mBenchSizes[0]); SizeIndex++) {
+    Size  = mBenchSizes[SizeIndex];
+    Count = DivU64x32 (BENCH_BYTES, Size);
+
+    Start = GetPerformanceCounter ();
+    for (Index = 0; Index < Count; Index++) {
+      Sum = NetAddChecksum (Sum, BenchReferenceChecksum (Buffer, Size));
+    }
+    Ticks = GetPerformanceCounter () - Start;
+    BenchReport (L"Reference", Size, MultU64x32 (Count, Size), Ticks);
+
+    Start = GetPerformanceCounter ();
+    for (Index = 0; Index < Count; Index++) {
+      Sum = NetAddChecksum (Sum, NetblockChecksum (Buffer, Size));
+    }
+    Ticks = GetPerformanceCounter () - Start;
+    BenchReport (L"NetLib", Size, MultU64x32 (Count, Size), Ticks);
+  }
+
+  Print (L"Sum 0x%04x\n", Sum);
+
+  FreePool (Buffer);
+  return EFI_SUCCESS;
+}
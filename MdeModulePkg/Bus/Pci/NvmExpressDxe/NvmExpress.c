@@ -154,6 +154,15 @@ EnumerateNvmeDevNamespace (
     Device->BlockIo.WriteBlocks  = NvmeBlockIoWriteBlocks;
     Device->BlockIo.FlushBlocks  = NvmeBlockIoFlushBlocks;
 
+    //
+    // Create BlockIo2 Protocol instance
+    //
+    Device->BlockIo2.Media          = &Device->Media;
+    Device->BlockIo2.Reset          = NvmeBlockIoResetEx;
+    Device->BlockIo2.ReadBlocksEx   = NvmeBlockIoReadBlocksEx;
+    Device->BlockIo2.WriteBlocksEx  = NvmeBlockIoWriteBlocksEx;
+    Device->BlockIo2.FlushBlocksEx  = NvmeBlockIoFlushBlocksEx;
+
     //
     // Create StorageSecurityProtocol Instance
     //
@@ -209,6 +218,8 @@ EnumerateNvmeDevNamespace (
                     Device->DevicePath,
                     &gEfiBlockIoProtocolGuid,
                     &Device->BlockIo,
+                    &gEfiBlockIo2ProtocolGuid,
+                    &Device->BlockIo2,
                     &gEfiDiskInfoProtocolGuid,
                     &Device->DiskInfo,
                     NULL
@@ -235,6 +246,8 @@ EnumerateNvmeDevNamespace (
                Device->DevicePath,
                &gEfiBlockIoProtocolGuid,
                &Device->BlockIo,
+               &gEfiBlockIo2ProtocolGuid,
+               &Device->BlockIo2,
                &gEfiDiskInfoProtocolGuid,
                &Device->DiskInfo,
                NULL
@@ -400,6 +413,11 @@ UnregisterNvmeNamespace (
          Handle
          );
 
+  //
+  // Complete the asynchronous requests still queued on the namespace.
+  //
+  NvmeAbortAsyncRequests (Private, Device);
+
   //
   // The Nvm Express driver installs the BlockIo and DiskInfo in the DriverBindingStart().
   // Here should uninstall both of them.
@@ -410,6 +428,8 @@ UnregisterNvmeNamespace (
                   Device->DevicePath,
                   &gEfiBlockIoProtocolGuid,
                   &Device->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid,
+                  &Device->BlockIo2,
                   &gEfiDiskInfoProtocolGuid,
                   &Device->DiskInfo,
                   NULL
@@ -777,6 +797,35 @@ NvmExpressDriverBindingStart (
     Private->Passthru.BuildDevicePath  = NvmExpressBuildDevicePath;
     Private->Passthru.GetNamespace     = NvmExpressGetNamespace;
     CopyMem (&Private->PassThruMode, &gEfiNvmExpressPassThruMode, sizeof (EFI_NVM_EXPRESS_PASS_THRU_MODE));
+    InitializeListHead (&Private->AsyncQueue);
+
+    //
+    // Timer polling for the completion of BlockIo2 requests, armed while any is queued.
+    //
+    Status = gBS->CreateEvent (
+                    EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    NvmeProcessAsyncQueue,
+                    Private,
+                    &Private->TimerEvent
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+
+    //
+    // Deadline for the commands of the BlockIo2 requests, re-armed on every completion.
+    //
+    Status = gBS->CreateEvent (
+                    EVT_TIMER,
+                    TPL_CALLBACK,
+                    NULL,
+                    NULL,
+                    &Private->AsyncTimeoutEvent
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
 
     Status = NvmeControllerInit (Private);
     if (EFI_ERROR(Status)) {
@@ -846,6 +895,14 @@ Exit:
     PciIo->FreeBuffer (PciIo, 4, Private->Buffer);
   }
 
+  if ((Private != NULL) && (Private->TimerEvent != NULL)) {
+    gBS->CloseEvent (Private->TimerEvent);
+  }
+
+  if ((Private != NULL) && (Private->AsyncTimeoutEvent != NULL)) {
+    gBS->CloseEvent (Private->AsyncTimeoutEvent);
+  }
+
   if (Private != NULL) {
     FreePool (Private);
   }
@@ -938,6 +995,14 @@ NvmExpressDriverBindingStop (
         Private->PciIo->FreeBuffer (Private->PciIo, 4, Private->Buffer);
       }
 
+      if (Private->TimerEvent != NULL) {
+        gBS->CloseEvent (Private->TimerEvent);
+      }
+
+      if (Private->AsyncTimeoutEvent != NULL) {
+        gBS->CloseEvent (Private->AsyncTimeoutEvent);
+      }
+
       FreePool (Private->ControllerData);
       FreePool (Private);
     }
@@ -28,6 +28,7 @@
 #include <Protocol/PciIo.h>
 #include <Protocol/NvmExpressPassthru.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DiskInfo.h>
 #include <Protocol/DriverSupportedEfiVersion.h>
 #include <Protocol/StorageSecurityCommand.h>
@@ -39,6 +40,7 @@
 #include <Library/UefiLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiDriverEntryPoint.h>
 
@@ -60,8 +62,7 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_ASQ_SIZE                             1     // Number of admin submission queue entries, which is 0-based
 #define NVME_ACQ_SIZE                             1     // Number of admin completion queue entries, which is 0-based
 
-#define NVME_CSQ_SIZE                             1     // Number of I/O submission queue entries, which is 0-based
-#define NVME_CCQ_SIZE                             1     // Number of I/O completion queue entries, which is 0-based
+#define NVME_MAX_IO_QUEUE_ENTRIES                 (EFI_PAGE_SIZE / sizeof (NVME_SQ))  // I/O queue entries that fit in one 4kB page
 
 #define NVME_MAX_QUEUES                           2     // Number of queues supported by the driver
 
@@ -72,6 +73,64 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 //
 #define NVME_GENERIC_TIMEOUT                      EFI_TIMER_PERIOD_SECONDS (5)
 
+//
+// Period of the timer polling for the completion of asynchronous requests
+//
+#define NVME_ASYNC_TIMER_PERIOD                   EFI_TIMER_PERIOD_MILLISECONDS (1)
+
+//
+// A read, write or flush of a namespace, carried out by one or more commands.
+//
+#define NVME_IO_REQUEST_SIGNATURE                 SIGNATURE_32 ('N','V','M','R')
+
+typedef struct {
+  UINT32                              Signature;
+  LIST_ENTRY                          Link;
+
+  NVME_DEVICE_PRIVATE_DATA            *Device;
+  EFI_BLOCK_IO2_TOKEN                 *Token;         // NULL for a blocking request
+  UINT8                               Opcode;
+
+  //
+  // Part of the request not handed to the controller yet.
+  //
+  UINT64                              Buffer;
+  UINT64                              Lba;
+  UINTN                               Blocks;
+  BOOLEAN                             Started;
+
+  UINTN                               InFlight;       // Commands queued but not completed
+  EFI_STATUS                          Status;         // First failure of its commands
+} NVME_IO_REQUEST;
+
+#define NVME_IO_REQUEST_FROM_LINK(a) \
+  CR (a, \
+      NVME_IO_REQUEST, \
+      Link, \
+      NVME_IO_REQUEST_SIGNATURE \
+      )
+
+//
+// A request still has commands to queue until it fails or its last command is queued.
+//
+#define NVME_IO_REQUEST_UNQUEUED(a) \
+  (!EFI_ERROR ((a)->Status) && (((a)->Blocks > 0) || !(a)->Started))
+
+#define NVME_IO_REQUEST_DONE(a) \
+  (((a)->InFlight == 0) && !NVME_IO_REQUEST_UNQUEUED (a))
+
+//
+// Resources held by an I/O command until it completes.
+//
+typedef struct {
+  BOOLEAN                             Busy;
+  NVME_IO_REQUEST                     *Request;
+  VOID                                *MapData;
+  VOID                                *MapPrpList;
+  VOID                                *PrpListHost;
+  UINTN                               PrpListNo;
+} NVME_IO_SLOT;
+
 //
 // Unique signature for private data structure.
 //
@@ -129,6 +188,29 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   UINT8                               Pt[NVME_MAX_QUEUES];
   UINT16                              Cid[NVME_MAX_QUEUES];
 
+  //
+  // Number of submission & completion queue entries, which is 0-based.
+  // It is also the number of commands which can be in flight on the queue.
+  //
+  UINT16                              QueueSize[NVME_MAX_QUEUES];
+
+  //
+  // Read & write commands in flight on the I/O queue, indexed by command identifier.
+  // The busy slots include the quarantined ones, which belong to timed out
+  // commands the controller could not be reset to drop.
+  //
+  NVME_IO_SLOT                        IoSlot[NVME_MAX_IO_QUEUE_ENTRIES];
+  UINTN                               IoSlotsBusy;
+  UINTN                               IoSlotsQuarantined;
+
+  //
+  // BlockIo2 requests in submission order, the timer serving them, and the
+  // deadline for the next completion of their commands.
+  //
+  LIST_ENTRY                          AsyncQueue;
+  EFI_EVENT                           TimerEvent;
+  EFI_EVENT                           AsyncTimeoutEvent;
+
   //
   // Nvme controller capabilities
   //
@@ -168,6 +250,7 @@ struct _NVME_DEVICE_PRIVATE_DATA {
 
   EFI_BLOCK_IO_MEDIA                       Media;
   EFI_BLOCK_IO_PROTOCOL                    BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL                   BlockIo2;
   EFI_DISK_INFO_PROTOCOL                   DiskInfo;
   EFI_STORAGE_SECURITY_COMMAND_PROTOCOL    StorageSecurity;
 
@@ -190,6 +273,13 @@ struct _NVME_DEVICE_PRIVATE_DATA {
       NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
       )
 
+#define NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2(a) \
+  CR (a, \
+      NVME_DEVICE_PRIVATE_DATA, \
+      BlockIo2, \
+      NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
+      )
+
 #define NVME_DEVICE_PRIVATE_DATA_FROM_DISK_INFO(a) \
   CR (a, \
       NVME_DEVICE_PRIVATE_DATA, \
@@ -607,4 +697,161 @@ NvmExpressBuildDevicePath (
   IN OUT EFI_DEVICE_PATH_PROTOCOL                    **DevicePath
   );
 
+/**
+  Dump the execution status from a given completion queue entry.
+
+  @param[in]     Cq               A pointer to the NVME_CQ item.
+
+**/
+VOID
+NvmeDumpStatus (
+  IN NVME_CQ             *Cq
+  );
+
+/**
+  Create PRP lists for data transfer which is larger than 2 memory pages.
+  Note here we calcuate the number of required PRP lists and allocate them at one time.
+
+  @param[in]     PciIo               A pointer to the EFI_PCI_IO_PROTOCOL instance.
+  @param[in]     PhysicalAddr        The physical base address of data buffer.
+  @param[in]     Pages               The number of pages to be transfered.
+  @param[out]    PrpListHost         The host base address of PRP lists.
+  @param[in,out] PrpListNo           The number of PRP List.
+  @param[out]    Mapping             The mapping value returned from PciIo.Map().
+
+  @retval The pointer to the first PRP List of the PRP lists.
+
+**/
+VOID*
+NvmeCreatePrpList (
+  IN     EFI_PCI_IO_PROTOCOL          *PciIo,
+  IN     EFI_PHYSICAL_ADDRESS         PhysicalAddr,
+  IN     UINTN                        Pages,
+     OUT VOID                         **PrpListHost,
+  IN OUT UINTN                        *PrpListNo,
+     OUT VOID                         **Mapping
+  );
+
+/**
+  Move the tail of a submission queue past the entry just filled in.
+
+  The doorbell is not rung, so several commands can be handed to the controller
+  with a single NvmeRingSqDoorbell() call.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+**/
+VOID
+NvmeAdvanceSqTail (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  );
+
+/**
+  Tell the controller about the commands queued since the last doorbell write.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+  @return The status of the register write.
+
+**/
+EFI_STATUS
+NvmeRingSqDoorbell (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  );
+
+/**
+  Move the head of a completion queue past the entry just consumed, flipping
+  the expected phase tag when the head wraps around.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+**/
+VOID
+NvmeAdvanceCqHead (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  );
+
+/**
+  Give the completion queue entries consumed so far back to the controller.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+  @return The status of the register write.
+
+**/
+EFI_STATUS
+NvmeRingCqDoorbell (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  );
+
+/**
+  Release the mapping and PRP list held by an I/O command and free its slot.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Slot                   The slot of the command.
+  @param  Status                 The completion status of the command.
+
+**/
+VOID
+NvmeReleaseSlot (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_IO_SLOT                       *Slot,
+  IN EFI_STATUS                         Status
+  );
+
+/**
+  Wait for every command in flight on the I/O queue to complete.
+
+  The caller must be running at TPL_CALLBACK, so the asynchronous request
+  timer does not queue more commands meanwhile.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeWaitIoSlots (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  );
+
+/**
+  Timer notification function serving the asynchronous requests of a controller.
+
+  Commands of the queued requests are handed to the controller in submission
+  order as slots become free, completions are reaped and the tokens of the
+  requests that are done are signaled. A flush is only started once every
+  request queued before it is complete.
+
+  @param  Event                  The timer event, or NULL when called directly.
+  @param  Context                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+EFIAPI
+NvmeProcessAsyncQueue (
+  IN EFI_EVENT                          Event,
+  IN VOID                               *Context
+  );
+
+/**
+  Complete the asynchronous requests of a namespace, or of every namespace,
+  with EFI_ABORTED. The commands they have in flight are waited for first.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Device                 The namespace, or NULL for every namespace.
+
+**/
+VOID
+NvmeAbortAsyncRequests (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_DEVICE_PRIVATE_DATA           *Device OPTIONAL
+  );
+
 #endif
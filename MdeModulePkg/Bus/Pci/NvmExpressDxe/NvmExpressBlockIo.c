@@ -16,132 +16,666 @@
 #include "NvmExpress.h"
 
 /**
-  Read some sectors from the device.
+  Release the mapping and PRP list held by an I/O command and free its slot.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Slot                   The slot of the command.
+  @param  Status                 The completion status of the command.
+
+**/
+VOID
+NvmeReleaseSlot (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_IO_SLOT                       *Slot,
+  IN EFI_STATUS                         Status
+  )
+{
+  EFI_PCI_IO_PROTOCOL                   *PciIo;
+  NVME_IO_REQUEST                       *Request;
+
+  PciIo   = Private->PciIo;
+  Request = Slot->Request;
+
+  if (Slot->MapData != NULL) {
+    PciIo->Unmap (PciIo, Slot->MapData);
+  }
+
+  if (Slot->MapPrpList != NULL) {
+    PciIo->Unmap (PciIo, Slot->MapPrpList);
+  }
+
+  if (Slot->PrpListHost != NULL) {
+    PciIo->FreeBuffer (PciIo, Slot->PrpListNo, Slot->PrpListHost);
+  }
+
+  //
+  // A quarantined slot has no request any more.
+  //
+  if (Request == NULL) {
+    Private->IoSlotsQuarantined--;
+  } else {
+    if (EFI_ERROR (Status) && !EFI_ERROR (Request->Status)) {
+      Request->Status = Status;
+    }
+    Request->InFlight--;
+  }
+
+  ZeroMem (Slot, sizeof (NVME_IO_SLOT));
+  Private->IoSlotsBusy--;
+}
+
+/**
+  Place the next command of a request on the I/O submission queue.
+
+  The controller does not see the command until the submission queue doorbell
+  is rung. The command identifier is the index of the slot holding the mapping
+  of the buffer, so completions can be matched in any order.
+
+  @param  Request                The request the command belongs to.
+  @param  Blocks                 Total block number to be transferred by the command.
+
+  @retval EFI_SUCCESS            The command is queued.
+  @retval EFI_OUT_OF_RESOURCES   The buffer could not be mapped for the controller.
+
+**/
+STATIC
+EFI_STATUS
+NvmeQueueCommand (
+  IN NVME_IO_REQUEST                    *Request,
+  IN UINT32                             Blocks
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA              *Device;
+  NVME_CONTROLLER_PRIVATE_DATA          *Private;
+  EFI_PCI_IO_PROTOCOL                   *PciIo;
+  EFI_PCI_IO_PROTOCOL_OPERATION         Flag;
+  EFI_PHYSICAL_ADDRESS                  PhyAddr;
+  NVME_IO_SLOT                          *Slot;
+  NVME_SQ                               *Sq;
+  UINTN                                 MapLength;
+  UINTN                                 Offset;
+  UINT32                                Bytes;
+  UINT16                                Cid;
+  EFI_STATUS                            Status;
+
+  Device  = Request->Device;
+  Private = Device->Controller;
+  PciIo   = Private->PciIo;
+  Bytes   = Blocks * Device->Media.BlockSize;
+  PhyAddr   = 0;
+  MapLength = 0;
+
+  for (Cid = 0; Cid < Private->QueueSize[NVME_IO_QUEUE]; Cid++) {
+    if (!Private->IoSlot[Cid].Busy) {
+      break;
+    }
+  }
+  ASSERT (Cid < Private->QueueSize[NVME_IO_QUEUE]);
+  Slot = &Private->IoSlot[Cid];
+
+  if (Bytes != 0) {
+    if (Request->Opcode == NVME_IO_WRITE_OPC) {
+      Flag = EfiPciIoOperationBusMasterRead;
+    } else {
+      Flag = EfiPciIoOperationBusMasterWrite;
+    }
+
+    MapLength = Bytes;
+    Status = PciIo->Map (
+                      PciIo,
+                      Flag,
+                      (VOID *)(UINTN)Request->Buffer,
+                      &MapLength,
+                      &PhyAddr,
+                      &Slot->MapData
+                      );
+    if (EFI_ERROR (Status)) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Slot->Busy    = TRUE;
+  Slot->Request = Request;
+  Request->InFlight++;
+  Private->IoSlotsBusy++;
+
+  if ((Bytes != 0) && (MapLength != Bytes)) {
+    NvmeReleaseSlot (Private, Slot, EFI_SUCCESS);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Sq = Private->SqBuffer[NVME_IO_QUEUE] + Private->SqTdbl[NVME_IO_QUEUE].Sqt;
+  ZeroMem (Sq, sizeof (NVME_SQ));
+  Sq->Opc    = Request->Opcode;
+  Sq->Cid    = Cid;
+  Sq->Nsid   = Device->NamespaceId;
+  Sq->Prp[0] = PhyAddr;
+
+  //
+  // If the buffer size spans more than two memory pages, then build a PRP
+  // list in the second PRP submission queue entry.
+  //
+  Offset = (UINTN)PhyAddr & (EFI_PAGE_SIZE - 1);
+  if ((Offset + Bytes) > (EFI_PAGE_SIZE * 2)) {
+    Sq->Prp[1] = (UINT64)(UINTN)NvmeCreatePrpList (
+                                  PciIo,
+                                  (PhyAddr + EFI_PAGE_SIZE) & ~((EFI_PHYSICAL_ADDRESS)EFI_PAGE_SIZE - 1),
+                                  EFI_SIZE_TO_PAGES (Offset + Bytes) - 1,
+                                  &Slot->PrpListHost,
+                                  &Slot->PrpListNo,
+                                  &Slot->MapPrpList
+                                  );
+    if (Sq->Prp[1] == 0) {
+      Slot->PrpListHost = NULL;
+      Slot->MapPrpList  = NULL;
+      NvmeReleaseSlot (Private, Slot, EFI_SUCCESS);
+      return EFI_OUT_OF_RESOURCES;
+    }
+  } else if ((Offset + Bytes) > EFI_PAGE_SIZE) {
+    Sq->Prp[1] = (PhyAddr + EFI_PAGE_SIZE) & ~((EFI_PHYSICAL_ADDRESS)EFI_PAGE_SIZE - 1);
+  }
+
+  if (Bytes != 0) {
+    Sq->Payload.Raw.Cdw10 = (UINT32)Request->Lba;
+    Sq->Payload.Raw.Cdw11 = (UINT32)RShiftU64 (Request->Lba, 32);
+    Sq->Payload.Raw.Cdw12 = (Blocks - 1) & 0xFFFF;
+  }
+
+  NvmeAdvanceSqTail (Private, NVME_IO_QUEUE);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Place as many commands of a request on the I/O submission queue as there
+  are free slots, each for at most the maximum data transfer size of the
+  controller. A flush request is a single command without data.
+
+  @param  Request                The request to make progress on.
+
+  @return The number of commands queued.
+
+**/
+STATIC
+UINTN
+NvmeQueueRequest (
+  IN NVME_IO_REQUEST                    *Request
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA              *Device;
+  NVME_CONTROLLER_PRIVATE_DATA          *Private;
+  EFI_STATUS                            Status;
+  UINT32                                BlockSize;
+  UINT32                                MaxTransferBlocks;
+  UINT32                                Count;
+  UINTN                                 Queued;
+
+  Device    = Request->Device;
+  Private   = Device->Controller;
+  BlockSize = Device->Media.BlockSize;
+  Queued    = 0;
+
+  if ((Private->ControllerData != NULL) && (Private->ControllerData->Mdts != 0)) {
+    MaxTransferBlocks = (1 << (Private->ControllerData->Mdts)) * (1 << (Private->Cap.Mpsmin + 12)) / BlockSize;
+  } else {
+    MaxTransferBlocks = 1024;
+  }
+
+  while (NVME_IO_REQUEST_UNQUEUED (Request) &&
+         (Private->IoSlotsBusy < Private->QueueSize[NVME_IO_QUEUE])) {
+    Count = (UINT32)MIN (Request->Blocks, MaxTransferBlocks);
+
+    Status = NvmeQueueCommand (Request, Count);
+    if (EFI_ERROR (Status)) {
+      Request->Status = Status;
+      break;
+    }
+
+    Queued++;
+    Request->Started = TRUE;
+    Request->Blocks -= Count;
+    Request->Buffer += MultU64x32 (Count, BlockSize);
+    Request->Lba    += Count;
+  }
+
+  return Queued;
+}
+
+/**
+  Retire the commands the controller has completed on the I/O queue, in the
+  order it completed them, and give the consumed completion queue entries
+  back to the controller with a single doorbell write.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @return The number of commands retired.
+
+**/
+STATIC
+UINTN
+NvmeReapCommands (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  NVME_CQ                               *Cq;
+  NVME_IO_SLOT                          *Slot;
+  UINTN                                 Reaped;
+
+  Reaped = 0;
+
+  for (;;) {
+    Cq = Private->CqBuffer[NVME_IO_QUEUE] + Private->CqHdbl[NVME_IO_QUEUE].Cqh;
+    if (Cq->Pt == Private->Pt[NVME_IO_QUEUE]) {
+      break;
+    }
+
+    if (Cq->Cid < Private->QueueSize[NVME_IO_QUEUE] && Private->IoSlot[Cq->Cid].Busy) {
+      Slot = &Private->IoSlot[Cq->Cid];
+      if ((Cq->Sct == 0) && (Cq->Sc == 0)) {
+        NvmeReleaseSlot (Private, Slot, EFI_SUCCESS);
+      } else {
+        DEBUG_CODE_BEGIN();
+          NvmeDumpStatus (Cq);
+        DEBUG_CODE_END();
+        NvmeReleaseSlot (Private, Slot, EFI_DEVICE_ERROR);
+      }
+    } else {
+      DEBUG ((EFI_D_ERROR, "NvmeReapCommands: unexpected completion for Cid 0x%x\n", Cq->Cid));
+    }
+
+    NvmeAdvanceCqHead (Private, NVME_IO_QUEUE);
+    Reaped++;
+  }
+
+  if (Reaped != 0) {
+    NvmeRingCqDoorbell (Private, NVME_IO_QUEUE);
+  }
+
+  return Reaped;
+}
+
+/**
+  Give up on every command in flight on the I/O queue, the controller did not
+  complete any of them in time.
+
+  The controller is reset, which releases the slots once it is disabled, so a
+  late completion or data transfer cannot hit a reused slot. If the reset
+  fails, the slots are quarantined instead: their requests fail, but the
+  command identifiers and buffers are only released by a completion or by a
+  later reset.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+STATIC
+VOID
+NvmeAbandonCommands (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  NVME_IO_SLOT                          *Slot;
+  UINTN                                 Index;
+  EFI_STATUS                            Status;
+
+  DEBUG ((EFI_D_ERROR, "NvmeAbandonCommands: %d commands timed out\n",
+    Private->IoSlotsBusy - Private->IoSlotsQuarantined));
+
+  for (Index = 0; Index < Private->QueueSize[NVME_IO_QUEUE]; Index++) {
+    Slot = &Private->IoSlot[Index];
+    if (Slot->Busy && (Slot->Request != NULL) && !EFI_ERROR (Slot->Request->Status)) {
+      Slot->Request->Status = EFI_TIMEOUT;
+    }
+  }
+
+  Status = NvmeControllerInit (Private);
+  if (!EFI_ERROR (Status)) {
+    return;
+  }
+
+  DEBUG ((EFI_D_ERROR, "NvmeAbandonCommands: controller reset failed: %r\n", Status));
+
+  for (Index = 0; Index < Private->QueueSize[NVME_IO_QUEUE]; Index++) {
+    Slot = &Private->IoSlot[Index];
+    if (Slot->Busy && (Slot->Request != NULL)) {
+      Slot->Request->InFlight--;
+      Slot->Request = NULL;
+      Private->IoSlotsQuarantined++;
+    }
+  }
+}
+
+/**
+  Wait for every command in flight on the I/O queue to complete.
+
+  The caller must be running at TPL_CALLBACK, so the asynchronous request
+  timer does not queue more commands meanwhile.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeWaitIoSlots (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  EFI_EVENT                             TimerEvent;
+  EFI_STATUS                            Status;
+
+  if (Private->IoSlotsBusy == Private->IoSlotsQuarantined) {
+    return;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER, TPL_CALLBACK, NULL, NULL, &TimerEvent);
+  if (EFI_ERROR (Status)) {
+    NvmeAbandonCommands (Private);
+    return;
+  }
+  gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+
+  while (Private->IoSlotsBusy != Private->IoSlotsQuarantined) {
+    if (NvmeReapCommands (Private) != 0) {
+      gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+    } else if (!EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
+      NvmeAbandonCommands (Private);
+    }
+  }
+
+  gBS->CloseEvent (TimerEvent);
+}
+
+/**
+  Read, write or flush some blocks and wait for the transfer to complete.
+
+  As many commands as the I/O queue holds are kept in flight. Each batch of
+  new commands is announced with a single doorbell write, and a slot freed by
+  a completion, whichever command it belonged to, is reused right away.
 
   @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
-  @param  Buffer                 The buffer used to store the data read from the device.
+  @param  Opcode                 NVME_IO_READ_OPC, NVME_IO_WRITE_OPC or NVME_IO_FLUSH_OPC.
+  @param  Buffer                 The buffer to transfer the data to or from.
   @param  Lba                    The start block number.
-  @param  Blocks                 Total block number to be read.
+  @param  Blocks                 Total block number to be transferred.
 
-  @retval EFI_SUCCESS            Datum are read from the device.
-  @retval Others                 Fail to read all the datum.
+  @retval EFI_SUCCESS            All the blocks were transferred.
+  @retval Others                 Fail to transfer all the blocks.
 
 **/
+STATIC
 EFI_STATUS
-ReadSectors (
+NvmeTransferSectors (
   IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN UINT8                              Opcode,
   IN UINT64                             Buffer,
   IN UINT64                             Lba,
-  IN UINT32                             Blocks
+  IN UINTN                              Blocks
   )
 {
-  NVME_CONTROLLER_PRIVATE_DATA             *Private;
-  UINT32                                   Bytes;
-  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET CommandPacket;
-  EFI_NVM_EXPRESS_COMMAND                  Command;
-  EFI_NVM_EXPRESS_COMPLETION               Completion;
-  EFI_STATUS                               Status;
-  UINT32                                   BlockSize;
+  NVME_CONTROLLER_PRIVATE_DATA          *Private;
+  NVME_IO_REQUEST                       Request;
+  EFI_EVENT                             TimerEvent;
+  EFI_STATUS                            Status;
 
-  Private    = Device->Controller;
-  BlockSize  = Device->Media.BlockSize;
-  Bytes      = Blocks * BlockSize;
+  Private = Device->Controller;
 
-  ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
-  ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
-  ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
+  ZeroMem (&Request, sizeof (NVME_IO_REQUEST));
+  Request.Signature = NVME_IO_REQUEST_SIGNATURE;
+  Request.Device    = Device;
+  Request.Opcode    = Opcode;
+  Request.Buffer    = Buffer;
+  Request.Lba       = Lba;
+  Request.Blocks    = Blocks;
+  Request.Status    = EFI_SUCCESS;
 
-  CommandPacket.NvmeCmd        = &Command;
-  CommandPacket.NvmeCompletion = &Completion;
+  //
+  // The timeout applies to the wait for the next completion, not to the
+  // whole transfer.
+  //
+  Status = gBS->CreateEvent (EVT_TIMER, TPL_CALLBACK, NULL, NULL, &TimerEvent);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
 
-  CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_READ_OPC;
-  CommandPacket.NvmeCmd->Nsid        = Device->NamespaceId;
-  CommandPacket.TransferBuffer       = (VOID *)(UINTN)Buffer;
+  while (!NVME_IO_REQUEST_DONE (&Request)) {
+    if (NvmeQueueRequest (&Request) != 0) {
+      NvmeRingSqDoorbell (Private, NVME_IO_QUEUE);
+    }
 
-  CommandPacket.TransferLength = Bytes;
-  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
-  CommandPacket.QueueType      = NVME_IO_QUEUE;
+    if (NvmeReapCommands (Private) != 0) {
+      gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+    } else if (!EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
+      NvmeAbandonCommands (Private);
+      break;
+    }
+  }
 
-  CommandPacket.NvmeCmd->Cdw10 = (UINT32)Lba;
-  CommandPacket.NvmeCmd->Cdw11 = (UINT32)(Lba >> 32);
-  CommandPacket.NvmeCmd->Cdw12 = (Blocks - 1) & 0xFFFF;
+  gBS->CloseEvent (TimerEvent);
 
-  CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+  return Request.Status;
+}
 
-  Status = Private->Passthru.PassThru (
-                               &Private->Passthru,
-                               Device->NamespaceId,
-                               &CommandPacket,
-                               NULL
-                               );
+/**
+  Signal the token of every asynchronous request whose commands have all
+  completed, and free the request.
 
-  return Status;
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+STATIC
+VOID
+NvmeCompleteAsyncRequests (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  LIST_ENTRY                            *Link;
+  LIST_ENTRY                            *NextLink;
+  NVME_IO_REQUEST                       *Request;
+
+  for (Link = GetFirstNode (&Private->AsyncQueue);
+       !IsNull (&Private->AsyncQueue, Link);
+       Link = NextLink) {
+    NextLink = GetNextNode (&Private->AsyncQueue, Link);
+    Request  = NVME_IO_REQUEST_FROM_LINK (Link);
+
+    if (NVME_IO_REQUEST_DONE (Request)) {
+      RemoveEntryList (&Request->Link);
+      Request->Token->TransactionStatus = Request->Status;
+      gBS->SignalEvent (Request->Token->Event);
+      FreePool (Request);
+    }
+  }
+}
+
+/**
+  Push back the deadline for the next completion of the asynchronous commands
+  of a controller by NVME_GENERIC_TIMEOUT.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+STATIC
+VOID
+NvmeResetAsyncTimeout (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  //
+  // Clear an expiry that was not checked before the timer is re-armed
+  //
+  gBS->CheckEvent (Private->AsyncTimeoutEvent);
+  gBS->SetTimer (Private->AsyncTimeoutEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+}
+
+/**
+  Timer notification function serving the asynchronous requests of a controller.
+
+  Commands of the queued requests are handed to the controller in submission
+  order as slots become free, completions are reaped and the tokens of the
+  requests that are done are signaled. A flush is only started once every
+  request queued before it is complete.
+
+  @param  Event                  The timer event, or NULL when called directly.
+  @param  Context                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+EFIAPI
+NvmeProcessAsyncQueue (
+  IN EFI_EVENT                          Event,
+  IN VOID                               *Context
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA          *Private;
+  LIST_ENTRY                            *Link;
+  NVME_IO_REQUEST                       *Request;
+  UINTN                                 Queued;
+
+  Private = (NVME_CONTROLLER_PRIVATE_DATA *)Context;
+  Queued  = 0;
+
+  for (Link = GetFirstNode (&Private->AsyncQueue);
+       !IsNull (&Private->AsyncQueue, Link);
+       Link = GetNextNode (&Private->AsyncQueue, Link)) {
+    if (Private->IoSlotsBusy == Private->QueueSize[NVME_IO_QUEUE]) {
+      break;
+    }
+
+    Request = NVME_IO_REQUEST_FROM_LINK (Link);
+    if ((Request->Opcode == NVME_IO_FLUSH_OPC) && (Link != GetFirstNode (&Private->AsyncQueue))) {
+      break;
+    }
+
+    Queued += NvmeQueueRequest (Request);
+  }
+
+  if (Queued != 0) {
+    NvmeRingSqDoorbell (Private, NVME_IO_QUEUE);
+  }
+
+  //
+  // Time commands out once no completion arrived before the deadline. The
+  // timer period is only a lower bound on how often this runs, so the ticks
+  // cannot be counted instead.
+  //
+  if (NvmeReapCommands (Private) != 0 || Private->IoSlotsBusy == Private->IoSlotsQuarantined) {
+    NvmeResetAsyncTimeout (Private);
+  } else if (!EFI_ERROR (gBS->CheckEvent (Private->AsyncTimeoutEvent))) {
+    NvmeAbandonCommands (Private);
+    NvmeResetAsyncTimeout (Private);
+  }
+
+  NvmeCompleteAsyncRequests (Private);
+
+  if (IsListEmpty (&Private->AsyncQueue)) {
+    gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+    gBS->SetTimer (Private->AsyncTimeoutEvent, TimerCancel, 0);
+  }
 }
 
 /**
-  Write some sectors to the device.
+  Complete the asynchronous requests of a namespace, or of every namespace,
+  with EFI_ABORTED. The commands they have in flight are waited for first.
+
+  @param  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Device                 The namespace, or NULL for every namespace.
+
+**/
+VOID
+NvmeAbortAsyncRequests (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_DEVICE_PRIVATE_DATA           *Device OPTIONAL
+  )
+{
+  LIST_ENTRY                            *Link;
+  NVME_IO_REQUEST                       *Request;
+  EFI_TPL                               OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  for (Link = GetFirstNode (&Private->AsyncQueue);
+       !IsNull (&Private->AsyncQueue, Link);
+       Link = GetNextNode (&Private->AsyncQueue, Link)) {
+    Request = NVME_IO_REQUEST_FROM_LINK (Link);
+    if ((Device == NULL || Request->Device == Device) && !EFI_ERROR (Request->Status)) {
+      Request->Status = EFI_ABORTED;
+    }
+  }
+
+  NvmeWaitIoSlots (Private);
+  NvmeCompleteAsyncRequests (Private);
+
+  if (IsListEmpty (&Private->AsyncQueue)) {
+    gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+    gBS->SetTimer (Private->AsyncTimeoutEvent, TimerCancel, 0);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Queue an asynchronous read, write or flush and start serving it.
 
   @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
-  @param  Buffer                 The buffer to be written into the device.
+  @param  Opcode                 NVME_IO_READ_OPC, NVME_IO_WRITE_OPC or NVME_IO_FLUSH_OPC.
+  @param  Buffer                 The buffer to transfer the data to or from.
   @param  Lba                    The start block number.
-  @param  Blocks                 Total block number to be written.
+  @param  Blocks                 Total block number to be transferred.
+  @param  Token                  The token signaled when the request completes.
 
-  @retval EFI_SUCCESS            Datum are written into the buffer.
-  @retval Others                 Fail to write all the datum.
+  @retval EFI_SUCCESS            The request is queued.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be allocated.
 
 **/
+STATIC
 EFI_STATUS
-WriteSectors (
-  IN NVME_DEVICE_PRIVATE_DATA      *Device,
-  IN UINT64                        Buffer,
-  IN UINT64                        Lba,
-  IN UINT32                        Blocks
+NvmeQueueAsyncRequest (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN UINT8                              Opcode,
+  IN UINT64                             Buffer,
+  IN UINT64                             Lba,
+  IN UINTN                              Blocks,
+  IN EFI_BLOCK_IO2_TOKEN                *Token
   )
 {
-  NVME_CONTROLLER_PRIVATE_DATA             *Private;
-  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET CommandPacket;
-  EFI_NVM_EXPRESS_COMMAND                  Command;
-  EFI_NVM_EXPRESS_COMPLETION               Completion;
-  EFI_STATUS                               Status;
-  UINT32                                   Bytes;
-  UINT32                                   BlockSize;
-
-  Private    = Device->Controller;
-  BlockSize  = Device->Media.BlockSize;
-  Bytes      = Blocks * BlockSize;
+  NVME_CONTROLLER_PRIVATE_DATA          *Private;
+  NVME_IO_REQUEST                       *Request;
+  EFI_TPL                               OldTpl;
 
-  ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
-  ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
-  ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
+  Private = Device->Controller;
 
-  CommandPacket.NvmeCmd        = &Command;
-  CommandPacket.NvmeCompletion = &Completion;
+  Request = AllocateZeroPool (sizeof (NVME_IO_REQUEST));
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-  CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_WRITE_OPC;
-  CommandPacket.NvmeCmd->Nsid  = Device->NamespaceId;
-  CommandPacket.TransferBuffer = (VOID *)(UINTN)Buffer;
+  Request->Signature = NVME_IO_REQUEST_SIGNATURE;
+  Request->Device    = Device;
+  Request->Token     = Token;
+  Request->Opcode    = Opcode;
+  Request->Buffer    = Buffer;
+  Request->Lba       = Lba;
+  Request->Blocks    = Blocks;
+  Request->Status    = EFI_SUCCESS;
 
-  CommandPacket.TransferLength = Bytes;
-  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
-  CommandPacket.QueueType      = NVME_IO_QUEUE;
+  Token->TransactionStatus = EFI_NOT_READY;
 
-  CommandPacket.NvmeCmd->Cdw10 = (UINT32)Lba;
-  CommandPacket.NvmeCmd->Cdw11 = (UINT32)(Lba >> 32);
-  CommandPacket.NvmeCmd->Cdw12 = (Blocks - 1) & 0xFFFF;
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
 
-  CommandPacket.MetadataBuffer = NULL;
-  CommandPacket.MetadataLength = 0;
+  if (IsListEmpty (&Private->AsyncQueue)) {
+    gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_ASYNC_TIMER_PERIOD);
+    NvmeResetAsyncTimeout (Private);
+  }
+  InsertTailList (&Private->AsyncQueue, &Request->Link);
 
-  CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+  //
+  // Hand the first commands to the controller right away rather than on
+  // the next tick.
+  //
+  NvmeProcessAsyncQueue (NULL, Private);
 
-  Status = Private->Passthru.PassThru (
-                               &Private->Passthru,
-                               Device->NamespaceId,
-                               &CommandPacket,
-                               NULL
-                               );
+  gBS->RestoreTPL (OldTpl);
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 /**
@@ -165,40 +699,10 @@ NvmeRead (
   )
 {
   EFI_STATUS                       Status;
-  UINT32                           BlockSize;
-  NVME_CONTROLLER_PRIVATE_DATA     *Private;
-  UINT32                           MaxTransferBlocks;
-  UINTN                            OrginalBlocks;
-
-  Status        = EFI_SUCCESS;
-  Private       = Device->Controller;
-  BlockSize     = Device->Media.BlockSize;
-  OrginalBlocks = Blocks;
-
-  if (Private->ControllerData->Mdts != 0) {
-    MaxTransferBlocks = (1 << (Private->ControllerData->Mdts)) * (1 << (Private->Cap.Mpsmin + 12)) / BlockSize;
-  } else {
-    MaxTransferBlocks = 1024;
-  }
 
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
-  }
+  Status = NvmeTransferSectors (Device, NVME_IO_READ_OPC, (UINT64)(UINTN)Buffer, Lba, Blocks);
 
-  DEBUG ((EFI_D_INFO, "NvmeRead()  Lba = 0x%08x, Original = 0x%08x, Remaining = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, OrginalBlocks, Blocks, BlockSize, Status));
+  DEBUG ((EFI_D_INFO, "NvmeRead()  Lba = 0x%08x, Blocks = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, Blocks, Device->Media.BlockSize, Status));
 
   return Status;
 }
@@ -224,40 +728,10 @@ NvmeWrite (
   )
 {
   EFI_STATUS                       Status;
-  UINT32                           BlockSize;
-  NVME_CONTROLLER_PRIVATE_DATA     *Private;
-  UINT32                           MaxTransferBlocks;
-  UINTN                            OrginalBlocks;
 
-  Status        = EFI_SUCCESS;
-  Private       = Device->Controller;
-  BlockSize     = Device->Media.BlockSize;
-  OrginalBlocks = Blocks;
+  Status = NvmeTransferSectors (Device, NVME_IO_WRITE_OPC, (UINT64)(UINTN)Buffer, Lba, Blocks);
 
-  if (Private->ControllerData->Mdts != 0) {
-    MaxTransferBlocks = (1 << (Private->ControllerData->Mdts)) * (1 << (Private->Cap.Mpsmin + 12)) / BlockSize;
-  } else {
-    MaxTransferBlocks = 1024;
-  }
-
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
-  }
-
-  DEBUG ((EFI_D_INFO, "NvmeWrite() Lba = 0x%08x, Original = 0x%08x, Remaining = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, OrginalBlocks, Blocks, BlockSize, Status));
+  DEBUG ((EFI_D_INFO, "NvmeWrite() Lba = 0x%08x, Blocks = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, Blocks, Device->Media.BlockSize, Status));
 
   return Status;
 }
@@ -276,34 +750,7 @@ NvmeFlush (
   IN NVME_DEVICE_PRIVATE_DATA      *Device
   )
 {
-  NVME_CONTROLLER_PRIVATE_DATA             *Private;
-  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET CommandPacket;
-  EFI_NVM_EXPRESS_COMMAND                  Command;
-  EFI_NVM_EXPRESS_COMPLETION               Completion;
-  EFI_STATUS                               Status;
-
-  Private = Device->Controller;
-
-  ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
-  ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
-  ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
-
-  CommandPacket.NvmeCmd        = &Command;
-  CommandPacket.NvmeCompletion = &Completion;
-
-  CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_FLUSH_OPC;
-  CommandPacket.NvmeCmd->Nsid  = Device->NamespaceId;
-  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
-  CommandPacket.QueueType      = NVME_IO_QUEUE;
-
-  Status = Private->Passthru.PassThru (
-                               &Private->Passthru,
-                               Device->NamespaceId,
-                               &CommandPacket,
-                               NULL
-                               );
-
-  return Status;
+  return NvmeTransferSectors (Device, NVME_IO_FLUSH_OPC, 0, 0, 0);
 }
 
 
@@ -560,6 +1007,291 @@ NvmeBlockIoFlushBlocks (
   return Status;
 }
 
+/**
+  Read or write BufferSize bytes at Lba, without blocking when a token with an
+  event is supplied.
+
+  @param  This       Indicates a pointer to the calling context.
+  @param  Opcode     NVME_IO_READ_OPC or NVME_IO_WRITE_OPC.
+  @param  MediaId    The media ID that the request is for.
+  @param  Lba        The starting logical block address.
+  @param  Token      A pointer to the token associated with the transaction.
+  @param  BufferSize Size of Buffer, must be a multiple of device block size.
+  @param  Buffer     A pointer to the data buffer.
+
+  @retval EFI_SUCCESS           The request was queued if Token->Event is not
+                                NULL, or the data was transferred otherwise.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing the transfer.
+  @retval EFI_MEDIA_CHANGED     The MediaId does not matched the current device.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER The request contains LBAs that are not valid,
+                                or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a lack
+                                of resources.
+
+**/
+STATIC
+EFI_STATUS
+NvmeBlockIoTransferEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT8                  Opcode,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN OUT VOID                   *Buffer
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_BLOCK_IO_MEDIA                *Media;
+  UINTN                             BlockSize;
+  UINTN                             NumberOfBlocks;
+  UINTN                             IoAlign;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Media = This->Media;
+
+  if (MediaId != Media->MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = Media->BlockSize;
+  if ((BufferSize % BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Buffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    return NvmeQueueAsyncRequest (Device, Opcode, (UINT64)(UINTN)Buffer, Lba, NumberOfBlocks, Token);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  if (Opcode == NVME_IO_READ_OPC) {
+    Status = NvmeRead (Device, Buffer, Lba, NumberOfBlocks);
+  } else {
+    Status = NvmeWrite (Device, Buffer, Lba, NumberOfBlocks);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Reset the block device hardware.
+
+  @param[in]  This                 Indicates a pointer to the calling context.
+  @param[in]  ExtendedVerification Indicates that the driver may perform a more
+                                   exhausive verfication operation of the device
+                                   during reset.
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could
+                               not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoResetEx (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN  BOOLEAN                 ExtendedVerification
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA        *Device;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  NvmeAbortAsyncRequests (Device->Controller, Device);
+
+  return NvmeBlockIoReset (&Device->BlockIo, ExtendedVerification);
+}
+
+/**
+  Read BufferSize bytes from Lba into Buffer.
+
+  This function reads the requested number of blocks from the device. All the
+  blocks are read, or an error is returned.
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_or EFI_MEDIA_CHANGED is returned and
+  non-blocking I/O is being used, the Event associated with this request will
+  not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    Id of the media, changes every time the media is
+                              replaced.
+  @param[in]       Lba        The starting Logical Block Address to read from.
+  @param[in, out]  Token      A pointer to the token associated with the transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block size.
+  @param[out]      Buffer     A pointer to the destination buffer for the data. The
+                              caller is responsible for either having implicit or
+                              explicit ownership of the buffer.
+
+  @retval EFI_SUCCESS           The read request was queued if Token->Event is
+                                not NULL.The data was read correctly from the
+                                device if the Token->Event is NULL.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing
+                                the read.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHANGED     The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE   The BufferSize parameter is not a multiple of the
+                                intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER The read request contains LBAs that are not valid,
+                                or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a lack
+                                of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                   *Buffer
+  )
+{
+  return NvmeBlockIoTransferEx (This, NVME_IO_READ_OPC, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+/**
+  Write BufferSize bytes from Lba into Buffer.
+
+  This function writes the requested number of blocks to the device. All blocks
+  are written, or an error is returned.If EFI_DEVICE_ERROR, EFI_NO_MEDIA,
+  EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED is returned and non-blocking I/O is
+  being used, the Event associated with this request will not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    The media ID that the write request is for.
+  @param[in]       Lba        The starting logical block address to be written.
+                              The caller is responsible for writing to only
+                              legitimate locations.
+  @param[in, out]  Token      A pointer to the token associated with the
+                              transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block
+                              size.
+  @param[in]       Buffer     A pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS           The write request was queued if Event is not
+                                NULL.
+                                The data was written correctly to the device if
+                                the Event is NULL.
+  @retval EFI_WRITE_PROTECTED   The device can not be written to.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHNAGED     The MediaId does not matched the current device.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing
+                                the write.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size
+                                of the device.
+  @retval EFI_INVALID_PARAMETER The write request contains LBAs that are not
+                                valid, or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a
+                                lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  )
+{
+  return NvmeBlockIoTransferEx (This, NVME_IO_WRITE_OPC, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+/**
+  Flush the Block Device.
+
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED
+  is returned and non-blocking I/O is being used, the Event associated with
+  this request will not be signaled.
+
+  @param[in]      This     Indicates a pointer to the calling context.
+  @param[in,out]  Token    A pointer to the token associated with the
+                           transaction.
+
+  @retval EFI_SUCCESS          The flush request was queued if Event is not
+                               NULL.
+                               All outstanding data was written correctly to
+                               the device if the Event is NULL.
+  @retval EFI_DEVICE_ERROR     The device reported an error while writting back
+                               the data.
+  @retval EFI_WRITE_PROTECTED  The device cannot be written to.
+  @retval EFI_NO_MEDIA         There is no media in the device.
+  @retval EFI_MEDIA_CHANGED    The MediaId is not for the current media.
+  @retval EFI_OUT_OF_RESOURCES The request could not be completed due to a lack
+                               of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA        *Device;
+  EFI_STATUS                      Status;
+  EFI_TPL                         OldTpl;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    return NvmeQueueAsyncRequest (Device, NVME_IO_FLUSH_OPC, 0, 0, 0, Token);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Status = NvmeFlush (Device);
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
 /**
   Trust transfer data from/to NVMe device.
 
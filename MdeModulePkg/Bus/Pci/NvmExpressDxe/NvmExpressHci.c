@@ -698,7 +698,7 @@ NvmeCreateIoCompletionQueue (
   CommandPacket.QueueType      = NVME_ADMIN_QUEUE;
 
   CrIoCq.Qid   = NVME_IO_QUEUE;
-  CrIoCq.Qsize = NVME_CCQ_SIZE;
+  CrIoCq.Qsize = Private->QueueSize[NVME_IO_QUEUE];
   CrIoCq.Pc    = 1;
   CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoCq, sizeof (NVME_ADMIN_CRIOCQ));
   CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
@@ -748,7 +748,7 @@ NvmeCreateIoSubmissionQueue (
   CommandPacket.QueueType      = NVME_ADMIN_QUEUE;
 
   CrIoSq.Qid   = NVME_IO_QUEUE;
-  CrIoSq.Qsize = NVME_CSQ_SIZE;
+  CrIoSq.Qsize = Private->QueueSize[NVME_IO_QUEUE];
   CrIoSq.Pc    = 1;
   CrIoSq.Cqid  = NVME_IO_QUEUE;
   CrIoSq.Qprio = 0;
@@ -785,6 +785,8 @@ NvmeControllerInit (
   NVME_AQA                        Aqa;
   NVME_ASQ                        Asq;
   NVME_ACQ                        Acq;
+  UINTN                           IoQueueEntries;
+  UINTN                           Index;
 
   //
   // Save original PCI attributes and enable this controller.
@@ -844,12 +846,41 @@ NvmeControllerInit (
   Private->Cid[0] = 0;
   Private->Cid[1] = 0;
 
+  //
+  // The I/O queue pair is as deep as the platform asks for, within what both
+  // the controller and the single page holding each queue allow.
+  //
+  IoQueueEntries = PcdGet16 (PcdNvmExpressIoQueueDepth);
+  IoQueueEntries = MIN (IoQueueEntries, NVME_MAX_IO_QUEUE_ENTRIES);
+  IoQueueEntries = MIN (IoQueueEntries, (UINTN)Private->Cap.Mqes + 1);
+  IoQueueEntries = MAX (IoQueueEntries, 2);
+
+  Private->QueueSize[NVME_ADMIN_QUEUE] = NVME_ASQ_SIZE;
+  Private->QueueSize[NVME_IO_QUEUE]    = (UINT16)(IoQueueEntries - 1);
+
   Status = NvmeDisableController (Private);
 
   if (EFI_ERROR(Status)) {
     return Status;
   }
 
+  //
+  // Commands still in flight are lost with the controller disabled.
+  //
+  for (Index = 0; Index < NVME_MAX_IO_QUEUE_ENTRIES; Index++) {
+    if (Private->IoSlot[Index].Busy) {
+      NvmeReleaseSlot (Private, &Private->IoSlot[Index], EFI_ABORTED);
+    }
+  }
+
+  //
+  // Start from empty queues, also when the controller is being reset.
+  //
+  ZeroMem (Private->SqTdbl, sizeof (Private->SqTdbl));
+  ZeroMem (Private->CqHdbl, sizeof (Private->CqHdbl));
+  ZeroMem (Private->Pt, sizeof (Private->Pt));
+  ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (4));
+
   //
   // set number of entries admin submission & completion queues.
   //
@@ -889,6 +920,7 @@ NvmeControllerInit (
   DEBUG ((EFI_D_INFO, "Admin Completion Queue (CqBuffer[0]) = [%016X]\n", Private->CqBuffer[0]));
   DEBUG ((EFI_D_INFO, "I/O   Submission Queue (SqBuffer[1]) = [%016X]\n", Private->SqBuffer[1]));
   DEBUG ((EFI_D_INFO, "I/O   Completion Queue (CqBuffer[1]) = [%016X]\n", Private->CqBuffer[1]));
+  DEBUG ((EFI_D_INFO, "I/O   Queue size (QueueSize[1]) = [%08X]\n", Private->QueueSize[1]));
 
   //
   // Program admin queue attributes.
@@ -923,12 +955,15 @@ NvmeControllerInit (
   }
 
   //
-  // Allocate buffer for Identify Controller data
+  // Allocate buffer for Identify Controller data, unless the controller is
+  // being reset.
   //
-  Private->ControllerData = (NVME_ADMIN_CONTROLLER_DATA *)AllocateZeroPool (sizeof(NVME_ADMIN_CONTROLLER_DATA));
-
   if (Private->ControllerData == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+    Private->ControllerData = (NVME_ADMIN_CONTROLLER_DATA *)AllocateZeroPool (sizeof(NVME_ADMIN_CONTROLLER_DATA));
+
+    if (Private->ControllerData == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
   }
 
   //
@@ -315,6 +315,106 @@ EXIT:
   return NULL;
 }
 
+/**
+  Move the tail of a submission queue past the entry just filled in.
+
+  The doorbell is not rung, so several commands can be handed to the controller
+  with a single NvmeRingSqDoorbell() call.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+**/
+VOID
+NvmeAdvanceSqTail (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  )
+{
+  if (Private->SqTdbl[QueueType].Sqt == Private->QueueSize[QueueType]) {
+    Private->SqTdbl[QueueType].Sqt = 0;
+  } else {
+    Private->SqTdbl[QueueType].Sqt++;
+  }
+}
+
+/**
+  Tell the controller about the commands queued since the last doorbell write.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+  @return The status of the register write.
+
+**/
+EFI_STATUS
+NvmeRingSqDoorbell (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  )
+{
+  UINT32                        Data;
+
+  Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[QueueType]);
+  return Private->PciIo->Mem.Write (
+                               Private->PciIo,
+                               EfiPciIoWidthUint32,
+                               NVME_BAR,
+                               NVME_SQTDBL_OFFSET(QueueType, Private->Cap.Dstrd),
+                               1,
+                               &Data
+                               );
+}
+
+/**
+  Move the head of a completion queue past the entry just consumed, flipping
+  the expected phase tag when the head wraps around.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+**/
+VOID
+NvmeAdvanceCqHead (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  )
+{
+  if (Private->CqHdbl[QueueType].Cqh == Private->QueueSize[QueueType]) {
+    Private->CqHdbl[QueueType].Cqh = 0;
+    Private->Pt[QueueType] ^= 1;
+  } else {
+    Private->CqHdbl[QueueType].Cqh++;
+  }
+}
+
+/**
+  Give the completion queue entries consumed so far back to the controller.
+
+  @param[in]  Private                The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  QueueType              NVME_ADMIN_QUEUE or NVME_IO_QUEUE.
+
+  @return The status of the register write.
+
+**/
+EFI_STATUS
+NvmeRingCqDoorbell (
+  IN NVME_CONTROLLER_PRIVATE_DATA     *Private,
+  IN UINT8                            QueueType
+  )
+{
+  UINT32                        Data;
+
+  Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueType]);
+  return Private->PciIo->Mem.Write (
+                               Private->PciIo,
+                               EfiPciIoWidthUint32,
+                               NVME_BAR,
+                               NVME_CQHDBL_OFFSET(QueueType, Private->Cap.Dstrd),
+                               1,
+                               &Data
+                               );
+}
 
 /**
   Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
@@ -375,7 +475,7 @@ NvmExpressPassThru (
   UINT64                        *Prp;
   VOID                          *PrpListHost;
   UINTN                         PrpListNo;
-  UINT32                        Data;
+  EFI_TPL                       OldTpl;
 
   //
   // check the data fields in Packet parameter.
@@ -403,14 +503,24 @@ NvmExpressPassThru (
   TimerEvent  = NULL;
   Status      = EFI_SUCCESS;
 
-  QueueType = Packet->QueueType;
-  Sq  = Private->SqBuffer[QueueType] + Private->SqTdbl[QueueType].Sqt;
-  Cq  = Private->CqBuffer[QueueType] + Private->CqHdbl[QueueType].Cqh;
-
   if (Packet->NvmeCmd->Nsid != NamespaceId) {
     return EFI_INVALID_PARAMETER;
   }
 
+  //
+  // Block I/O commands may be in flight on the I/O queue. Wait for them, and
+  // keep the asynchronous request timer off the queue until this command is done.
+  //
+  QueueType = Packet->QueueType;
+  OldTpl    = TPL_APPLICATION;
+  if (QueueType == NVME_IO_QUEUE) {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    NvmeWaitIoSlots (Private);
+  }
+
+  Sq  = Private->SqBuffer[QueueType] + Private->SqTdbl[QueueType].Sqt;
+  Cq  = Private->CqBuffer[QueueType] + Private->CqHdbl[QueueType].Cqh;
+
   ZeroMem (Sq, sizeof (NVME_SQ));
   Sq->Opc  = (UINT8)Packet->NvmeCmd->Cdw0.Opcode;
   Sq->Fuse = (UINT8)Packet->NvmeCmd->Cdw0.FusedOperation;
@@ -423,7 +533,8 @@ NvmExpressPassThru (
   ASSERT (Sq->Psdt == 0);
   if (Sq->Psdt != 0) {
     DEBUG ((EFI_D_ERROR, "NvmExpressPassThru: doesn't support SGL mechanism\n"));
-    return EFI_UNSUPPORTED;
+    Status = EFI_UNSUPPORTED;
+    goto EXIT;
   }
 
   Sq->Prp[0] = (UINT64)(UINTN)Packet->TransferBuffer;
@@ -450,7 +561,8 @@ NvmExpressPassThru (
                       &MapData
                       );
     if (EFI_ERROR (Status) || (Packet->TransferLength != MapLength)) {
-      return EFI_OUT_OF_RESOURCES;
+      Status = EFI_OUT_OF_RESOURCES;
+      goto EXIT;
     }
 
     Sq->Prp[0] = PhyAddr;
@@ -468,12 +580,8 @@ NvmExpressPassThru (
                         &MapMeta
                         );
       if (EFI_ERROR (Status) || (Packet->MetadataLength != MapLength)) {
-        PciIo->Unmap (
-                 PciIo,
-                 MapData
-                 );
-
-        return EFI_OUT_OF_RESOURCES;
+        Status = EFI_OUT_OF_RESOURCES;
+        goto EXIT;
       }
       Sq->Mptr = PhyAddr;
     }
@@ -528,16 +636,8 @@ NvmExpressPassThru (
   //
   // Ring the submission queue doorbell.
   //
-  Private->SqTdbl[QueueType].Sqt ^= 1;
-  Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[QueueType]);
-  PciIo->Mem.Write (
-               PciIo,
-               EfiPciIoWidthUint32,
-               NVME_BAR,
-               NVME_SQTDBL_OFFSET(QueueType, Private->Cap.Dstrd),
-               1,
-               &Data
-               );
+  NvmeAdvanceSqTail (Private, QueueType);
+  NvmeRingSqDoorbell (Private, QueueType);
 
   Status = gBS->CreateEvent (
                   EVT_TIMER,
@@ -589,19 +689,8 @@ NvmExpressPassThru (
     }
   }
 
-  if ((Private->CqHdbl[QueueType].Cqh ^= 1) == 0) {
-    Private->Pt[QueueType] ^= 1;
-  }
-
-  Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueType]);
-  PciIo->Mem.Write (
-               PciIo,
-               EfiPciIoWidthUint32,
-               NVME_BAR,
-               NVME_CQHDBL_OFFSET(QueueType, Private->Cap.Dstrd),
-               1,
-               &Data
-               );
+  NvmeAdvanceCqHead (Private, QueueType);
+  NvmeRingCqDoorbell (Private, QueueType);
 
 EXIT:
   if (MapData != NULL) {
@@ -632,6 +721,10 @@ EXIT:
   if (TimerEvent != NULL) {
     gBS->CloseEvent (TimerEvent);
   }
+
+  if (QueueType == NVME_IO_QUEUE) {
+    gBS->RestoreTPL (OldTpl);
+  }
   return Status;
 }
 
@@ -19,6 +19,13 @@
             all Befores. It then addes the item that was passed in and then
             processess the After dependecies by recursively calling the routine.
 
+  The protocols a Depex pushes are recorded in mDepexProtocolHash when the
+  Depex is read. Installing one of them marks the drivers waiting on it dirty,
+  and step #2 only evaluates the Depex of dirty drivers: a Depex made of PUSH,
+  AND and OR that evaluated to FALSE stays FALSE until one of its protocols
+  shows up. Drivers without a Depex or with a NOT in it are evaluated on every
+  pass as before.
+
   Dispatcher Rules:
   The rules for the dispatcher are in chapter 10 of the DXE CIS. Figure 10-3
   is the state diagram for the DXE dispatcher
@@ -67,6 +74,59 @@ EFI_LOCK  mDispatcherLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 //
 BOOLEAN  gDispatcherRunning = FALSE;
 
+//
+// Drivers that have been started, in dispatch order. List of
+// EFI_CORE_DRIVER_ENTRY linked through DispatchedLink.
+//
+LIST_ENTRY  mDispatchedList = INITIALIZE_LIST_HEAD_VARIABLE (mDispatchedList);
+UINTN       mDispatchCount  = 0;
+
+//
+// The driver being started, it is recorded as the producer of the protocols
+// it installs.
+//
+EFI_CORE_DRIVER_ENTRY  *mDispatchingDriver = NULL;
+
+//
+// Performance counter properties used to time driver load and start, read
+// once on first use. Only touched inside PERF_CODE, since the TimerLib the
+// DXE core links against may be the null instance otherwise.
+//
+UINT64      mDispatcherCounterFrequency = 0;
+BOOLEAN     mDispatcherCounterDown      = FALSE;
+
+//
+// Number of buckets in mDepexProtocolHash, must be a power of two.
+//
+#define DEPEX_PROTOCOL_HASH_SIZE  64
+
+//
+// A protocol pushed by the Depex of at least one driver. Protected by
+// mDispatcherLock.
+//
+#define DEPEX_PROTOCOL_SIGNATURE  SIGNATURE_32('d','p','x','p')
+typedef struct {
+  UINTN                   Signature;
+  LIST_ENTRY              Link;         // mDepexProtocolHash bucket
+  EFI_GUID                ProtocolGuid;
+  LIST_ENTRY              Waiters;      // list of DEPEX_WAITER
+  BOOLEAN                 Installed;
+  EFI_CORE_DRIVER_ENTRY   *Producer;    // driver that first installed it, if any
+} DEPEX_PROTOCOL;
+
+#define DEPEX_WAITER_SIGNATURE  SIGNATURE_32('d','p','x','w')
+typedef struct {
+  UINTN                   Signature;
+  LIST_ENTRY              Link;         // DEPEX_PROTOCOL.Waiters
+  EFI_CORE_DRIVER_ENTRY   *DriverEntry;
+} DEPEX_WAITER;
+
+//
+// The protocols of all Depex read so far, hashed by GUID. Entries are never
+// freed, like the mDiscoveredList they refer to.
+//
+LIST_ENTRY  mDepexProtocolHash[DEPEX_PROTOCOL_HASH_SIZE];
+
 //
 // Module globals to manage the FwVol registration notification event
 //
@@ -229,6 +289,280 @@ CoreReleaseDispatcherLock (
 }
 
 
+/**
+  Returns the mDepexProtocolHash bucket for a protocol GUID, initializing it
+  on first use. Protocols may be installed before the dispatcher is
+  initialized.
+
+  @param  Protocol              The GUID of the protocol.
+
+  @return The bucket the DEPEX_PROTOCOL is linked on.
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetDepexProtocolBucket (
+  IN  EFI_GUID                *Protocol
+  )
+{
+  UINT32                      Hash;
+  LIST_ENTRY                  *Bucket;
+
+  Hash = ReadUnaligned32 ((UINT32 *)Protocol) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 1) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 2) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 3);
+  Hash ^= Hash >> 16;
+
+  Bucket = &mDepexProtocolHash[Hash & (DEPEX_PROTOCOL_HASH_SIZE - 1)];
+  if (Bucket->ForwardLink == NULL) {
+    InitializeListHead (Bucket);
+  }
+
+  return Bucket;
+}
+
+
+/**
+  Find the DEPEX_PROTOCOL of a protocol GUID. The caller must hold
+  mDispatcherLock.
+
+  @param  Protocol              The GUID of the protocol.
+
+  @return The DEPEX_PROTOCOL, or NULL if no Depex read so far refers to it.
+
+**/
+STATIC
+DEPEX_PROTOCOL *
+CoreFindDepexProtocol (
+  IN  EFI_GUID                *Protocol
+  )
+{
+  LIST_ENTRY                  *Bucket;
+  LIST_ENTRY                  *Link;
+  DEPEX_PROTOCOL              *DepexProtocol;
+
+  Bucket = CoreGetDepexProtocolBucket (Protocol);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    DepexProtocol = CR (Link, DEPEX_PROTOCOL, Link, DEPEX_PROTOCOL_SIGNATURE);
+    if (CompareGuid (&DepexProtocol->ProtocolGuid, Protocol)) {
+      return DepexProtocol;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+  Make a driver wait on a protocol its Depex pushes. If memory runs out the
+  driver falls back to having its Depex evaluated on every pass.
+
+  @param  DriverEntry           The driver.
+  @param  Protocol              The GUID of the protocol.
+
+**/
+STATIC
+VOID
+CoreAddDepexWaiter (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN  EFI_GUID                *Protocol
+  )
+{
+  DEPEX_PROTOCOL              *DepexProtocol;
+  DEPEX_PROTOCOL              *NewProtocol;
+  DEPEX_WAITER                *Waiter;
+  DEPEX_WAITER                *LastWaiter;
+  VOID                        *Interface;
+  BOOLEAN                     Installed;
+
+  //
+  // Allocate outside of mDispatcherLock, it is held at TPL_HIGH_LEVEL.
+  //
+  Waiter      = AllocatePool (sizeof (DEPEX_WAITER));
+  NewProtocol = AllocatePool (sizeof (DEPEX_PROTOCOL));
+  if (Waiter == NULL || NewProtocol == NULL) {
+    DriverEntry->DepexAlwaysEvaluate = TRUE;
+    goto Done;
+  }
+
+  Installed = (BOOLEAN) !EFI_ERROR (CoreLocateProtocol (Protocol, NULL, &Interface));
+
+  CoreAcquireDispatcherLock ();
+
+  DepexProtocol = CoreFindDepexProtocol (Protocol);
+  if (DepexProtocol == NULL) {
+    DepexProtocol = NewProtocol;
+    NewProtocol   = NULL;
+
+    DepexProtocol->Signature = DEPEX_PROTOCOL_SIGNATURE;
+    CopyGuid (&DepexProtocol->ProtocolGuid, Protocol);
+    InitializeListHead (&DepexProtocol->Waiters);
+    DepexProtocol->Installed = Installed;
+    DepexProtocol->Producer  = NULL;
+    InsertTailList (CoreGetDepexProtocolBucket (Protocol), &DepexProtocol->Link);
+  }
+
+  //
+  // A Depex pushing the same protocol twice only needs to wait on it once.
+  // The waiters of one driver are added back to back.
+  //
+  if (!IsListEmpty (&DepexProtocol->Waiters)) {
+    LastWaiter = CR (DepexProtocol->Waiters.BackLink, DEPEX_WAITER, Link, DEPEX_WAITER_SIGNATURE);
+    if (LastWaiter->DriverEntry == DriverEntry) {
+      CoreReleaseDispatcherLock ();
+      goto Done;
+    }
+  }
+
+  Waiter->Signature   = DEPEX_WAITER_SIGNATURE;
+  Waiter->DriverEntry = DriverEntry;
+  InsertTailList (&DepexProtocol->Waiters, &Waiter->Link);
+  Waiter = NULL;
+
+  CoreReleaseDispatcherLock ();
+
+Done:
+  if (Waiter != NULL) {
+    FreePool (Waiter);
+  }
+  if (NewProtocol != NULL) {
+    FreePool (NewProtocol);
+  }
+}
+
+
+/**
+  Walk the Depex of a driver and make it wait on every protocol it pushes.
+  Drivers whose Depex has a NOT, which may turn TRUE when a protocol is
+  uninstalled, have their Depex evaluated on every pass instead.
+
+  @param  DriverEntry           The driver, its Depex has just been read.
+
+**/
+STATIC
+VOID
+CoreAddDepexWaiters (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINT8                       *Iterator;
+  UINT8                       *End;
+  EFI_GUID                    ProtocolGuid;
+
+  if (DriverEntry->Before || DriverEntry->After) {
+    //
+    // Never evaluated by CoreIsSchedulable ()
+    //
+    return;
+  }
+
+  Iterator = DriverEntry->Depex;
+  End      = Iterator + DriverEntry->DepexSize;
+  while (Iterator < End) {
+    switch (*Iterator) {
+    case EFI_DEP_PUSH:
+      if ((UINTN)(End - Iterator) < 1 + sizeof (EFI_GUID)) {
+        //
+        // Malformed, CoreIsSchedulable () never returns TRUE for it
+        //
+        return;
+      }
+      CopyMem (&ProtocolGuid, Iterator + 1, sizeof (EFI_GUID));
+      CoreAddDepexWaiter (DriverEntry, &ProtocolGuid);
+      Iterator += sizeof (EFI_GUID);
+      break;
+    case EFI_DEP_NOT:
+      DriverEntry->DepexAlwaysEvaluate = TRUE;
+      return;
+    case EFI_DEP_END:
+      return;
+    default:
+      break;
+    }
+    Iterator++;
+  }
+}
+
+
+/**
+  Tell the dispatcher that a protocol has been installed, so that the drivers
+  whose Depex refers to it are evaluated again on the next dispatcher pass.
+
+  @param  Protocol              The GUID of the installed protocol.
+
+**/
+VOID
+CoreNotifyDispatcherOfProtocol (
+  IN  EFI_GUID                *Protocol
+  )
+{
+  DEPEX_PROTOCOL              *DepexProtocol;
+  DEPEX_WAITER                *Waiter;
+  LIST_ENTRY                  *Link;
+
+  CoreAcquireDispatcherLock ();
+
+  DepexProtocol = CoreFindDepexProtocol (Protocol);
+  if (DepexProtocol != NULL) {
+    if (!DepexProtocol->Installed) {
+      DepexProtocol->Installed = TRUE;
+      DepexProtocol->Producer  = mDispatchingDriver;
+    }
+
+    for (Link = DepexProtocol->Waiters.ForwardLink; Link != &DepexProtocol->Waiters; Link = Link->ForwardLink) {
+      Waiter = CR (Link, DEPEX_WAITER, Link, DEPEX_WAITER_SIGNATURE);
+      Waiter->DriverEntry->DepexDirty = TRUE;
+    }
+  }
+
+  CoreReleaseDispatcherLock ();
+}
+
+
+/**
+  Return the time elapsed since a performance counter value. Must only be
+  called from PERF_CODE.
+
+  @param  Start                 The performance counter value to start from.
+
+  @return The elapsed time in nanoseconds, or 0 if the counter frequency is
+          unknown.
+
+**/
+STATIC
+UINT64
+CoreDispatcherElapsedTime (
+  IN  UINT64                  Start
+  )
+{
+  UINT64                      End;
+  UINT64                      Ticks;
+  UINT64                      CounterStart;
+  UINT64                      CounterEnd;
+  UINT64                      Remainder;
+
+  End = GetPerformanceCounter ();
+
+  if (mDispatcherCounterFrequency == 0) {
+    mDispatcherCounterFrequency = GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+    mDispatcherCounterDown      = (BOOLEAN) (CounterStart > CounterEnd);
+    if (mDispatcherCounterFrequency == 0) {
+      return 0;
+    }
+  }
+
+  Ticks = mDispatcherCounterDown ? Start - End : End - Start;
+
+  //
+  // Ticks * 1000000000 / Frequency, split to avoid overflowing 64 bits
+  //
+  Ticks = DivU64x64Remainder (Ticks, mDispatcherCounterFrequency, &Remainder);
+  return MultU64x32 (Ticks, 1000000000) +
+         DivU64x64Remainder (MultU64x32 (Remainder, 1000000000), mDispatcherCounterFrequency, NULL);
+}
+
+
 /**
   Read Depex and pre-process the Depex for Before and After. If Section Extraction
   protocol returns an error via ReadSection defer the reading of the Depex.
@@ -280,6 +614,7 @@ CoreGetDepexSectionAndPreProccess (
       DriverEntry->Depex = NULL;
       DriverEntry->Dependent = TRUE;
       DriverEntry->DepexProtocolError = FALSE;
+      DriverEntry->DepexAlwaysEvaluate = TRUE;
     }
   } else {
     //
@@ -288,8 +623,14 @@ CoreGetDepexSectionAndPreProccess (
     //
     CorePreProcessDepex (DriverEntry);
     DriverEntry->DepexProtocolError = FALSE;
+    CoreAddDepexWaiters (DriverEntry);
   }
 
+  //
+  // Evaluate the Depex at least once
+  //
+  DriverEntry->DepexDirty = TRUE;
+
   return Status;
 }
 
@@ -332,6 +673,7 @@ CoreSchedule (
       CoreAcquireDispatcherLock ();
       DriverEntry->Unrequested  = FALSE;
       DriverEntry->Dependent    = TRUE;
+      DriverEntry->DepexDirty   = TRUE;
       CoreReleaseDispatcherLock ();
 
       DEBUG ((DEBUG_DISPATCH, "Schedule FFS(%g) - EFI_SUCCESS\n", DriverName));
@@ -411,6 +753,95 @@ CoreEmptyCallbackFunction (
   return;
 }
 
+/**
+  Dump the drivers started since FirstDispatchOrder at DEBUG_DISPATCH level,
+  as a list in dispatch order with their load and start times, then as a DOT
+  graph with an edge from the producer of each protocol a Depex pushes to the
+  driver waiting on it. Protocols without a known producer, because they were
+  installed by the DXE core or before the Depex was read, appear as nodes of
+  their own.
+
+  @param  FirstDispatchOrder    DispatchOrder of the first driver to dump.
+
+**/
+STATIC
+VOID
+CoreDumpDispatchOrder (
+  IN  UINTN                   FirstDispatchOrder
+  )
+{
+  LIST_ENTRY                  *Link;
+  LIST_ENTRY                  *WaiterLink;
+  EFI_CORE_DRIVER_ENTRY       *DriverEntry;
+  DEPEX_PROTOCOL              *DepexProtocol;
+  DEPEX_WAITER                *Waiter;
+  UINTN                       Index;
+
+  if (!DebugPrintLevelEnabled (DEBUG_DISPATCH) || FirstDispatchOrder > mDispatchCount) {
+    return;
+  }
+
+  DEBUG ((DEBUG_DISPATCH, "DXE dispatch order:\n"));
+  for (Link = mDispatchedList.BackLink; Link != &mDispatchedList; Link = Link->BackLink) {
+    DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, DispatchedLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if (DriverEntry->DispatchOrder == FirstDispatchOrder) {
+      break;
+    }
+  }
+  for (; Link != &mDispatchedList; Link = Link->ForwardLink) {
+    DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, DispatchedLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if (!PerformanceMeasurementEnabled ()) {
+      DEBUG ((DEBUG_DISPATCH, "  %4d FFS(%g)\n", DriverEntry->DispatchOrder, &DriverEntry->FileName));
+      continue;
+    }
+    //
+    // Load and start times are only measured under PERF_CODE
+    //
+    DEBUG ((
+      DEBUG_DISPATCH,
+      "  %4d FFS(%g) load %ld us, start %ld us\n",
+      DriverEntry->DispatchOrder,
+      &DriverEntry->FileName,
+      DivU64x32 (DriverEntry->LoadTime, 1000),
+      DivU64x32 (DriverEntry->StartTime, 1000)
+      ));
+  }
+
+  DEBUG ((DEBUG_DISPATCH, "digraph DxeDispatch {\n"));
+  for (Index = 0; Index < DEPEX_PROTOCOL_HASH_SIZE; Index++) {
+    if (mDepexProtocolHash[Index].ForwardLink == NULL) {
+      continue;
+    }
+    for (Link = mDepexProtocolHash[Index].ForwardLink; Link != &mDepexProtocolHash[Index]; Link = Link->ForwardLink) {
+      DepexProtocol = CR (Link, DEPEX_PROTOCOL, Link, DEPEX_PROTOCOL_SIGNATURE);
+      for (WaiterLink = DepexProtocol->Waiters.ForwardLink; WaiterLink != &DepexProtocol->Waiters; WaiterLink = WaiterLink->ForwardLink) {
+        Waiter = CR (WaiterLink, DEPEX_WAITER, Link, DEPEX_WAITER_SIGNATURE);
+        if (Waiter->DriverEntry->DispatchOrder < FirstDispatchOrder) {
+          continue;
+        }
+        if (DepexProtocol->Producer != NULL) {
+          DEBUG ((
+            DEBUG_DISPATCH,
+            "  \"%g\" -> \"%g\" [label=\"%g\"];\n",
+            &DepexProtocol->Producer->FileName,
+            &Waiter->DriverEntry->FileName,
+            &DepexProtocol->ProtocolGuid
+            ));
+        } else {
+          DEBUG ((
+            DEBUG_DISPATCH,
+            "  \"%g\" [shape=box]; \"%g\" -> \"%g\";\n",
+            &DepexProtocol->ProtocolGuid,
+            &DepexProtocol->ProtocolGuid,
+            &Waiter->DriverEntry->FileName
+            ));
+        }
+      }
+    }
+  }
+  DEBUG ((DEBUG_DISPATCH, "}\n"));
+}
+
 /**
   This is the main Dispatcher for DXE and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -437,6 +868,8 @@ CoreDispatcher (
   EFI_CORE_DRIVER_ENTRY           *DriverEntry;
   BOOLEAN                         ReadyToRun;
   EFI_EVENT                       DxeDispatchEvent;
+  UINTN                           FirstDispatchOrder;
+  UINT64                          Start;
   
 
   if (gDispatcherRunning) {
@@ -460,6 +893,9 @@ CoreDispatcher (
     return Status;
   }
 
+  FirstDispatchOrder = mDispatchCount + 1;
+  Start              = 0;
+
   ReturnStatus = EFI_NOT_FOUND;
   do {
     //
@@ -480,6 +916,9 @@ CoreDispatcher (
       //
       if (DriverEntry->ImageHandle == NULL && !DriverEntry->IsFvImage) {
         DEBUG ((DEBUG_INFO, "Loading driver %g\n", &DriverEntry->FileName));
+        PERF_CODE (
+          Start = GetPerformanceCounter ();
+        );
         Status = CoreLoadImage (
                         FALSE,
                         gDxeCoreImageHandle,
@@ -488,6 +927,9 @@ CoreDispatcher (
                         0,
                         &DriverEntry->ImageHandle
                         );
+        PERF_CODE (
+          DriverEntry->LoadTime = CoreDispatcherElapsedTime (Start);
+        );
 
         //
         // Update the driver state to reflect that it's been loaded
@@ -528,8 +970,15 @@ CoreDispatcher (
       DriverEntry->Initialized  = TRUE;
       RemoveEntryList (&DriverEntry->ScheduledLink);
 
+      DriverEntry->DispatchOrder = ++mDispatchCount;
+      InsertTailList (&mDispatchedList, &DriverEntry->DispatchedLink);
+      mDispatchingDriver = DriverEntry;
+
       CoreReleaseDispatcherLock ();
 
+      PERF_CODE (
+        Start = GetPerformanceCounter ();
+      );
  
       if (DriverEntry->IsFvImage) {
         //
@@ -555,6 +1004,14 @@ CoreDispatcher (
           );
       }
 
+      PERF_CODE (
+        DriverEntry->StartTime = CoreDispatcherElapsedTime (Start);
+      );
+
+      CoreAcquireDispatcherLock ();
+      mDispatchingDriver = NULL;
+      CoreReleaseDispatcherLock ();
+
       ReturnStatus = EFI_SUCCESS;
     }
 
@@ -582,6 +1039,17 @@ CoreDispatcher (
       }
 
       if (DriverEntry->Dependent) {
+        if (!DriverEntry->DepexDirty && !DriverEntry->DepexAlwaysEvaluate) {
+          //
+          // The Depex was FALSE and none of its protocols has been installed
+          // since, so it still is.
+          //
+          continue;
+        }
+        //
+        // Clear before evaluating, a protocol installed from now on sets it again
+        //
+        DriverEntry->DepexDirty = FALSE;
         if (CoreIsSchedulable (DriverEntry)) {
           CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
           ReadyToRun = TRUE;
@@ -596,6 +1064,10 @@ CoreDispatcher (
     }
   } while (ReadyToRun);
 
+  DEBUG_CODE_BEGIN ();
+    CoreDumpDispatchOrder (FirstDispatchOrder);
+  DEBUG_CODE_END ();
+
   //
   // Close DXE dispatch Event
   //
@@ -199,6 +199,18 @@ typedef struct {
   EFI_HANDLE                      ImageHandle;
   BOOLEAN                         IsFvImage;
 
+  //
+  // DepexDirty is set when a protocol the Depex refers to is installed,
+  // DepexAlwaysEvaluate when the Depex must be evaluated on every pass.
+  //
+  BOOLEAN                         DepexDirty;
+  BOOLEAN                         DepexAlwaysEvaluate;
+
+  LIST_ENTRY                      DispatchedLink;   // mDispatchedList
+  UINTN                           DispatchOrder;
+  UINT64                          LoadTime;         // in nanoseconds
+  UINT64                          StartTime;        // in nanoseconds
+
 } EFI_CORE_DRIVER_ENTRY;
 
 //
@@ -483,6 +495,16 @@ CoreTimerTick (
   );
 
 
+/**
+  Reports how long the timer tick handler has run with interrupts masked.
+
+**/
+VOID
+CoreReportTimerTickStatistics (
+  VOID
+  );
+
+
 /**
   Initialize the dispatcher. Initialize the notification function that runs when
   an FV2 protocol is added to the system.
@@ -494,6 +516,19 @@ CoreInitializeDispatcher (
   );
 
 
+/**
+  Tell the dispatcher that a protocol has been installed, so that the drivers
+  whose Depex refers to it are evaluated again on the next dispatcher pass.
+
+  @param  Protocol              The GUID of the installed protocol.
+
+**/
+VOID
+CoreNotifyDispatcherOfProtocol (
+  IN  EFI_GUID                *Protocol
+  );
+
+
 /**
   This is the POSTFIX version of the dependency evaluator.  This code does
   not need to handle Before or After, as it is not valid to call this
@@ -2548,6 +2583,15 @@ CloseSectionStream (
   IN  BOOLEAN                                   FreeStreamBuffer
   );
 
+/**
+  Reports the hits and misses of the extracted section cache.
+
+**/
+VOID
+CoreReportSectionCacheStatistics (
+  VOID
+  );
+
 /**
   Creates and initializes the DebugImageInfo Table.  Also creates the configuration
   table and registers it into the system table.
@@ -741,6 +741,8 @@ CoreExitBootServices (
   // Disable Timer
   //
   gTimer->SetTimerPeriod (gTimer, 0);
+  CoreReportTimerTickStatistics ();
+  CoreReportSectionCacheStatistics ();
 
   //
   // Terminate memory services if the MapKey matches
@@ -16,17 +16,54 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "DxeMain.h"
 #include "Event.h"
 
+//
+// The timer database is a hierarchical timer wheel. Time is cut into slots
+// of 2^TIMER_WHEEL_SLOT_SHIFT 100ns units. The root wheel has a list for
+// each of the next TIMER_WHEEL_ROOT_SIZE slots, and every outer wheel a
+// list for each turn of the wheel inside it. When a wheel comes round, the
+// list of the next outer wheel for the turn starting is spread over it.
+// Events too far out for the outermost wheel wait on an overflow list that
+// is looked at each time that wheel comes round.
+//
+#define TIMER_WHEEL_SLOT_SHIFT    14
+#define TIMER_WHEEL_ROOT_BITS     8
+#define TIMER_WHEEL_LEVEL_BITS    6
+#define TIMER_WHEEL_LEVELS        3
+
+#define TIMER_WHEEL_ROOT_SIZE     (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE    (1 << TIMER_WHEEL_LEVEL_BITS)
+
+#define TIMER_WHEEL_LEVEL_SHIFT(a) (TIMER_WHEEL_ROOT_BITS + (a) * TIMER_WHEEL_LEVEL_BITS)
+
 //
 // Internal data
 //
 
-LIST_ENTRY       mEfiTimerList = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
+LIST_ENTRY       mEfiTimerRoot[TIMER_WHEEL_ROOT_SIZE];
+LIST_ENTRY       mEfiTimerLevel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+LIST_ENTRY       mEfiTimerOverflow = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerOverflow);
 EFI_LOCK         mEfiTimerLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
 EFI_EVENT        mEfiCheckTimerEvent = NULL;
 
+//
+// Slot the root wheel is at, and a time no timer expires before
+//
+UINT64           mEfiTimerSlot = 0;
+UINT64           mEfiTimerNextTrigger = 0;
+
 EFI_LOCK         mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64           mEfiSystemTime = 0;
 
+//
+// Time spent in CoreTimerTick (), in performance counter ticks. Only
+// accounted when performance measurement is enabled, since that is when
+// the platform is required to provide a real TimerLib.
+//
+BOOLEAN          mEfiTimerCounterDown = FALSE;
+UINT64           mEfiTimerTickCount = 0;
+UINT64           mEfiTimerTickTime = 0;
+UINT64           mEfiTimerTickMaxTime = 0;
+
 //
 // Timer functions
 //
@@ -42,29 +79,222 @@ CoreInsertEventTimer (
   IN IEVENT   *Event
   )
 {
-  UINT64          TriggerTime;
-  LIST_ENTRY      *Link;
-  IEVENT          *Event2;
+  UINT64          Slot;
+  UINT64          Delta;
+  UINTN           Level;
+  LIST_ENTRY      *List;
 
   ASSERT_LOCKED (&mEfiTimerLock);
 
   //
-  // Get the timer's trigger time
+  // Expired timers go to the slot the root wheel is at
   //
-  TriggerTime = Event->Timer.TriggerTime;
+  Slot = RShiftU64 (Event->Timer.TriggerTime, TIMER_WHEEL_SLOT_SHIFT);
+  if (Slot < mEfiTimerSlot) {
+    Slot = mEfiTimerSlot;
+  }
+  Delta = Slot - mEfiTimerSlot;
 
   //
-  // Insert the timer into the timer database in assending sorted order
+  // Pick the innermost wheel that reaches the trigger time
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  if (Delta < TIMER_WHEEL_ROOT_SIZE) {
+    List = &mEfiTimerRoot[(UINTN) Slot & (TIMER_WHEEL_ROOT_SIZE - 1)];
+  } else {
+    List = &mEfiTimerOverflow;
+    for (Level = 0; Level < TIMER_WHEEL_LEVELS; Level++) {
+      if (Delta < LShiftU64 (1, TIMER_WHEEL_LEVEL_SHIFT (Level + 1))) {
+        List = &mEfiTimerLevel[Level][(UINTN) RShiftU64 (Slot, TIMER_WHEEL_LEVEL_SHIFT (Level)) & (TIMER_WHEEL_LEVEL_SIZE - 1)];
+        break;
+      }
+    }
+  }
+
+  InsertTailList (List, &Event->Timer.Link);
+
+  if (Event->Timer.TriggerTime < mEfiTimerNextTrigger) {
+    mEfiTimerNextTrigger = Event->Timer.TriggerTime;
+  }
+}
+
+/**
+  Moves all the timer events of a list to the end of another one.
+
+  @param  List                   The list of timer events to empty
+  @param  Pending                The list to move them to
+
+**/
+STATIC
+VOID
+CoreMoveEventTimers (
+  IN     LIST_ENTRY   *List,
+  IN OUT LIST_ENTRY   *Pending
+  )
+{
+  if (IsListEmpty (List)) {
+    return;
+  }
+
+  List->ForwardLink->BackLink    = Pending->BackLink;
+  Pending->BackLink->ForwardLink = List->ForwardLink;
+  List->BackLink->ForwardLink    = Pending;
+  Pending->BackLink              = List->BackLink;
+  InitializeListHead (List);
+}
+
+/**
+  Inserts the timer events of a list back into the timer wheel.
+
+  @param  Pending                The list of timer events
+
+**/
+STATIC
+VOID
+CoreInsertEventTimers (
+  IN LIST_ENTRY   *Pending
+  )
+{
+  IEVENT          *Event;
+
+  while (!IsListEmpty (Pending)) {
+    Event = CR (Pending->ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+    RemoveEntryList (&Event->Timer.Link);
+    CoreInsertEventTimer (Event);
+  }
+}
+
+/**
+  Moves the timer events of a list of the timer wheel to where they belong
+  now that the root wheel has advanced.
+
+  @param  List                   The list of timer events
+
+**/
+STATIC
+VOID
+CoreRequeueEventTimers (
+  IN LIST_ENTRY   *List
+  )
+{
+  LIST_ENTRY      Pending;
+
+  //
+  // Take the whole list first, the overflow list can get events back
+  //
+  InitializeListHead (&Pending);
+  CoreMoveEventTimers (List, &Pending);
+  CoreInsertEventTimers (&Pending);
+}
+
+/**
+  Moves the root wheel straight to a slot, inserting every timer event
+  back relative to it. Used when time has moved on by more than a turn of
+  the root wheel, rather than stepping through each slot.
+
+  @param  Slot                   The slot to move the root wheel to
+
+**/
+STATIC
+VOID
+CoreRebaseTimerWheel (
+  IN UINT64       Slot
+  )
+{
+  LIST_ENTRY      Pending;
+  UINTN           Index;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  InitializeListHead (&Pending);
+
+  //
+  // Start from the slot the root wheel is at, so timers that expire
+  // together are signaled in the order they were set
+  //
+  for (Index = 0; Index < TIMER_WHEEL_ROOT_SIZE; Index++) {
+    CoreMoveEventTimers (&mEfiTimerRoot[((UINTN) mEfiTimerSlot + Index) & (TIMER_WHEEL_ROOT_SIZE - 1)], &Pending);
+  }
+  for (Index = 0; Index < TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SIZE; Index++) {
+    CoreMoveEventTimers (&mEfiTimerLevel[Index / TIMER_WHEEL_LEVEL_SIZE][Index % TIMER_WHEEL_LEVEL_SIZE], &Pending);
+  }
+  CoreMoveEventTimers (&mEfiTimerOverflow, &Pending);
+
+  mEfiTimerSlot = Slot;
+  CoreInsertEventTimers (&Pending);
+}
+
+/**
+  Advances the root wheel by one slot, spreading the outer wheels over the
+  inner ones as each of them comes round.
+
+**/
+STATIC
+VOID
+CoreAdvanceTimerWheel (
+  VOID
+  )
+{
+  UINTN           Level;
+  UINTN           Index;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  mEfiTimerSlot++;
+  if (((UINTN) mEfiTimerSlot & (TIMER_WHEEL_ROOT_SIZE - 1)) != 0) {
+    return;
+  }
+
+  for (Level = 0; Level < TIMER_WHEEL_LEVELS; Level++) {
+    Index = (UINTN) RShiftU64 (mEfiTimerSlot, TIMER_WHEEL_LEVEL_SHIFT (Level)) & (TIMER_WHEEL_LEVEL_SIZE - 1);
+    CoreRequeueEventTimers (&mEfiTimerLevel[Level][Index]);
+    if (Index != 0) {
+      return;
+    }
+  }
+
+  CoreRequeueEventTimers (&mEfiTimerOverflow);
+}
+
+/**
+  Finds a time no timer in the database expires before. It is the trigger
+  time of the earliest timer of the root wheel, or the time the root wheel
+  comes round when it is empty up to there.
 
-    if (Event2->Timer.TriggerTime > TriggerTime) {
+  @return The time
+
+**/
+STATIC
+UINT64
+CoreNextTimerTrigger (
+  VOID
+  )
+{
+  UINT64          Slot;
+  UINT64          TriggerTime;
+  LIST_ENTRY      *List;
+  LIST_ENTRY      *Link;
+  IEVENT          *Event;
+
+  for (Slot = mEfiTimerSlot; ; Slot++) {
+    if (Slot != mEfiTimerSlot && ((UINTN) Slot & (TIMER_WHEEL_ROOT_SIZE - 1)) == 0) {
+      return LShiftU64 (Slot, TIMER_WHEEL_SLOT_SHIFT);
+    }
+
+    List = &mEfiTimerRoot[(UINTN) Slot & (TIMER_WHEEL_ROOT_SIZE - 1)];
+    if (!IsListEmpty (List)) {
       break;
     }
   }
 
-  InsertTailList (Link, &Event->Timer.Link);
+  TriggerTime = MAX_UINT64;
+  for (Link = List->ForwardLink; Link != List; Link = Link->ForwardLink) {
+    Event = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+    if (Event->Timer.TriggerTime < TriggerTime) {
+      TriggerTime = Event->Timer.TriggerTime;
+    }
+  }
+
+  return TriggerTime;
 }
 
 /**
@@ -88,7 +318,7 @@ CoreCurrentSystemTime (
 }
 
 /**
-  Checks the sorted timer list against the current system time.
+  Checks the timer wheel against the current system time.
   Signals any expired event timer.
 
   @param  CheckEvent             Not used
@@ -103,60 +333,92 @@ CoreCheckTimers (
   )
 {
   UINT64                  SystemTime;
+  UINT64                  Slot;
   IEVENT                  *Event;
+  LIST_ENTRY              *List;
+  LIST_ENTRY              *Link;
+  LIST_ENTRY              *NextLink;
 
   //
   // Check the timer database for expired timers
   //
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
+  Slot = RShiftU64 (SystemTime, TIMER_WHEEL_SLOT_SHIFT);
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  if (Slot - mEfiTimerSlot >= TIMER_WHEEL_ROOT_SIZE) {
+    CoreRebaseTimerWheel (Slot);
+  }
 
-    //
-    // If this timer is not expired, then we're done
-    //
-    if (Event->Timer.TriggerTime > SystemTime) {
-      break;
-    }
+  //
+  // Every slot up to the current one is drained, the timers of the current
+  // slot that are not expired yet stay where they are
+  //
+  for (;;) {
+    List = &mEfiTimerRoot[(UINTN) mEfiTimerSlot & (TIMER_WHEEL_ROOT_SIZE - 1)];
 
-    //
-    // Remove this timer from the timer queue
-    //
+    for (Link = List->ForwardLink; Link != List; Link = NextLink) {
+      Event = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+      NextLink = Link->ForwardLink;
 
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
-
-    //
-    // Signal it
-    //
-    CoreSignalEvent (Event);
+      //
+      // If this timer is not expired, then leave it
+      //
+      if (Event->Timer.TriggerTime > SystemTime) {
+        continue;
+      }
 
-    //
-    // If this is a periodic timer, set it
-    //
-    if (Event->Timer.Period != 0) {
       //
-      // Compute the timers new trigger time
+      // Remove this timer from the timer queue
       //
-      Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+
+      RemoveEntryList (&Event->Timer.Link);
+      Event->Timer.Link.ForwardLink = NULL;
 
       //
-      // If that's before now, then reset the timer to start from now
+      // Signal it
       //
-      if (Event->Timer.TriggerTime <= SystemTime) {
-        Event->Timer.TriggerTime = SystemTime;
-        CoreSignalEvent (mEfiCheckTimerEvent);
-      }
+      CoreSignalEvent (Event);
 
       //
-      // Add the timer
+      // If this is a periodic timer, set it
       //
-      CoreInsertEventTimer (Event);
+      if (Event->Timer.Period != 0) {
+        //
+        // Compute the timers new trigger time
+        //
+        Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+
+        //
+        // If that's before now, then reset the timer to start from now
+        //
+        if (Event->Timer.TriggerTime <= SystemTime) {
+          Event->Timer.TriggerTime = SystemTime;
+          CoreSignalEvent (mEfiCheckTimerEvent);
+        }
+
+        //
+        // Add the timer
+        //
+        CoreInsertEventTimer (Event);
+
+        //
+        // A timer added back to the end of this slot is checked again
+        //
+        if (NextLink == List && Event->Timer.Link.ForwardLink == List) {
+          NextLink = &Event->Timer.Link;
+        }
+      }
     }
+
+    if (mEfiTimerSlot >= Slot) {
+      break;
+    }
+    CoreAdvanceTimerWheel ();
   }
 
+  mEfiTimerNextTrigger = CoreNextTimerTrigger ();
+
   CoreReleaseLock (&mEfiTimerLock);
 }
 
@@ -171,6 +433,21 @@ CoreInitializeTimer (
   )
 {
   EFI_STATUS  Status;
+  UINTN       Index;
+  UINT64      CounterStart;
+  UINT64      CounterEnd;
+
+  for (Index = 0; Index < TIMER_WHEEL_ROOT_SIZE; Index++) {
+    InitializeListHead (&mEfiTimerRoot[Index]);
+  }
+  for (Index = 0; Index < TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SIZE; Index++) {
+    InitializeListHead (&mEfiTimerLevel[Index / TIMER_WHEEL_LEVEL_SIZE][Index % TIMER_WHEEL_LEVEL_SIZE]);
+  }
+
+  PERF_CODE (
+    GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+    mEfiTimerCounterDown = (BOOLEAN) (CounterStart > CounterEnd);
+  );
 
   Status = CoreCreateEventInternal (
              EVT_NOTIFY_SIGNAL,
@@ -197,7 +474,13 @@ CoreTimerTick (
   IN UINT64   Duration
   )
 {
-  IEVENT          *Event;
+  UINT64          Start;
+  UINT64          Elapsed;
+
+  Start = 0;
+  PERF_CODE (
+    Start = GetPerformanceCounter ();
+  );
 
   //
   // Check runtiem flag in case there are ticks while exiting boot services
@@ -210,18 +493,56 @@ CoreTimerTick (
   mEfiSystemTime += Duration;
 
   //
-  // If the head of the list is expired, fire the timer event
-  // to process it
+  // If a timer may have expired, fire the timer event to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  if (mEfiTimerNextTrigger <= mEfiSystemTime) {
+    CoreSignalEvent (mEfiCheckTimerEvent);
+  }
 
-    if (Event->Timer.TriggerTime <= mEfiSystemTime) {
-      CoreSignalEvent (mEfiCheckTimerEvent);
+  CoreReleaseLock (&mEfiSystemTimeLock);
+
+  //
+  // Account the time spent here with interrupts masked
+  //
+  PERF_CODE (
+    if (mEfiTimerCounterDown) {
+      Elapsed = Start - GetPerformanceCounter ();
+    } else {
+      Elapsed = GetPerformanceCounter () - Start;
     }
+    mEfiTimerTickCount++;
+    mEfiTimerTickTime += Elapsed;
+    if (Elapsed > mEfiTimerTickMaxTime) {
+      mEfiTimerTickMaxTime = Elapsed;
+    }
+  );
+}
+
+
+/**
+  Reports how long the timer tick handler has run with interrupts masked.
+
+**/
+VOID
+CoreReportTimerTickStatistics (
+  VOID
+  )
+{
+  //
+  // mEfiTimerTickCount stays 0 unless PERF_CODE is enabled, so the
+  // TimerLib is only called here when the tick was actually measured
+  //
+  if (mEfiTimerTickCount == 0) {
+    return;
   }
 
-  CoreReleaseLock (&mEfiSystemTimeLock);
+  DEBUG ((
+    DEBUG_INFO,
+    "TimerTick: %ld ticks, %ld ns average, %ld ns max\n",
+    mEfiTimerTickCount,
+    DivU64x64Remainder (GetTimeInNanoSecond (mEfiTimerTickTime), mEfiTimerTickCount, NULL),
+    GetTimeInNanoSecond (mEfiTimerTickMaxTime)
+    ));
 }
 
 
@@ -288,6 +288,11 @@ FreeFvDeviceResource (
     FfsFileEntry = (FFS_FILE_LIST_ENTRY *) NextEntry;
   }
 
+  if (FvDevice->FileTypeIndex != NULL) {
+    CoreFreePool (FvDevice->FileTypeIndex);
+    FvDevice->FileTypeIndex = NULL;
+  }
+
   if (!FvDevice->IsMemoryMapped) {
     //
     // Free the cached FV buffer.
@@ -305,6 +310,104 @@ FreeFvDeviceResource (
 
 
 
+/**
+  Returns the FileHash bucket of a file name.
+
+  @param  FvDevice         The FV the file is in.
+  @param  Name             The file name.
+
+  @return The bucket the FFS_FILE_LIST_ENTRY of the file is linked on.
+
+**/
+LIST_ENTRY *
+FvGetFileHashBucket (
+  IN FV_DEVICE             *FvDevice,
+  IN CONST EFI_GUID        *Name
+  )
+{
+  UINT32                   Hash;
+
+  //
+  // File names are close to random, folding their four dwords is enough.
+  //
+  Hash = ReadUnaligned32 ((UINT32 *)Name) ^
+         ReadUnaligned32 ((UINT32 *)Name + 1) ^
+         ReadUnaligned32 ((UINT32 *)Name + 2) ^
+         ReadUnaligned32 ((UINT32 *)Name + 3);
+  Hash ^= Hash >> 16;
+
+  return &FvDevice->FileHash[Hash & (FV_FILE_HASH_SIZE - 1)];
+}
+
+
+
+/**
+  Index the file list of an FV by name and by type, so that ReadFile (),
+  ReadSection () and GetNextFile () for a given type do not walk the whole
+  list. Only the pad files are left out. If the type index cannot be
+  allocated GetNextFile () walks the list as before.
+
+  @param  FvDevice              The FV, its file list has just been built.
+
+**/
+VOID
+FvBuildFileIndex (
+  IN OUT FV_DEVICE  *FvDevice
+  )
+{
+  LIST_ENTRY                  *Link;
+  FFS_FILE_LIST_ENTRY         *FfsFileEntry;
+  EFI_FV_FILETYPE             Type;
+  UINTN                       Index;
+  UINTN                       Next[EFI_FV_FILETYPE_SMM_CORE + 2];
+
+  //
+  // Hash the files by name and count them by type, in Next[Type + 1]
+  //
+  ZeroMem (Next, sizeof (Next));
+  for (Link = FvDevice->FfsFileListHeader.ForwardLink; Link != &FvDevice->FfsFileListHeader; Link = Link->ForwardLink) {
+    FfsFileEntry = (FFS_FILE_LIST_ENTRY *) Link;
+    Type = FfsFileEntry->FfsHeader->Type;
+    if (Type == EFI_FV_FILETYPE_FFS_PAD) {
+      continue;
+    }
+
+    InsertTailList (FvGetFileHashBucket (FvDevice, &FfsFileEntry->FfsHeader->Name), &FfsFileEntry->HashLink);
+    if (Type <= EFI_FV_FILETYPE_SMM_CORE) {
+      Next[Type + 1]++;
+    }
+  }
+
+  FvDevice->FileTypeStart[0] = 0;
+  for (Index = 1; Index < EFI_FV_FILETYPE_SMM_CORE + 2; Index++) {
+    FvDevice->FileTypeStart[Index] = FvDevice->FileTypeStart[Index - 1] + Next[Index];
+  }
+
+  if (FvDevice->FileTypeStart[EFI_FV_FILETYPE_SMM_CORE + 1] == 0) {
+    return;
+  }
+
+  FvDevice->FileTypeIndex = AllocatePool (FvDevice->FileTypeStart[EFI_FV_FILETYPE_SMM_CORE + 1] * sizeof (FFS_FILE_LIST_ENTRY *));
+  if (FvDevice->FileTypeIndex == NULL) {
+    return;
+  }
+
+  //
+  // Place the files, walking the list keeps them in FV order within a type
+  //
+  CopyMem (Next, FvDevice->FileTypeStart, sizeof (Next));
+  for (Link = FvDevice->FfsFileListHeader.ForwardLink; Link != &FvDevice->FfsFileListHeader; Link = Link->ForwardLink) {
+    FfsFileEntry = (FFS_FILE_LIST_ENTRY *) Link;
+    Type = FfsFileEntry->FfsHeader->Type;
+    if (Type <= EFI_FV_FILETYPE_SMM_CORE) {
+      FfsFileEntry->TypeIndex = Next[Type]++;
+      FvDevice->FileTypeIndex[FfsFileEntry->TypeIndex] = FfsFileEntry;
+    }
+  }
+}
+
+
+
 /**
   Check if an FV is consistent and allocate cache for it.
 
@@ -467,6 +570,10 @@ FvCheck (
   //
   Status = EFI_SUCCESS;
   InitializeListHead (&FvDevice->FfsFileListHeader);
+  for (Index = 0; Index < FV_FILE_HASH_SIZE; Index++) {
+    InitializeListHead (&FvDevice->FileHash[Index]);
+  }
+  FvDevice->FileTypeIndex = NULL;
 
   //
   // Build FFS list
@@ -596,7 +703,9 @@ FvCheck (
   }
 
 Done:
-  if (EFI_ERROR (Status)) {
+  if (!EFI_ERROR (Status)) {
+    FvBuildFileIndex (FvDevice);
+  } else {
     if (FileCached) {
       CoreFreePool (CacheFfsHeader);
       FileCached = FALSE;
@@ -19,6 +19,11 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #define FV2_DEVICE_SIGNATURE SIGNATURE_32 ('_', 'F', 'V', '2')
 
+//
+// Number of buckets in the per FV file name hash, must be a power of two.
+//
+#define FV_FILE_HASH_SIZE     64
+
 //
 // Used to track all non-deleted files
 //
@@ -27,6 +32,12 @@ typedef struct {
   EFI_FFS_FILE_HEADER             *FfsHeader;
   UINTN                           StreamHandle;
   BOOLEAN                         FileCached;
+  //
+  // Link on the FileHash bucket of the file name, and position in
+  // FileTypeIndex. Pad files are in neither.
+  //
+  LIST_ENTRY                      HashLink;
+  UINTN                           TypeIndex;
 } FFS_FILE_LIST_ENTRY;
 
 typedef struct {
@@ -47,10 +58,37 @@ typedef struct {
   UINT8                                   ErasePolarity;
   BOOLEAN                                 IsFfs3Fv;
   BOOLEAN                                 IsMemoryMapped;
+
+  //
+  // File index built when the FV is checked. FileHash holds the files by
+  // name. FileTypeIndex holds the files of types up to
+  // EFI_FV_FILETYPE_SMM_CORE sorted by type, in FV order within a type,
+  // the ones of type T being at [FileTypeStart[T], FileTypeStart[T + 1]).
+  // FileTypeIndex is NULL if it could not be allocated.
+  //
+  LIST_ENTRY                              FileHash[FV_FILE_HASH_SIZE];
+  FFS_FILE_LIST_ENTRY                     **FileTypeIndex;
+  UINTN                                   FileTypeStart[EFI_FV_FILETYPE_SMM_CORE + 2];
 } FV_DEVICE;
 
 #define FV_DEVICE_FROM_THIS(a) CR(a, FV_DEVICE, Fv, FV2_DEVICE_SIGNATURE)
 
+/**
+  Returns the FileHash bucket of a file name.
+
+  @param  FvDevice         The FV the file is in.
+  @param  Name             The file name.
+
+  @return The bucket the FFS_FILE_LIST_ENTRY of the file is linked on.
+
+**/
+LIST_ENTRY *
+FvGetFileHashBucket (
+  IN FV_DEVICE             *FvDevice,
+  IN CONST EFI_GUID        *Name
+  );
+
+
 /**
   Retrieves attributes, insures positive polarity of attribute bits, returns
   resulting attributes in output parameter.
@@ -121,6 +121,8 @@ FvGetNextFile (
   UINTN                                       *KeyValue;
   LIST_ENTRY                                  *Link;
   FFS_FILE_LIST_ENTRY                         *FfsFileEntry;
+  BOOLEAN                                     UseIndex;
+  UINTN                                       Index;
 
   FvDevice = FV_DEVICE_FROM_THIS (This);
 
@@ -144,7 +146,37 @@ FvGetNextFile (
   }
 
   KeyValue = (UINTN *)Key;
-  for (;;) {
+
+  //
+  // The files of one type are next to each other in FileTypeIndex. Use it
+  // for a new search by type, or to continue one from a file of that type.
+  //
+  UseIndex = FALSE;
+  FfsFileHeader = NULL;
+  if (*FileType != EFI_FV_FILETYPE_ALL && FvDevice->FileTypeIndex != NULL) {
+    FfsFileEntry = (FFS_FILE_LIST_ENTRY *)(*KeyValue);
+    if (FfsFileEntry == NULL) {
+      UseIndex = TRUE;
+      Index = FvDevice->FileTypeStart[*FileType];
+    } else if (FfsFileEntry->FfsHeader->Type == *FileType) {
+      UseIndex = TRUE;
+      Index = FfsFileEntry->TypeIndex + 1;
+    }
+
+    if (UseIndex) {
+      if (Index >= FvDevice->FileTypeStart[*FileType + 1]) {
+        return EFI_NOT_FOUND;
+      }
+      FfsFileEntry = FvDevice->FileTypeIndex[Index];
+      FfsFileHeader = FfsFileEntry->FfsHeader;
+      *KeyValue = (UINTN)FfsFileEntry;
+    }
+  }
+
+  //
+  // Otherwise walk the file list from the key
+  //
+  while (!UseIndex) {
     if (*KeyValue == 0) {
       //
       // Search for 1st matching file
@@ -273,9 +305,10 @@ FvReadFile (
 {
   EFI_STATUS                        Status;
   FV_DEVICE                         *FvDevice;
-  EFI_GUID                          SearchNameGuid;
-  EFI_FV_FILETYPE                   LocalFoundType;
-  EFI_FV_FILE_ATTRIBUTES            LocalAttributes;
+  EFI_FV_ATTRIBUTES                 FvAttributes;
+  LIST_ENTRY                        *Bucket;
+  LIST_ENTRY                        *Link;
+  FFS_FILE_LIST_ENTRY               *FfsFileEntry;
   UINTN                             FileSize;
   UINT8                             *SrcPtr;
   EFI_FFS_FILE_HEADER               *FfsHeader;
@@ -289,25 +322,27 @@ FvReadFile (
   FvDevice = FV_DEVICE_FROM_THIS (This);
 
 
+  Status = FvGetVolumeAttributes (This, &FvAttributes);
+  if (EFI_ERROR (Status) || (FvAttributes & EFI_FV2_READ_STATUS) == 0) {
+    return EFI_NOT_FOUND;
+  }
+
   //
-  // Keep looking until we find the matching NameGuid.
-  // The Key is really a FfsFileEntry
+  // Look the file up by name. Files are hashed in FV order, so the first
+  // match is the one a GetNextFile () walk would find.
   //
-  FvDevice->LastKey = 0;
-  do {
-    LocalFoundType = 0;
-    Status = FvGetNextFile (
-              This,
-              &FvDevice->LastKey,
-              &LocalFoundType,
-              &SearchNameGuid,
-              &LocalAttributes,
-              &FileSize
-              );
-    if (EFI_ERROR (Status)) {
-      return EFI_NOT_FOUND;
+  FvDevice->LastKey = NULL;
+  Bucket = FvGetFileHashBucket (FvDevice, NameGuid);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    FfsFileEntry = BASE_CR (Link, FFS_FILE_LIST_ENTRY, HashLink);
+    if (CompareGuid (&FfsFileEntry->FfsHeader->Name, NameGuid)) {
+      FvDevice->LastKey = FfsFileEntry;
+      break;
     }
-  } while (!CompareGuid (&SearchNameGuid, NameGuid));
+  }
+  if (FvDevice->LastKey == NULL) {
+    return EFI_NOT_FOUND;
+  }
 
   //
   // Get a pointer to the header
@@ -334,6 +369,12 @@ FvReadFile (
     }
   }
 
+  if (IS_FFS_FILE2 (FfsHeader)) {
+    FileSize = FFS_FILE2_SIZE (FfsHeader) - sizeof (EFI_FFS_FILE_HEADER2);
+  } else {
+    FileSize = FFS_FILE_SIZE (FfsHeader) - sizeof (EFI_FFS_FILE_HEADER);
+  }
+
   //
   // Remember callers buffer size
   //
@@ -16,13 +16,24 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "Handle.h"
 
 
+//
+// Number of buckets in the protocol entry and protocol interface hash tables.
+// Both must be powers of two.
+//
+#define PROTOCOL_ENTRY_HASH_SIZE      128
+#define PROTOCOL_INTERFACE_HASH_SIZE  512
+
 //
 // mProtocolDatabase     - A list of all protocols in the system.  (simple list for now)
+// mProtocolEntryHash    - The protocols in mProtocolDatabase, hashed by GUID
+// mProtocolInterfaceHash - All protocol interfaces, hashed by handle and protocol
 // gHandleList           - A list of all the handles in the system
 // gProtocolDatabaseLock - Lock to protect the mProtocolDatabase
 // gHandleDatabaseKey    -  The Key to show that the handle has been created/modified
 //
 LIST_ENTRY      mProtocolDatabase     = INITIALIZE_LIST_HEAD_VARIABLE (mProtocolDatabase);
+LIST_ENTRY      mProtocolEntryHash[PROTOCOL_ENTRY_HASH_SIZE];
+LIST_ENTRY      mProtocolInterfaceHash[PROTOCOL_INTERFACE_HASH_SIZE];
 LIST_ENTRY      gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
 EFI_LOCK        gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64          gHandleDatabaseKey    = 0;
@@ -85,6 +96,124 @@ CoreValidateHandle (
 
 
 
+/**
+  Returns a hash table bucket, initializing it on first use.
+
+  @param  Bucket                 The bucket
+
+  @return The bucket, as a list head
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetHashBucket (
+  IN LIST_ENTRY *Bucket
+  )
+{
+  if (Bucket->ForwardLink == NULL) {
+    InitializeListHead (Bucket);
+  }
+
+  return Bucket;
+}
+
+
+
+/**
+  Returns the mProtocolEntryHash bucket for a protocol GUID.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The bucket the protocol entry is linked on
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetProtocolEntryBucket (
+  IN EFI_GUID   *Protocol
+  )
+{
+  UINT32              Hash;
+
+  //
+  // GUIDs are close to random, folding their four dwords is enough.
+  // The GUID may come from a packed structure, so read it unaligned.
+  //
+  Hash = ReadUnaligned32 ((UINT32 *)Protocol) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 1) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 2) ^
+         ReadUnaligned32 ((UINT32 *)Protocol + 3);
+  Hash ^= Hash >> 16;
+
+  return CoreGetHashBucket (&mProtocolEntryHash[Hash & (PROTOCOL_ENTRY_HASH_SIZE - 1)]);
+}
+
+
+
+/**
+  Returns the mProtocolInterfaceHash bucket for a protocol on a handle.
+
+  @param  Handle                 The handle
+  @param  ProtEntry              The protocol entry
+
+  @return The bucket the protocol interface is linked on
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetProtocolInterfaceBucket (
+  IN IHANDLE        *Handle,
+  IN PROTOCOL_ENTRY *ProtEntry
+  )
+{
+  UINTN               Hash;
+
+  //
+  // Both are pool allocations, so the low bits carry no information
+  //
+  Hash = ((UINTN)Handle >> 3) * 31 + ((UINTN)ProtEntry >> 3);
+  Hash ^= Hash >> 9;
+
+  return CoreGetHashBucket (&mProtocolInterfaceHash[Hash & (PROTOCOL_INTERFACE_HASH_SIZE - 1)]);
+}
+
+
+
+/**
+  Finds the interface of a protocol on a handle, without walking the
+  protocols of the handle.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to search the protocol on
+  @param  ProtEntry              The protocol entry
+
+  @return Protocol instance (NULL: Not found)
+
+**/
+STATIC
+PROTOCOL_INTERFACE *
+CoreLookupProtocolInterface (
+  IN IHANDLE        *Handle,
+  IN PROTOCOL_ENTRY *ProtEntry
+  )
+{
+  LIST_ENTRY          *Bucket;
+  LIST_ENTRY          *Link;
+  PROTOCOL_INTERFACE  *Prot;
+
+  Bucket = CoreGetProtocolInterfaceBucket (Handle, ProtEntry);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    Prot = CR(Link, PROTOCOL_INTERFACE, HashLink, PROTOCOL_INTERFACE_SIGNATURE);
+    if (Prot->Handle == Handle && Prot->Protocol == ProtEntry) {
+      return Prot;
+    }
+  }
+
+  return NULL;
+}
+
+
+
 /**
   Finds the protocol entry for the requested protocol.
   The gProtocolDatabaseLock must be owned
@@ -101,6 +230,7 @@ CoreFindProtocolEntry (
   IN BOOLEAN    Create
   )
 {
+  LIST_ENTRY          *Bucket;
   LIST_ENTRY          *Link;
   PROTOCOL_ENTRY      *Item;
   PROTOCOL_ENTRY      *ProtEntry;
@@ -108,15 +238,16 @@ CoreFindProtocolEntry (
   ASSERT_LOCKED(&gProtocolDatabaseLock);
 
   //
-  // Search the database for the matching GUID
+  // Search the hash bucket of the GUID for the matching entry
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
+  Bucket = CoreGetProtocolEntryBucket (Protocol);
+  for (Link = Bucket->ForwardLink;
+       Link != Bucket;
        Link = Link->ForwardLink) {
 
-    Item = CR(Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+    Item = CR(Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
 
       //
@@ -148,6 +279,7 @@ CoreFindProtocolEntry (
       // Add it to protocol database
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      InsertTailList (Bucket, &ProtEntry->HashLink);
     }
   }
 
@@ -177,7 +309,6 @@ CoreFindProtocolInterface (
 {
   PROTOCOL_INTERFACE  *Prot;
   PROTOCOL_ENTRY      *ProtEntry;
-  LIST_ENTRY          *Link;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
   Prot = NULL;
@@ -190,18 +321,10 @@ CoreFindProtocolInterface (
   if (ProtEntry != NULL) {
 
     //
-    // Look at each protocol interface for any matches
+    // A handle carries at most one interface per protocol
     //
-    for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link=Link->ForwardLink) {
-
-      //
-      // If this protocol interface matches, remove it
-      //
-      Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-      if (Prot->Interface == Interface && Prot->Protocol == ProtEntry) {
-        break;
-      }
-
+    Prot = CoreLookupProtocolInterface (Handle, ProtEntry);
+    if (Prot != NULL && Prot->Interface != Interface) {
       Prot = NULL;
     }
   }
@@ -459,6 +582,7 @@ CoreInstallProtocolInterfaceNotify (
   // protocol list for this handle
   //
   InsertHeadList (&Handle->Protocols, &Prot->Link);
+  InsertTailList (CoreGetProtocolInterfaceBucket (Handle, ProtEntry), &Prot->HashLink);
 
   //
   // Add this protocol interface to the tail of the
@@ -466,6 +590,11 @@ CoreInstallProtocolInterfaceNotify (
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
 
+  //
+  // Wake up the drivers whose Depex refers to this protocol
+  //
+  CoreNotifyDispatcherOfProtocol (&ProtEntry->ProtocolID);
+
   //
   // Notify the notification list for this protocol
   //
@@ -780,6 +909,7 @@ CoreUninstallProtocolInterface (
     // Remove the protocol interface from the handle
     //
     RemoveEntryList (&Prot->Link);
+    RemoveEntryList (&Prot->HashLink);
 
     //
     // Free the memory
@@ -893,9 +1023,7 @@ CoreGetProtocolInterface (
 {
   EFI_STATUS          Status;
   PROTOCOL_ENTRY      *ProtEntry;
-  PROTOCOL_INTERFACE  *Prot;
   IHANDLE             *Handle;
-  LIST_ENTRY          *Link;
 
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
@@ -905,16 +1033,14 @@ CoreGetProtocolInterface (
   Handle = (IHANDLE *)UserHandle;
 
   //
-  // Look at each protocol interface for a match
+  // A protocol nobody ever installed can't be on the handle
   //
-  for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
-    Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-    ProtEntry = Prot->Protocol;
-    if (CompareGuid (&ProtEntry->ProtocolID, Protocol)) {
-      return Prot;
-    }
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  if (ProtEntry == NULL) {
+    return NULL;
   }
-  return NULL;
+
+  return CoreLookupProtocolInterface (Handle, ProtEntry);
 }
 
 
@@ -45,6 +45,8 @@ typedef struct {
   UINTN               Signature;
   /// Link Entry inserted to mProtocolDatabase
   LIST_ENTRY          AllEntries;  
+  /// Link Entry inserted to the mProtocolEntryHash bucket of ProtocolID
+  LIST_ENTRY          HashLink;
   /// ID of the protocol
   EFI_GUID            ProtocolID;  
   /// All protocol interfaces
@@ -68,6 +70,8 @@ typedef struct {
   IHANDLE                     *Handle;  
   /// Link on PROTOCOL_ENTRY.Protocols
   LIST_ENTRY                  ByProtocol; 
+  /// Link on the mProtocolInterfaceHash bucket of (Handle, Protocol)
+  LIST_ENTRY                  HashLink;
   /// The protocol ID
   PROTOCOL_ENTRY              *Protocol;  
   /// The interface value
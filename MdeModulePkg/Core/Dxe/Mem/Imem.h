@@ -36,7 +36,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 //
 
 #define MEMORY_MAP_SIGNATURE   SIGNATURE_32('m','m','a','p')
-typedef struct {
+typedef struct _MEMORY_MAP MEMORY_MAP;
+struct _MEMORY_MAP {
   UINTN           Signature;
   LIST_ENTRY      Link;
   BOOLEAN         FromPages;
@@ -47,7 +48,18 @@ typedef struct {
 
   UINT64          VirtualStart;
   UINT64          Attribute;
-} MEMORY_MAP;
+
+  //
+  // Node in the address ordered tree of all entries in gMemoryMap. Priority
+  // keeps the tree balanced, MaxFreeBytes is the size of the largest
+  // EfiConventionalMemory entry in the subtree rooted at this node.
+  //
+  MEMORY_MAP      *Parent;
+  MEMORY_MAP      *Left;
+  MEMORY_MAP      *Right;
+  UINT32          Priority;
+  UINT64          MaxFreeBytes;
+};
 
 //
 // Internal prototypes
@@ -124,6 +136,33 @@ CoreFreePoolI (
 
 
 
+/**
+  Get the size of the pool allocator statistics.
+
+  @return Size of a MEMORY_PROFILE_POOL_STATS record with its class records.
+
+**/
+UINTN
+CoreGetPoolStatisticsSize (
+  VOID
+  );
+
+
+
+/**
+  Copy the pool allocator statistics.
+
+  @param  Buffer                 The buffer to hold a MEMORY_PROFILE_POOL_STATS
+                                 record followed by its class records.
+
+**/
+VOID
+CoreCopyPoolStatistics (
+  OUT VOID      *Buffer
+  );
+
+
+
 /**
   Enter critical section by gaining lock on gMemoryLock.
 
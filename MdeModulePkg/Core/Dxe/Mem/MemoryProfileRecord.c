@@ -1198,6 +1198,8 @@ MemoryProfileGetDataSize (
     TotalSize += sizeof (MEMORY_PROFILE_ALLOC_INFO) * (UINTN) DriverInfoData->DriverInfo.AllocRecordCount;
   }
 
+  TotalSize += CoreGetPoolStatisticsSize ();
+
   return TotalSize;
 }
 
@@ -1261,6 +1263,8 @@ MemoryProfileCopyData (
 
     DriverInfo = (MEMORY_PROFILE_DRIVER_INFO *) ((UINTN) (DriverInfo + 1) + sizeof (MEMORY_PROFILE_ALLOC_INFO) * (UINTN) DriverInfo->AllocRecordCount);
   }
+
+  CoreCopyPoolStatistics (DriverInfo);
 }
 
 /**
@@ -51,6 +51,11 @@ UINTN         mFreeMapStack = 0;
 ///
 LIST_ENTRY   mFreeMemoryMapEntryList = INITIALIZE_LIST_HEAD_VARIABLE (mFreeMemoryMapEntryList);
 BOOLEAN      mMemoryTypeInformationInitialized = FALSE;
+///
+/// mMemoryMapTree - root of the treap indexing gMemoryMap by address
+///
+MEMORY_MAP   *mMemoryMapTree = NULL;
+UINT32       mMemoryMapTreeSeed = 1;
 
 EFI_MEMORY_TYPE_STATISTICS mMemoryTypeStatistics[EfiMaxMemoryType + 1] = {
   { 0, MAX_ADDRESS, 0, 0, EfiMaxMemoryType, TRUE,  FALSE },  // EfiReservedMemoryType
@@ -126,6 +131,240 @@ CoreReleaseMemoryLock (
 }
 
 
+/**
+  Internal function.  Recomputes the largest free range below a tree node
+  from the node itself and its children.
+
+  @param  Node                   The node to update
+
+**/
+STATIC
+VOID
+MemoryMapTreeFixup (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  UINT64  MaxFreeBytes;
+
+  MaxFreeBytes = 0;
+  if (Node->Type == EfiConventionalMemory) {
+    MaxFreeBytes = Node->End - Node->Start + 1;
+  }
+  if (Node->Left != NULL && Node->Left->MaxFreeBytes > MaxFreeBytes) {
+    MaxFreeBytes = Node->Left->MaxFreeBytes;
+  }
+  if (Node->Right != NULL && Node->Right->MaxFreeBytes > MaxFreeBytes) {
+    MaxFreeBytes = Node->Right->MaxFreeBytes;
+  }
+  Node->MaxFreeBytes = MaxFreeBytes;
+}
+
+/**
+  Internal function.  Propagates a change of the range of an entry up
+  to the root of the tree.
+
+  @param  Node                   The entry that changed
+
+**/
+STATIC
+VOID
+MemoryMapTreeUpdate (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  for (; Node != NULL; Node = Node->Parent) {
+    MemoryMapTreeFixup (Node);
+  }
+}
+
+/**
+  Internal function.  Rotates a tree node above its parent.
+
+  @param  Node                   The node to move up, must have a parent
+
+**/
+STATIC
+VOID
+MemoryMapTreeRotateUp (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  MEMORY_MAP  *Parent;
+  MEMORY_MAP  *GrandParent;
+
+  Parent      = Node->Parent;
+  GrandParent = Parent->Parent;
+
+  if (Parent->Left == Node) {
+    Parent->Left = Node->Right;
+    if (Parent->Left != NULL) {
+      Parent->Left->Parent = Parent;
+    }
+    Node->Right = Parent;
+  } else {
+    Parent->Right = Node->Left;
+    if (Parent->Right != NULL) {
+      Parent->Right->Parent = Parent;
+    }
+    Node->Left = Parent;
+  }
+  Parent->Parent = Node;
+  Node->Parent   = GrandParent;
+
+  if (GrandParent == NULL) {
+    mMemoryMapTree = Node;
+  } else if (GrandParent->Left == Parent) {
+    GrandParent->Left = Node;
+  } else {
+    GrandParent->Right = Node;
+  }
+
+  MemoryMapTreeFixup (Parent);
+  MemoryMapTreeFixup (Node);
+}
+
+/**
+  Internal function.  Adds an entry to the address ordered tree.
+  The range of the entry must not overlap any entry in the tree.
+
+  @param  Entry                  The entry to add
+
+**/
+STATIC
+VOID
+MemoryMapTreeInsert (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  MEMORY_MAP  **Slot;
+  MEMORY_MAP  *Parent;
+
+  Parent = NULL;
+  Slot   = &mMemoryMapTree;
+  while (*Slot != NULL) {
+    Parent = *Slot;
+    Slot   = (Entry->Start < Parent->Start) ? &Parent->Left : &Parent->Right;
+  }
+
+  //
+  // A cheap LCG is random enough to keep the treap balanced
+  //
+  mMemoryMapTreeSeed = mMemoryMapTreeSeed * 1103515245 + 12345;
+
+  Entry->Parent   = Parent;
+  Entry->Left     = NULL;
+  Entry->Right    = NULL;
+  Entry->Priority = mMemoryMapTreeSeed;
+  *Slot = Entry;
+  MemoryMapTreeUpdate (Entry);
+
+  while (Entry->Parent != NULL && Entry->Parent->Priority < Entry->Priority) {
+    MemoryMapTreeRotateUp (Entry);
+  }
+}
+
+/**
+  Internal function.  Removes an entry from the address ordered tree.
+
+  @param  Entry                  The entry to remove
+
+**/
+STATIC
+VOID
+MemoryMapTreeRemove (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  MEMORY_MAP  *Child;
+
+  //
+  // Sink the entry until it has at most one child
+  //
+  while (Entry->Left != NULL && Entry->Right != NULL) {
+    if (Entry->Left->Priority > Entry->Right->Priority) {
+      MemoryMapTreeRotateUp (Entry->Left);
+    } else {
+      MemoryMapTreeRotateUp (Entry->Right);
+    }
+  }
+
+  Child = (Entry->Left != NULL) ? Entry->Left : Entry->Right;
+  if (Child != NULL) {
+    Child->Parent = Entry->Parent;
+  }
+
+  if (Entry->Parent == NULL) {
+    mMemoryMapTree = Child;
+  } else if (Entry->Parent->Left == Entry) {
+    Entry->Parent->Left = Child;
+  } else {
+    Entry->Parent->Right = Child;
+  }
+  MemoryMapTreeUpdate (Entry->Parent);
+
+  Entry->Parent = NULL;
+  Entry->Left   = NULL;
+  Entry->Right  = NULL;
+}
+
+/**
+  Internal function.  Finds the entry that covers an address.
+
+  @param  Address                The address to look up
+
+  @return The memory map entry, or NULL if the address is not in the map
+
+**/
+STATIC
+MEMORY_MAP *
+MemoryMapTreeFind (
+  IN UINT64              Address
+  )
+{
+  MEMORY_MAP  *Node;
+
+  Node = mMemoryMapTree;
+  while (Node != NULL) {
+    if (Address < Node->Start) {
+      Node = Node->Left;
+    } else if (Address > Node->End) {
+      Node = Node->Right;
+    } else {
+      break;
+    }
+  }
+
+  return Node;
+}
+
+/**
+  Internal function.  Returns the next higher entry in the tree.
+
+  @param  Node                   The entry to start from
+
+  @return The memory map entry, or NULL if Node is the highest one
+
+**/
+STATIC
+MEMORY_MAP *
+MemoryMapTreeNext (
+  IN MEMORY_MAP          *Node
+  )
+{
+  if (Node->Right != NULL) {
+    Node = Node->Right;
+    while (Node->Left != NULL) {
+      Node = Node->Left;
+    }
+    return Node;
+  }
+
+  while (Node->Parent != NULL && Node->Parent->Right == Node) {
+    Node = Node->Parent;
+  }
+
+  return Node->Parent;
+}
 
 
 /**
@@ -139,6 +378,7 @@ RemoveMemoryMapEntry (
   IN OUT MEMORY_MAP      *Entry
   )
 {
+  MemoryMapTreeRemove (Entry);
   RemoveEntryList (&Entry->Link);
   Entry->Link.ForwardLink = NULL;
 
@@ -170,7 +410,6 @@ CoreAddRange (
   IN UINT64                   Attribute
   )
 {
-  LIST_ENTRY        *Link;
   MEMORY_MAP        *Entry;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
@@ -214,32 +453,20 @@ CoreAddRange (
   //
 
   // Two memory descriptors can only be merged if they have the same Type
-  // and the same Attribute
+  // and the same Attribute. The range is not in the map, so an entry
+  // covering the page before or after it is adjoining.
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
-
-      Start = Entry->Start;
-      RemoveMemoryMapEntry (Entry);
-
-    } else if (Entry->Start == End + 1) {
+  Entry = (Start != 0) ? MemoryMapTreeFind (Start - 1) : NULL;
+  if (Entry != NULL && Entry->Type == Type && Entry->Attribute == Attribute) {
+    Start = Entry->Start;
+    RemoveMemoryMapEntry (Entry);
+  }
 
-      End = Entry->End;
-      RemoveMemoryMapEntry (Entry);
-    }
+  Entry = (End + 1 != 0) ? MemoryMapTreeFind (End + 1) : NULL;
+  if (Entry != NULL && Entry->Type == Type && Entry->Attribute == Attribute) {
+    End = Entry->End;
+    RemoveMemoryMapEntry (Entry);
   }
 
   //
@@ -254,6 +481,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart  = 0;
   mMapStack[mMapDepth].Attribute     = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  MemoryMapTreeInsert (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -356,21 +584,23 @@ CoreFreeMemoryMapStack (
       //
       // Move this entry to general memory
       //
+      MemoryMapTreeRemove (&mMapStack[mMapDepth]);
       RemoveEntryList (&mMapStack[mMapDepth].Link);
       mMapStack[mMapDepth].Link.ForwardLink = NULL;
 
       CopyMem (Entry , &mMapStack[mMapDepth], sizeof (MEMORY_MAP));
       Entry->FromPages = TRUE;
+      MemoryMapTreeInsert (Entry);
 
       //
-      // Find insertion location
+      // Find insertion location: entries from pages are kept sorted in
+      // gMemoryMap, so it is before the next higher one in the tree
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && Entry2->Start > Entry->Start) {
-          break;
-        }
+      Entry2 = MemoryMapTreeNext (Entry);
+      while (Entry2 != NULL && !Entry2->FromPages) {
+        Entry2 = MemoryMapTreeNext (Entry2);
       }
+      Link2 = (Entry2 != NULL) ? &Entry2->Link : &gMemoryMap;
 
       InsertTailList (Link2, &Entry->Link);
 
@@ -712,7 +942,6 @@ CoreConvertPagesEx (
   UINT64          RangeEnd;
   UINT64          Attribute;
   EFI_MEMORY_TYPE MemType;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   Entry = NULL;
@@ -738,15 +967,8 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-      if (Entry->Start <= Start && Entry->End > Start) {
-        break;
-      }
-    }
-
-    if (Link == &gMemoryMap) {
+    Entry = MemoryMapTreeFind (Start);
+    if (Entry == NULL) {
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -812,6 +1034,7 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      MemoryMapTreeUpdate (Entry);
 
     } else if (Entry->End == RangeEnd) {
 
@@ -819,6 +1042,7 @@ CoreConvertPagesEx (
       // Clip end
       //
       Entry->End = Start - 1;
+      MemoryMapTreeUpdate (Entry);
 
     } else {
 
@@ -842,9 +1066,11 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      MemoryMapTreeUpdate (Entry);
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
+      MemoryMapTreeInsert (Entry);
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -962,6 +1188,86 @@ CoreUpdateMemoryAttributes (
 }
 
 
+/**
+  Internal function. Finds the highest free entry of a subtree that can hold
+  a range between MinAddress and MaxAddress.
+
+  Entries are visited from the highest address down, skipping subtrees with
+  no free entry large enough, so the first fit is the best one.
+
+  @param  Node                   The root of the subtree
+  @param  MaxAddress             The last address the range may use, page aligned
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Size of the range
+  @param  Alignment              Bits to align with
+
+  @return The last address of the range, or 0 if the range was not found
+
+**/
+STATIC
+UINT64
+CoreFindFreePagesInTree (
+  IN MEMORY_MAP       *Node,
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfBytes,
+  IN UINTN            Alignment
+  )
+{
+  UINT64          Target;
+  UINT64          DescEnd;
+
+  while (Node != NULL && Node->MaxFreeBytes >= NumberOfBytes) {
+    //
+    // If desc is past max allowed address, only lower entries can fit
+    //
+    if (Node->Start >= MaxAddress) {
+      Node = Node->Left;
+      continue;
+    }
+
+    //
+    // If desc is below min allowed address, only higher entries can fit
+    //
+    if (Node->End < MinAddress) {
+      Node = Node->Right;
+      continue;
+    }
+
+    Target = CoreFindFreePagesInTree (Node->Right, MaxAddress, MinAddress, NumberOfBytes, Alignment);
+    if (Target != 0) {
+      return Target;
+    }
+
+    if (Node->Type == EfiConventionalMemory) {
+      //
+      // If desc ends past max allowed address, clip the end
+      //
+      DescEnd = Node->End;
+      if (DescEnd >= MaxAddress) {
+        DescEnd = MaxAddress;
+      }
+
+      DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+      //
+      // Take it if there is enough left after alignment clipping and the
+      // start of the allocated range is not below the min address allowed
+      //
+      if (DescEnd >= Node->Start &&
+          DescEnd - Node->Start + 1 >= NumberOfBytes &&
+          DescEnd - NumberOfBytes + 1 >= MinAddress) {
+        return DescEnd;
+      }
+    }
+
+    Node = Node->Left;
+  }
+
+  return 0;
+}
+
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -987,11 +1293,6 @@ CoreFindFreePagesI (
 {
   UINT64          NumberOfBytes;
   UINT64          Target;
-  UINT64          DescStart;
-  UINT64          DescEnd;
-  UINT64          DescNumberOfBytes;
-  LIST_ENTRY      *Link;
-  MEMORY_MAP      *Entry;
 
   if ((MaxAddress < EFI_PAGE_MASK) ||(NumberOfPages == 0)) {
     return 0;
@@ -1020,64 +1321,12 @@ CoreFindFreePagesI (
   }
 
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
-  Target = 0;
-
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd = Entry->End;
-
-    //
-    // If desc is past max allowed address or below min allowed address, skip it
-    //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
 
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
-
-    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
-
-    // Skip if DescEnd is less than DescStart after alignment clipping
-    if (DescEnd < DescStart) {
-      continue;
-    }
-
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
-
-    if (DescNumberOfBytes >= NumberOfBytes) {
-      //
-      // If the start of the allocated range is below the min address allowed, skip it
-      //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
-        continue;
-      }
-
-      //
-      // If this is the best match so far remember it
-      //
-      if (DescEnd > Target) {
-        Target = DescEnd;
-      }
-    }
-  }
+  //
+  // Entries don't overlap, so the highest entry that fits the range
+  // is the best match
+  //
+  Target = CoreFindFreePagesInTree (mMemoryMapTree, MaxAddress, MinAddress, NumberOfBytes, Alignment);
 
   //
   // If this is a grow down, adjust target to be the allocation base
@@ -1333,7 +1582,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS      Status;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
   UINTN           Alignment;
 
@@ -1345,14 +1593,8 @@ CoreInternalFreePages (
   //
   // Find the entry that the covers the range
   //
-  Entry = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR(Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if (Entry->Start <= Memory && Entry->End > Memory) {
-        break;
-    }
-  }
-  if (Link == &gMemoryMap) {
+  Entry = MemoryMapTreeFind (Memory);
+  if (Entry == NULL) {
     Status = EFI_NOT_FOUND;
     goto Done;
   }
@@ -41,7 +41,12 @@ typedef struct {
   UINTN       Size;
 } POOL_TAIL;
 
-#define POOL_OVERHEAD (SIZE_OF_POOL_HEAD + sizeof(POOL_TAIL))
+//
+// The tail guard is optional, without it a block only carries its head
+//
+#define SIZE_OF_POOL_TAIL (FeaturePcdGet (PcdDxeCorePoolTailGuard) ? sizeof(POOL_TAIL) : 0)
+
+#define POOL_OVERHEAD (SIZE_OF_POOL_HEAD + SIZE_OF_POOL_TAIL)
 
 #define HEAD_TO_TAIL(a)   \
   ((POOL_TAIL *) (((CHAR8 *) (a)) + (a)->Size - sizeof(POOL_TAIL)));
@@ -62,6 +67,51 @@ STATIC CONST UINT16 mPoolSizeTable[] = {
 
 #define MAX_POOL_SIZE     (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// Small blocks are served from slabs: an allocation granule carved into
+// blocks of a single size class, with the POOL_SLAB header at its start.
+// Reserved in the POOL_HEAD of a slab block holds its class plus one, it is
+// zero for blocks coming from the free lists or from pool pages.
+// Runtime and ACPI pools do not use slabs, a slab per class would pin one
+// allocation granule, 64KB on some architectures, of each of those types in
+// the memory map handed to the OS.
+//
+#define POOL_SLAB_FREE_SIGNATURE  SIGNATURE_32('p','f','s','0')
+typedef struct _POOL_SLAB_FREE POOL_SLAB_FREE;
+struct _POOL_SLAB_FREE {
+  UINT32          Signature;
+  UINT32          Class;
+  POOL_SLAB_FREE  *Next;
+};
+
+#define POOL_SLAB_SIGNATURE   SIGNATURE_32('p','s','l','b')
+typedef struct {
+  UINT32          Signature;
+  UINT32          Class;
+  UINTN           Used;
+  POOL_SLAB_FREE  *FreeBlocks;
+  LIST_ENTRY      Link;
+} POOL_SLAB;
+
+#define SIZE_OF_POOL_SLAB ALIGN_VARIABLE (sizeof (POOL_SLAB))
+
+STATIC CONST UINT16 mPoolSlabClassTable[] = {
+  32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
+#define MAX_SLAB_CLASS        (sizeof (mPoolSlabClassTable) / sizeof (mPoolSlabClassTable[0]))
+#define MAX_SLAB_SIZE         512
+#define SLAB_SIZE_GRANULE     16
+
+#define SIZE_TO_SLAB_CLASS(a) (mPoolSlabClassBySize[((a) + SLAB_SIZE_GRANULE - 1) / SLAB_SIZE_GRANULE])
+#define SLAB_CLASS_TO_SIZE(a) (mPoolSlabClassTable [a])
+
+//
+// Number of freed slab blocks kept per type and class before they go back
+// to their slab, so a page is not split and released over and over
+//
+#define POOL_MAGAZINE_SIZE    16
+
 //
 // Globals
 //
@@ -72,6 +122,9 @@ typedef struct {
     UINTN            Used;
     EFI_MEMORY_TYPE  MemoryType;
     LIST_ENTRY       FreeList[MAX_POOL_LIST];
+    LIST_ENTRY       SlabList[MAX_SLAB_CLASS];
+    POOL_SLAB_FREE   *Magazine[MAX_SLAB_CLASS];
+    UINTN            MagazineCount[MAX_SLAB_CLASS];
     LIST_ENTRY       Link;
 } POOL;
 
@@ -85,6 +138,20 @@ POOL            mPoolHead[EfiMaxMemoryType];
 //
 LIST_ENTRY      mPoolHeadList = INITIALIZE_LIST_HEAD_VARIABLE (mPoolHeadList);
 
+//
+// Slab class of each block size, in SLAB_SIZE_GRANULE steps.
+//
+STATIC UINT8    mPoolSlabClassBySize[MAX_SLAB_SIZE / SLAB_SIZE_GRANULE + 1];
+
+//
+// Allocator statistics, exported through the memory profile.
+//
+STATIC MEMORY_PROFILE_POOL_CLASS  mPoolClassStats[MAX_SLAB_CLASS];
+STATIC UINT64                     mPoolPages;
+STATIC UINT64                     mPoolUsedBytes;
+STATIC UINT64                     mPoolAllocationCount;
+STATIC UINT64                     mPoolFreeCount;
+
 /**
   Get pool size table index from the specified size.
 
@@ -120,6 +187,7 @@ CoreInitializePool (
 {
   UINTN  Type;
   UINTN  Index;
+  UINTN  Class;
 
   for (Type=0; Type < EfiMaxMemoryType; Type++) {
     mPoolHead[Type].Signature  = 0;
@@ -128,6 +196,26 @@ CoreInitializePool (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
     }
+    for (Index=0; Index < MAX_SLAB_CLASS; Index++) {
+      InitializeListHead (&mPoolHead[Type].SlabList[Index]);
+      mPoolHead[Type].Magazine[Index]      = NULL;
+      mPoolHead[Type].MagazineCount[Index] = 0;
+    }
+  }
+
+  Class = 0;
+  for (Index=0; Index < sizeof (mPoolSlabClassBySize); Index++) {
+    while (SLAB_CLASS_TO_SIZE (Class) < Index * SLAB_SIZE_GRANULE) {
+      Class++;
+    }
+    mPoolSlabClassBySize[Index] = (UINT8) Class;
+  }
+
+  for (Class=0; Class < MAX_SLAB_CLASS; Class++) {
+    mPoolClassStats[Class].Header.Signature = MEMORY_PROFILE_POOL_CLASS_SIGNATURE;
+    mPoolClassStats[Class].Header.Length    = sizeof (MEMORY_PROFILE_POOL_CLASS);
+    mPoolClassStats[Class].Header.Revision  = MEMORY_PROFILE_POOL_CLASS_REVISION;
+    mPoolClassStats[Class].BlockSize        = SLAB_CLASS_TO_SIZE (Class);
   }
 }
 
@@ -178,6 +266,11 @@ LookupPoolHead (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&Pool->FreeList[Index]);
     }
+    for (Index=0; Index < MAX_SLAB_CLASS; Index++) {
+      InitializeListHead (&Pool->SlabList[Index]);
+      Pool->Magazine[Index]      = NULL;
+      Pool->MagazineCount[Index] = 0;
+    }
 
     InsertHeadList (&mPoolHeadList, &Pool->Link);
 
@@ -188,6 +281,145 @@ LookupPoolHead (
 }
 
 
+/**
+  Take a block of a slab class from the magazine or from a slab of the pool,
+  setting up a new slab when none has free blocks left.
+  Caller must have the memory lock held
+
+  @param  Pool                   Pool head of the memory type to allocate from
+  @param  Class                  Slab class of the block
+  @param  Granularity            Size of a slab
+
+  @return The block, or NULL
+
+**/
+STATIC
+POOL_HEAD *
+CoreAllocateSlabBlock (
+  IN POOL             *Pool,
+  IN UINTN            Class,
+  IN UINTN            Granularity
+  )
+{
+  POOL_SLAB       *Slab;
+  POOL_SLAB_FREE  *Block;
+  UINTN           BlockSize;
+  UINTN           Index;
+
+  Block = Pool->Magazine[Class];
+  if (Block != NULL) {
+    ASSERT (Block->Signature == POOL_SLAB_FREE_SIGNATURE);
+    Pool->Magazine[Class] = Block->Next;
+    Pool->MagazineCount[Class]--;
+    mPoolClassStats[Class].MagazineHits++;
+    return (POOL_HEAD *) Block;
+  }
+
+  if (IsListEmpty (&Pool->SlabList[Class])) {
+    Slab = CoreAllocatePoolPages (Pool->MemoryType, EFI_SIZE_TO_PAGES (Granularity), Granularity);
+    if (Slab == NULL) {
+      return NULL;
+    }
+    mPoolPages += EFI_SIZE_TO_PAGES (Granularity);
+    mPoolClassStats[Class].SlabPages += EFI_SIZE_TO_PAGES (Granularity);
+
+    Slab->Signature  = POOL_SLAB_SIGNATURE;
+    Slab->Class      = (UINT32) Class;
+    Slab->Used       = 0;
+    Slab->FreeBlocks = NULL;
+
+    //
+    // Chain the blocks so that they are handed out in address order
+    //
+    BlockSize = SLAB_CLASS_TO_SIZE (Class);
+    for (Index = (Granularity - SIZE_OF_POOL_SLAB) / BlockSize; Index > 0; Index--) {
+      Block = (POOL_SLAB_FREE *) ((CHAR8 *) Slab + SIZE_OF_POOL_SLAB + (Index - 1) * BlockSize);
+      Block->Signature = POOL_SLAB_FREE_SIGNATURE;
+      Block->Class     = (UINT32) Class;
+      Block->Next      = Slab->FreeBlocks;
+      Slab->FreeBlocks = Block;
+    }
+
+    InsertHeadList (&Pool->SlabList[Class], &Slab->Link);
+  }
+
+  Slab = CR (Pool->SlabList[Class].ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+  Block = Slab->FreeBlocks;
+  ASSERT (Block != NULL && Block->Signature == POOL_SLAB_FREE_SIGNATURE);
+  Slab->FreeBlocks = Block->Next;
+  Slab->Used++;
+
+  //
+  // Only slabs with free blocks are kept on the list
+  //
+  if (Slab->FreeBlocks == NULL) {
+    RemoveEntryList (&Slab->Link);
+  }
+
+  return (POOL_HEAD *) Block;
+}
+
+
+/**
+  Give a slab block back, to the magazine of its class when there is room
+  in it, otherwise to its slab. A slab left without blocks in use is freed.
+  Caller must have the memory lock held
+
+  @param  Pool                   Pool head of the memory type of the block
+  @param  Head                   The block
+  @param  Class                  Slab class of the block
+  @param  Granularity            Size of a slab
+
+**/
+STATIC
+VOID
+CoreFreeSlabBlock (
+  IN POOL             *Pool,
+  IN POOL_HEAD        *Head,
+  IN UINTN            Class,
+  IN UINTN            Granularity
+  )
+{
+  POOL_SLAB       *Slab;
+  POOL_SLAB_FREE  *Block;
+
+  Block = (POOL_SLAB_FREE *) Head;
+  Block->Signature = POOL_SLAB_FREE_SIGNATURE;
+  Block->Class     = (UINT32) Class;
+
+  //
+  // The pool head of an OS memory type goes away along with its last block,
+  // so it cannot hold on to any
+  //
+  if ((INT32)Pool->MemoryType >= 0 && Pool->MagazineCount[Class] < POOL_MAGAZINE_SIZE) {
+    Block->Next = Pool->Magazine[Class];
+    Pool->Magazine[Class] = Block;
+    Pool->MagazineCount[Class]++;
+    return;
+  }
+
+  Slab = (POOL_SLAB *) ((UINTN) Head & ~(Granularity - 1));
+  ASSERT (Slab->Signature == POOL_SLAB_SIGNATURE);
+  ASSERT (Slab->Class == Class);
+  ASSERT (Slab->Used != 0);
+
+  if (Slab->FreeBlocks == NULL) {
+    InsertHeadList (&Pool->SlabList[Class], &Slab->Link);
+  }
+  Block->Next = Slab->FreeBlocks;
+  Slab->FreeBlocks = Block;
+  Slab->Used--;
+
+  if (Slab->Used == 0) {
+    RemoveEntryList (&Slab->Link);
+    Slab->Signature = 0;
+    CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN) Slab, EFI_SIZE_TO_PAGES (Granularity));
+    mPoolPages -= EFI_SIZE_TO_PAGES (Granularity);
+    mPoolClassStats[Class].SlabPages -= EFI_SIZE_TO_PAGES (Granularity);
+  }
+}
+
+
 
 /**
   Allocate pool of a particular type.
@@ -305,6 +537,8 @@ CoreAllocatePoolI (
   UINTN       Offset, MaxOffset;
   UINTN       NoPages;
   UINTN       Granularity;
+  UINTN       Class;
+  BOOLEAN     UseSlabs;
 
   ASSERT_LOCKED (&gMemoryLock);
 
@@ -314,8 +548,10 @@ CoreAllocatePoolI (
        PoolType == EfiRuntimeServicesData) {
 
     Granularity = EFI_ACPI_RUNTIME_PAGE_ALLOCATION_ALIGNMENT;
+    UseSlabs    = FALSE;
   } else {
     Granularity = DEFAULT_PAGE_ALLOCATION;
+    UseSlabs    = TRUE;
   }
 
   //
@@ -336,6 +572,7 @@ CoreAllocatePoolI (
     return NULL;
   }
   Head = NULL;
+  Class = MAX_SLAB_CLASS;
 
   //
   // If allocation is over max size, just allocate pages for the request
@@ -345,6 +582,20 @@ CoreAllocatePoolI (
     NoPages = EFI_SIZE_TO_PAGES(Size) + EFI_SIZE_TO_PAGES (Granularity) - 1;
     NoPages &= ~(UINTN)(EFI_SIZE_TO_PAGES (Granularity) - 1);
     Head = CoreAllocatePoolPages (PoolType, NoPages, Granularity);
+    if (Head != NULL) {
+      mPoolPages += NoPages;
+    }
+    goto Done;
+  }
+
+  //
+  // Small blocks come from the slabs, unless carving a larger block left
+  // a free one of the right size behind
+  //
+  if (UseSlabs && Size <= MAX_SLAB_SIZE && IsListEmpty (&Pool->FreeList[Index])) {
+    Class = SIZE_TO_SLAB_CLASS (Size);
+    Size  = SLAB_CLASS_TO_SIZE (Class);
+    Head  = CoreAllocateSlabBlock (Pool, Class, Granularity);
     goto Done;
   }
 
@@ -376,6 +627,7 @@ CoreAllocatePoolI (
     if (NewPage == NULL) {
       goto Done;
     }
+    mPoolPages += EFI_SIZE_TO_PAGES (Granularity);
 
     //
     // Serve the allocation request from the head of the allocated block
@@ -422,11 +674,14 @@ Done:
     // If we have a pool buffer, fill in the header & tail info
     //
     Head->Signature = POOL_HEAD_SIGNATURE;
+    Head->Reserved  = (Class < MAX_SLAB_CLASS) ? (UINT32) Class + 1 : 0;
     Head->Size      = Size;
     Head->Type      = (EFI_MEMORY_TYPE) PoolType;
-    Tail            = HEAD_TO_TAIL (Head);
-    Tail->Signature = POOL_TAIL_SIGNATURE;
-    Tail->Size      = Size;
+    if (FeaturePcdGet (PcdDxeCorePoolTailGuard)) {
+      Tail            = HEAD_TO_TAIL (Head);
+      Tail->Signature = POOL_TAIL_SIGNATURE;
+      Tail->Size      = Size;
+    }
     Buffer          = Head->Data;
     DEBUG_CLEAR_MEMORY (Buffer, Size - POOL_OVERHEAD);
 
@@ -442,6 +697,12 @@ Done:
     // Account the allocation
     //
     Pool->Used += Size;
+    mPoolUsedBytes += Size;
+    mPoolAllocationCount++;
+    if (Class < MAX_SLAB_CLASS) {
+      mPoolClassStats[Class].AllocationCount++;
+      mPoolClassStats[Class].BlocksInUse++;
+    }
 
   } else {
     DEBUG ((DEBUG_ERROR | DEBUG_POOL, "AllocatePool: failed to allocate %ld bytes\n", (UINT64) Size));
@@ -529,6 +790,7 @@ CoreFreePoolI (
   UINTN       Offset;
   BOOLEAN     AllFree;
   UINTN       Granularity;
+  UINTN       Class;
 
   ASSERT(Buffer != NULL);
   //
@@ -541,22 +803,36 @@ CoreFreePoolI (
     return EFI_INVALID_PARAMETER;
   }
 
-  Tail = HEAD_TO_TAIL (Head);
-  ASSERT(Tail != NULL);
-
-  //
-  // Debug
-  //
-  ASSERT (Tail->Signature == POOL_TAIL_SIGNATURE);
-  ASSERT (Head->Size == Tail->Size);
   ASSERT_LOCKED (&gMemoryLock);
 
-  if (Tail->Signature != POOL_TAIL_SIGNATURE) {
-    return EFI_INVALID_PARAMETER;
+  if (FeaturePcdGet (PcdDxeCorePoolTailGuard)) {
+    Tail = HEAD_TO_TAIL (Head);
+    ASSERT(Tail != NULL);
+
+    //
+    // Debug
+    //
+    ASSERT (Tail->Signature == POOL_TAIL_SIGNATURE);
+    ASSERT (Head->Size == Tail->Size);
+
+    if (Tail->Signature != POOL_TAIL_SIGNATURE) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (Head->Size != Tail->Size) {
+      return EFI_INVALID_PARAMETER;
+    }
   }
 
-  if (Head->Size != Tail->Size) {
-    return EFI_INVALID_PARAMETER;
+  //
+  // A slab block must be exactly the size of its class
+  //
+  Class = MAX_SLAB_CLASS;
+  if (Head->Reserved != 0) {
+    Class = Head->Reserved - 1;
+    if (Class >= MAX_SLAB_CLASS || Head->Size != SLAB_CLASS_TO_SIZE (Class)) {
+      return EFI_INVALID_PARAMETER;
+    }
   }
 
   //
@@ -568,6 +844,8 @@ CoreFreePoolI (
     return EFI_INVALID_PARAMETER;
   }
   Pool->Used -= Size;
+  mPoolUsedBytes -= Size;
+  mPoolFreeCount++;
   DEBUG ((DEBUG_POOL, "FreePool: %p (len %lx) %,ld\n", Head->Data, (UINT64)(Head->Size - POOL_OVERHEAD), (UINT64) Pool->Used));
 
   if  (Head->Type == EfiACPIReclaimMemory   ||
@@ -586,17 +864,22 @@ CoreFreePoolI (
   Index = SIZE_TO_LIST(Size);
   DEBUG_CLEAR_MEMORY (Head, Size);
 
-  //
-  // If it's not on the list, it must be pool pages
-  //
-  if (Index >= SIZE_TO_LIST (Granularity)) {
+  if (Class < MAX_SLAB_CLASS) {
+
+    mPoolClassStats[Class].FreeCount++;
+    mPoolClassStats[Class].BlocksInUse--;
+    CoreFreeSlabBlock (Pool, Head, Class, Granularity);
+
+  } else if (Index >= SIZE_TO_LIST (Granularity)) {
 
     //
+    // If it's not on the list, it must be pool pages
     // Return the memory pages back to free memory
     //
     NoPages = EFI_SIZE_TO_PAGES(Size) + EFI_SIZE_TO_PAGES (Granularity) - 1;
     NoPages &= ~(UINTN)(EFI_SIZE_TO_PAGES (Granularity) - 1);
     CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN) Head, NoPages);
+    mPoolPages -= NoPages;
 
   } else {
 
@@ -653,6 +936,7 @@ CoreFreePoolI (
         // Free the page
         //
         CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN)NewPage, EFI_SIZE_TO_PAGES (Granularity));
+        mPoolPages -= EFI_SIZE_TO_PAGES (Granularity);
       }
     }
   }
@@ -670,3 +954,47 @@ CoreFreePoolI (
   return EFI_SUCCESS;
 }
 
+
+/**
+  Get the size of the pool allocator statistics.
+
+  @return Size of a MEMORY_PROFILE_POOL_STATS record with its class records.
+
+**/
+UINTN
+CoreGetPoolStatisticsSize (
+  VOID
+  )
+{
+  return sizeof (MEMORY_PROFILE_POOL_STATS) + sizeof (mPoolClassStats);
+}
+
+/**
+  Copy the pool allocator statistics.
+
+  @param  Buffer                 The buffer to hold a MEMORY_PROFILE_POOL_STATS
+                                 record followed by its class records.
+
+**/
+VOID
+CoreCopyPoolStatistics (
+  OUT VOID      *Buffer
+  )
+{
+  MEMORY_PROFILE_POOL_STATS  *Stats;
+
+  Stats = Buffer;
+
+  CoreAcquireMemoryLock ();
+  Stats->Header.Signature = MEMORY_PROFILE_POOL_STATS_SIGNATURE;
+  Stats->Header.Length    = sizeof (MEMORY_PROFILE_POOL_STATS);
+  Stats->Header.Revision  = MEMORY_PROFILE_POOL_STATS_REVISION;
+  Stats->PoolPages        = mPoolPages;
+  Stats->UsedBytes        = mPoolUsedBytes;
+  Stats->AllocationCount  = mPoolAllocationCount;
+  Stats->FreeCount        = mPoolFreeCount;
+  Stats->Overhead         = (UINT32) POOL_OVERHEAD;
+  Stats->ClassCount       = MAX_SLAB_CLASS;
+  CopyMem (Stats + 1, mPoolClassStats, sizeof (mPoolClassStats));
+  CoreReleaseMemoryLock ();
+}
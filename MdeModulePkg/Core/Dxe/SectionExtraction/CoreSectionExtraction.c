@@ -27,6 +27,15 @@
   3) A support protocol is not found, and the data is not available to be read
      without it.  This results in EFI_PROTOCOL_ERROR.
 
+  The data produced by decompressing a compression section or by extracting a
+  GUIDed section without authentication is also kept in a cache bounded by
+  PcdDxeCoreSectionCacheSize, so that opening the same section again, in a new
+  stream or another FV holding the same file, copies it instead of
+  decompressing it again. The cache is keyed by the section content, as
+  stream buffers are freed and reused: a hash of the section picks the
+  candidate entries, and a copy of the section kept with each entry is
+  compared in full before its data is used.
+
 Copyright (c) 2006 - 2014, Intel Corporation. All rights reserved.<BR>
 This program and the accompanying materials
 are licensed and made available under the terms and conditions of the BSD License
@@ -98,6 +107,23 @@ typedef struct {
   VOID                        *Registration;
 } RPN_EVENT_CONTEXT;
 
+#define SECTION_CACHE_ENTRY_SIGNATURE SIGNATURE_32('S','X','C','E')
+#define SECTION_CACHE_ENTRY_FROM_LINK(Node) \
+  CR (Node, SECTION_CACHE_ENTRY, Link, SECTION_CACHE_ENTRY_SIGNATURE)
+
+typedef struct {
+  UINT32                      Signature;
+  LIST_ENTRY                  Link;
+  //
+  // Hash, size and copy of the encapsulating section, header included
+  //
+  UINT64                      SectionHash;
+  UINT32                      SectionSize;
+  VOID                        *Section;
+  VOID                        *Data;
+  UINTN                       DataSize;
+} SECTION_CACHE_ENTRY;
+
 
 /**
   The ExtractSection() function processes the input section and
@@ -197,6 +223,15 @@ CustomGuidedSectionExtract (
 //
 LIST_ENTRY mStreamRoot = INITIALIZE_LIST_HEAD_VARIABLE (mStreamRoot);
 
+//
+// Extracted section cache, most recently used entry first. Accessed at
+// TPL_NOTIFY, like the stream database.
+//
+LIST_ENTRY mSectionCache = INITIALIZE_LIST_HEAD_VARIABLE (mSectionCache);
+UINTN      mSectionCacheSize   = 0;
+UINTN      mSectionCacheHits   = 0;
+UINTN      mSectionCacheMisses = 0;
+
 EFI_HANDLE mSectionExtractionHandle = NULL;
 
 EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL mCustomGuidedSectionExtractionProtocol = {
@@ -647,6 +682,209 @@ CreateGuidedExtractionRpnEvent (
                                 );
 }
 
+/**
+  Worker function.  Hashes an encapsulating section for the extracted section
+  cache, 64 bits at a time.
+
+  @param  Section                Indicates the section.
+  @param  SectionSize            Indicates the size of the section, header
+                                 included.
+
+  @return The hash of the section.
+
+**/
+UINT64
+HashSection (
+  IN  VOID                                      *Section,
+  IN  UINT32                                    SectionSize
+  )
+{
+  UINT8                                         *Pointer;
+  UINT8                                         *End;
+  UINT64                                        Hash;
+
+  //
+  // FNV-1a, with words rather than bytes
+  //
+  Hash    = 0xcbf29ce484222325ULL ^ SectionSize;
+  Pointer = (UINT8 *) Section;
+  End     = Pointer + SectionSize;
+  for (; Pointer + sizeof (UINT64) <= End; Pointer += sizeof (UINT64)) {
+    Hash = MultU64x64 (Hash ^ ReadUnaligned64 ((UINT64 *) Pointer), 0x100000001b3ULL);
+  }
+  for (; Pointer < End; Pointer++) {
+    Hash = MultU64x64 (Hash ^ *Pointer, 0x100000001b3ULL);
+  }
+
+  return Hash;
+}
+
+
+/**
+  Worker function.  Looks an encapsulating section up in the extracted section
+  cache and copies its data out on a hit.
+
+  @param  Section                Indicates the section.
+  @param  SectionSize            Indicates the size of the section, header
+                                 included.
+  @param  Buffer                 Indicates the buffer to copy the data to. If
+                                 *Buffer is NULL, a buffer is allocated.
+                                 Otherwise it must be *BufferSize bytes, which
+                                 must match the size of the data.
+  @param  BufferSize             On output, the size of the data.
+  @param  SectionHash            On output, the hash of the section, to pass to
+                                 AddCachedSection () on a miss.
+
+  @retval TRUE                   The data has been copied.
+  @retval FALSE                  The section is not in the cache, or the cache
+                                 is disabled.
+
+**/
+BOOLEAN
+GetCachedSection (
+  IN     VOID                                   *Section,
+  IN     UINT32                                 SectionSize,
+  IN OUT VOID                                   **Buffer,
+  IN OUT UINTN                                  *BufferSize,
+     OUT UINT64                                 *SectionHash
+  )
+{
+  LIST_ENTRY                                    *Link;
+  SECTION_CACHE_ENTRY                           *Entry;
+
+  *SectionHash = 0;
+  if (PcdGet32 (PcdDxeCoreSectionCacheSize) == 0) {
+    return FALSE;
+  }
+
+  *SectionHash = HashSection (Section, SectionSize);
+  for (Link = mSectionCache.ForwardLink; Link != &mSectionCache; Link = Link->ForwardLink) {
+    Entry = SECTION_CACHE_ENTRY_FROM_LINK (Link);
+    if (Entry->SectionHash != *SectionHash || Entry->SectionSize != SectionSize) {
+      continue;
+    }
+
+    //
+    // The hash only narrows the search, two sections may share it
+    //
+    if (CompareMem (Entry->Section, Section, SectionSize) != 0) {
+      continue;
+    }
+
+    if (*Buffer == NULL) {
+      *Buffer = AllocateCopyPool (Entry->DataSize, Entry->Data);
+      if (*Buffer == NULL) {
+        break;
+      }
+    } else if (*BufferSize == Entry->DataSize) {
+      CopyMem (*Buffer, Entry->Data, Entry->DataSize);
+    } else {
+      break;
+    }
+    *BufferSize = Entry->DataSize;
+
+    //
+    // Most recently used first
+    //
+    RemoveEntryList (&Entry->Link);
+    InsertHeadList (&mSectionCache, &Entry->Link);
+    mSectionCacheHits++;
+    return TRUE;
+  }
+
+  mSectionCacheMisses++;
+  return FALSE;
+}
+
+
+/**
+  Worker function.  Adds a copy of the data extracted from an encapsulating
+  section to the extracted section cache, dropping the least recently used
+  entries to make room for it. A copy of the section is kept with the data, and
+  both count against PcdDxeCoreSectionCacheSize.
+
+  @param  SectionHash            Indicates the hash from GetCachedSection ().
+  @param  Section                Indicates the section.
+  @param  SectionSize            Indicates the size of the section, header
+                                 included.
+  @param  Data                   Indicates the extracted data.
+  @param  DataSize               Indicates the size of the extracted data.
+
+**/
+VOID
+AddCachedSection (
+  IN  UINT64                                    SectionHash,
+  IN  VOID                                      *Section,
+  IN  UINT32                                    SectionSize,
+  IN  VOID                                      *Data,
+  IN  UINTN                                     DataSize
+  )
+{
+  SECTION_CACHE_ENTRY                           *Entry;
+  UINTN                                         Budget;
+
+  Budget = PcdGet32 (PcdDxeCoreSectionCacheSize);
+  if (DataSize == 0 || DataSize > Budget || SectionSize > Budget - DataSize) {
+    return;
+  }
+
+  while (mSectionCacheSize + SectionSize + DataSize > Budget) {
+    Entry = SECTION_CACHE_ENTRY_FROM_LINK (GetPreviousNode (&mSectionCache, &mSectionCache));
+    RemoveEntryList (&Entry->Link);
+    mSectionCacheSize -= Entry->SectionSize + Entry->DataSize;
+    CoreFreePool (Entry->Section);
+    CoreFreePool (Entry->Data);
+    CoreFreePool (Entry);
+  }
+
+  Entry = AllocatePool (sizeof (SECTION_CACHE_ENTRY));
+  if (Entry == NULL) {
+    return;
+  }
+  Entry->Section = AllocateCopyPool (SectionSize, Section);
+  if (Entry->Section == NULL) {
+    CoreFreePool (Entry);
+    return;
+  }
+  Entry->Data = AllocateCopyPool (DataSize, Data);
+  if (Entry->Data == NULL) {
+    CoreFreePool (Entry->Section);
+    CoreFreePool (Entry);
+    return;
+  }
+
+  Entry->Signature   = SECTION_CACHE_ENTRY_SIGNATURE;
+  Entry->SectionHash = SectionHash;
+  Entry->SectionSize = SectionSize;
+  Entry->DataSize    = DataSize;
+  InsertHeadList (&mSectionCache, &Entry->Link);
+  mSectionCacheSize += SectionSize + DataSize;
+}
+
+
+/**
+  Reports the hits and misses of the extracted section cache.
+
+**/
+VOID
+CoreReportSectionCacheStatistics (
+  VOID
+  )
+{
+  if (mSectionCacheHits + mSectionCacheMisses == 0) {
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "SectionCache: %Lu hits, %Lu misses, %Lu bytes cached\n",
+    (UINT64) mSectionCacheHits,
+    (UINT64) mSectionCacheMisses,
+    (UINT64) mSectionCacheSize
+    ));
+}
+
+
 /**
   Worker function.  Constructor for new child nodes.
 
@@ -691,6 +929,8 @@ CreateChildNode (
   UINT32                                       UncompressedLength;
   UINT8                                        CompressionType;
   UINT16                                       GuidedSectionAttributes;
+  UINT64                                       SectionHash;
+  BOOLEAN                                      CacheSection;
 
   CORE_SECTION_CHILD_NODE                      *Node;
 
@@ -718,6 +958,7 @@ CreateChildNode (
   Node->OffsetInStream = ChildOffset;
   Node->EncapsulatedStreamHandle = NULL_STREAM_HANDLE;
   Node->EncapsulationGuid = NULL;
+  SectionHash = 0;
 
   //
   // If it's an encapsulating section, then create the new section stream also
@@ -762,6 +1003,11 @@ CreateChildNode (
           // stream is not actually compressed, just encapsulated.  So just copy it.
           //
           CopyMem (NewStreamBuffer, CompressionSource, NewStreamBufferSize);
+        } else if (CompressionType == EFI_STANDARD_COMPRESSION &&
+                   GetCachedSection (SectionHeader, Node->Size, &NewStreamBuffer, &NewStreamBufferSize, &SectionHash)) {
+          //
+          // Decompressed before, copied out of the cache
+          //
         } else if (CompressionType == EFI_STANDARD_COMPRESSION) {
           //
           // Only support the EFI_SATNDARD_COMPRESSION algorithm.
@@ -812,6 +1058,8 @@ CreateChildNode (
             CoreFreePool (NewStreamBuffer);
             return Status;
           }
+
+          AddCachedSection (SectionHash, SectionHeader, Node->Size, NewStreamBuffer, NewStreamBufferSize);
         }
       } else {
         NewStreamBuffer = NULL;
@@ -843,16 +1091,31 @@ CreateChildNode (
       }
       if (VerifyGuidedSectionGuid (Node->EncapsulationGuid, &GuidedExtraction)) {
         //
-        // NewStreamBuffer is always allocated by ExtractSection... No caller
-        // allocation here.
+        // Sections carrying authentication are extracted, and so verified,
+        // every time. The others may come from the cache.
         //
-        Status = GuidedExtraction->ExtractSection (
-                                     GuidedExtraction,
-                                     GuidedHeader,
-                                     &NewStreamBuffer,
-                                     &NewStreamBufferSize,
-                                     &AuthenticationStatus
-                                     );
+        CacheSection = (BOOLEAN) ((GuidedSectionAttributes & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) == 0);
+        NewStreamBuffer = NULL;
+        if (CacheSection &&
+            GetCachedSection (SectionHeader, Node->Size, &NewStreamBuffer, &NewStreamBufferSize, &SectionHash)) {
+          AuthenticationStatus = 0;
+          Status = EFI_SUCCESS;
+        } else {
+          //
+          // NewStreamBuffer is always allocated by ExtractSection... No caller
+          // allocation here.
+          //
+          Status = GuidedExtraction->ExtractSection (
+                                       GuidedExtraction,
+                                       GuidedHeader,
+                                       &NewStreamBuffer,
+                                       &NewStreamBufferSize,
+                                       &AuthenticationStatus
+                                       );
+          if (!EFI_ERROR (Status) && CacheSection) {
+            AddCachedSection (SectionHash, SectionHeader, Node->Size, NewStreamBuffer, NewStreamBufferSize);
+          }
+        }
         if (EFI_ERROR (Status)) {
           CoreFreePool (*ChildNode);
           return EFI_PROTOCOL_ERROR;
@@ -111,6 +111,34 @@ typedef struct {
   //MEMORY_PROFILE_DESCRIPTOR     MemoryDescriptor[MemoryRangeCount];
 } MEMORY_PROFILE_MEMORY_RANGE;
 
+#define MEMORY_PROFILE_POOL_STATS_SIGNATURE SIGNATURE_32 ('M','P','P','S')
+#define MEMORY_PROFILE_POOL_STATS_REVISION 0x0001
+
+typedef struct {
+  MEMORY_PROFILE_COMMON_HEADER  Header;
+  UINT64                        PoolPages;
+  UINT64                        UsedBytes;
+  UINT64                        AllocationCount;
+  UINT64                        FreeCount;
+  UINT32                        Overhead;
+  UINT32                        ClassCount;
+  //MEMORY_PROFILE_POOL_CLASS     PoolClass[ClassCount];
+} MEMORY_PROFILE_POOL_STATS;
+
+#define MEMORY_PROFILE_POOL_CLASS_SIGNATURE SIGNATURE_32 ('M','P','P','C')
+#define MEMORY_PROFILE_POOL_CLASS_REVISION 0x0001
+
+typedef struct {
+  MEMORY_PROFILE_COMMON_HEADER  Header;
+  UINT32                        BlockSize;
+  UINT8                         Reserved[4];
+  UINT64                        AllocationCount;
+  UINT64                        FreeCount;
+  UINT64                        MagazineHits;
+  UINT64                        SlabPages;
+  UINT64                        BlocksInUse;
+} MEMORY_PROFILE_POOL_CLASS;
+
 //
 // UEFI memory profile layout:
 // +--------------------------------+
@@ -128,6 +156,12 @@ typedef struct {
 // +--------------------------------+
 // | ALLOC_INFO(n, mn)              |
 // +--------------------------------+
+// | POOL_STATS                     |
+// +--------------------------------+
+// | POOL_CLASS(1)                  |
+// +--------------------------------+
+// | POOL_CLASS(r)                  |
+// +--------------------------------+
 //
 
 typedef struct _EDKII_MEMORY_PROFILE_PROTOCOL EDKII_MEMORY_PROFILE_PROTOCOL;
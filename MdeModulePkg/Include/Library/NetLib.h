@@ -17,6 +17,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define _NET_LIB_H_
 
 #include <Protocol/Ip6.h>
+#include <Protocol/NetChecksumOffload.h>
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
@@ -205,6 +206,13 @@ typedef struct {
 
 #define IP6_IS_MULTICAST(Ip6)             (((Ip6)->Addr[0]) == 0xFF)
 
+//
+// Test whether an IPv4 datagram was received as fragments, from the
+// fragment field of its header, in network byte order. A reassembled
+// datagram keeps the header of its first fragment, with MF set.
+//
+#define IP4_IS_FRAGMENTED(Fragment)       ((NTOHS (Fragment) & 0x3FFF) != 0)
+
 //
 // Convert the EFI_IP4_ADDRESS to plain UINT32 IP4 address.
 //
@@ -1097,6 +1105,30 @@ NetLibGetVlanId (
   IN EFI_HANDLE             ServiceHandle
   );
 
+/**
+  Get the checksums the network device validates on receive and computes on
+  transmit, from the EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL installed on its SNP
+  handle.
+
+  The TCP and UDP checksums are not reported when the IPsec protocol is
+  installed, as the device can't see the TCP or UDP header in an ESP packet.
+
+  @param[in]   ServiceHandle    The handle where network service binding protocols are
+                                installed on.
+  @param[out]  RxChecksum       The EDKII_NET_CHECKSUM_* bits the device validates on receive,
+                                0 if the checksum offload protocol is not installed.
+  @param[out]  TxChecksum       The EDKII_NET_CHECKSUM_* bits the device computes on transmit,
+                                0 if the checksum offload protocol is not installed.
+
+**/
+VOID
+EFIAPI
+NetLibGetChecksumOffload (
+  IN  EFI_HANDLE            ServiceHandle,
+  OUT UINT32                *RxChecksum,
+  OUT UINT32                *TxChecksum
+  );
+
 /**
   Find VLAN device handle with specified VLAN ID.
 
@@ -2040,6 +2072,31 @@ NetAddChecksum (
   IN UINT16                 Checksum2
   );
 
+/**
+  Update a checksum for new data in place of old data, without going
+  over the rest of the data it covers, as described in RFC 1624.
+
+  OldData and NewData must start at an even offset from the beginning
+  of the data the checksum covers.
+
+  @param[in]   Checksum              The checksum as stored in the header, that is
+                                     the complement of the sum of the data.
+  @param[in]   OldData               The pointer to the data being replaced.
+  @param[in]   NewData               The pointer to the data replacing it.
+  @param[in]   Len                   The length of the old and new data, in bytes.
+
+  @return         The checksum to store in the header.
+
+**/
+UINT16
+EFIAPI
+NetUpdateChecksum (
+  IN UINT16                 Checksum,
+  IN UINT8                  *OldData,
+  IN UINT8                  *NewData,
+  IN UINT32                 Len
+  );
+
 /**
   Compute the checksum for a NET_BUF.
 
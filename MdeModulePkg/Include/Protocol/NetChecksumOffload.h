@@ -0,0 +1,67 @@
+/** @file
+  EDKII Network Checksum Offload protocol.
+
+  A Simple Network Protocol driver whose device validates or computes the
+  IPv4, TCP or UDP checksums installs this protocol on the handle of its
+  EFI_SIMPLE_NETWORK_PROTOCOL, so that the network stack doesn't do it in
+  software again. Without the protocol, the stack checksums everything.
+
+  The checksums of a datagram sent or received as IP fragments are never
+  offloaded, the device can't see the whole of it.
+
+  Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __NET_CHECKSUM_OFFLOAD_H__
+#define __NET_CHECKSUM_OFFLOAD_H__
+
+#define EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL_GUID \
+  { \
+    0x66857c00, 0x54e3, 0x42df, { 0x94, 0x24, 0x19, 0xac, 0x15, 0x83, 0x2a, 0x6c } \
+  }
+
+#define EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL_REVISION  0x00010000
+
+//
+// Checksums, in RxChecksum and TxChecksum.
+//
+#define EDKII_NET_CHECKSUM_IP4_HEADER  BIT0
+#define EDKII_NET_CHECKSUM_TCP4        BIT1
+#define EDKII_NET_CHECKSUM_UDP4        BIT2
+
+typedef struct _EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL  EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL;
+
+///
+/// Network Checksum Offload protocol, the checksums the device handles.
+///
+struct _EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL {
+  UINT64    Revision;
+  ///
+  /// The checksums the device validates on receive. Receive () of the
+  /// EFI_SIMPLE_NETWORK_PROTOCOL never returns a frame with a wrong one,
+  /// the device drops such frames. For TCP and UDP, this only applies to
+  /// the frames that carry a whole datagram, not an IP fragment.
+  ///
+  UINT32    RxChecksum;
+  ///
+  /// The checksums the device computes on transmit. The device fills them
+  /// in every frame passed to Transmit () of the EFI_SIMPLE_NETWORK_PROTOCOL,
+  /// whatever the value of the checksum field, so the stack leaves the field
+  /// zero. For TCP and UDP, this only applies to the frames that carry a
+  /// whole datagram, the stack computes the checksum of the fragmented ones.
+  /// A UDP checksum that computes to zero is sent as 0xffff.
+  ///
+  UINT32    TxChecksum;
+};
+
+extern EFI_GUID gEdkiiNetChecksumOffloadProtocolGuid;
+
+#endif
@@ -22,6 +22,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Protocol/Ip4Config2.h>
 #include <Protocol/ComponentName.h>
 #include <Protocol/ComponentName2.h>
+#include <Protocol/IpSec.h>
 
 #include <Guid/SmBios.h>
 
@@ -2020,6 +2021,58 @@ NetLibGetVlanId (
   return 0;
 }
 
+/**
+  Get the checksums the network device validates on receive and computes on
+  transmit, from the EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL installed on its SNP
+  handle.
+
+  The TCP and UDP checksums are not reported when the IPsec protocol is
+  installed, as the device can't see the TCP or UDP header in an ESP packet.
+
+  @param[in]   ServiceHandle    The handle where network service binding protocols are
+                                installed on.
+  @param[out]  RxChecksum       The EDKII_NET_CHECKSUM_* bits the device validates on receive,
+                                0 if the checksum offload protocol is not installed.
+  @param[out]  TxChecksum       The EDKII_NET_CHECKSUM_* bits the device computes on transmit,
+                                0 if the checksum offload protocol is not installed.
+
+**/
+VOID
+EFIAPI
+NetLibGetChecksumOffload (
+  IN  EFI_HANDLE            ServiceHandle,
+  OUT UINT32                *RxChecksum,
+  OUT UINT32                *TxChecksum
+  )
+{
+  EFI_STATUS                          Status;
+  EFI_HANDLE                          SnpHandle;
+  EDKII_NET_CHECKSUM_OFFLOAD_PROTOCOL *Offload;
+  VOID                                *IpSec;
+
+  *RxChecksum = 0;
+  *TxChecksum = 0;
+
+  SnpHandle = NetLibGetSnpHandle (ServiceHandle, NULL);
+  if (SnpHandle == NULL) {
+    return;
+  }
+
+  Status = gBS->HandleProtocol (SnpHandle, &gEdkiiNetChecksumOffloadProtocolGuid, (VOID **) &Offload);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  *RxChecksum = Offload->RxChecksum;
+  *TxChecksum = Offload->TxChecksum;
+
+  Status = gBS->LocateProtocol (&gEfiIpSec2ProtocolGuid, NULL, &IpSec);
+  if (!EFI_ERROR (Status)) {
+    *RxChecksum &= ~(EDKII_NET_CHECKSUM_TCP4 | EDKII_NET_CHECKSUM_UDP4);
+    *TxChecksum &= ~(EDKII_NET_CHECKSUM_TCP4 | EDKII_NET_CHECKSUM_UDP4);
+  }
+}
+
 /**
   Find VLAN device handle with specified VLAN ID.
 
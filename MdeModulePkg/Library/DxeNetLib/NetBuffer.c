@@ -20,6 +20,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/MemoryAllocationLib.h>
 
+#include "NetChecksum.h"
+
 
 /**
   Allocate and build up the sketch for a NET_BUF.
@@ -1644,6 +1646,10 @@ NetbufQueFlush (
 /**
   Compute the checksum for a bulk of data.
 
+  The words up to an aligned address and the left-over bytes are summed
+  here, the bulk of the data goes through InternalNetChecksumBulk () in
+  chunks of at most NET_CHECKSUM_MAX_CHUNK bytes.
+
   @param[in]   Bulk                  Pointer to the data.
   @param[in]   Len                   Length of the data, in bytes.
 
@@ -1657,10 +1663,39 @@ NetblockChecksum (
   IN UINT32                 Len
   )
 {
-  register UINT32           Sum;
+  UINT64                    Sum;
+  UINT32                    Chunk;
+  UINT16                    Checksum;
+
+  if (Len == 0) {
+    return 0;
+  }
+
+  //
+  // Sum from the next byte to read aligned words. This swaps the
+  // bytes of every word, so swap the checksum back and add the
+  // first byte at its own place.
+  //
+  if (((UINTN) Bulk & 0x01) != 0) {
+    Checksum = SwapBytes16 (NetblockChecksum (Bulk + 1, Len - 1));
+    return NetAddChecksum (Checksum, *Bulk);
+  }
 
   Sum = 0;
 
+  while ((((UINTN) Bulk & (NET_CHECKSUM_ALIGN - 1)) != 0) && (Len > 1)) {
+    Sum += *(UINT16 *) Bulk;
+    Bulk += 2;
+    Len -= 2;
+  }
+
+  while (Len >= NET_CHECKSUM_BLOCK_SIZE) {
+    Chunk = MIN (Len, NET_CHECKSUM_MAX_CHUNK) & ~(NET_CHECKSUM_BLOCK_SIZE - 1);
+    Sum  += InternalNetChecksumBulk (Bulk, Chunk);
+    Bulk += Chunk;
+    Len  -= Chunk;
+  }
+
   while (Len > 1) {
     Sum += *(UINT16 *) Bulk;
     Bulk += 2;
@@ -1675,11 +1710,10 @@ NetblockChecksum (
   }
 
   //
-  // Fold 32-bit sum to 16 bits
+  // Fold 64-bit sum to 16 bits
   //
-  while ((Sum >> 16) != 0) {
-    Sum = (Sum & 0xffff) + (Sum >> 16);
-
+  while (RShiftU64 (Sum, 16) != 0) {
+    Sum = (Sum & 0xffff) + RShiftU64 (Sum, 16);
   }
 
   return (UINT16) Sum;
@@ -1718,6 +1752,44 @@ NetAddChecksum (
 }
 
 
+/**
+  Update a checksum for new data in place of old data, without going
+  over the rest of the data it covers, as described in RFC 1624.
+
+  OldData and NewData must start at an even offset from the beginning
+  of the data the checksum covers.
+
+  @param[in]   Checksum              The checksum as stored in the header, that is
+                                     the complement of the sum of the data.
+  @param[in]   OldData               Pointer to the data being replaced.
+  @param[in]   NewData               Pointer to the data replacing it.
+  @param[in]   Len                   Length of the old and new data, in bytes.
+
+  @return         The checksum to store in the header.
+
+**/
+UINT16
+EFIAPI
+NetUpdateChecksum (
+  IN UINT16                 Checksum,
+  IN UINT8                  *OldData,
+  IN UINT8                  *NewData,
+  IN UINT32                 Len
+  )
+{
+  UINT16                    Sum;
+
+  //
+  // HC' = ~(~HC + ~m + m'), eqn. 3 of RFC 1624, which doesn't
+  // turn a checksum of 0xffff into 0 like eqn. 2 does.
+  //
+  Sum = NetAddChecksum ((UINT16) ~Checksum, (UINT16) ~NetblockChecksum (OldData, Len));
+  Sum = NetAddChecksum (Sum, NetblockChecksum (NewData, Len));
+
+  return (UINT16) ~Sum;
+}
+
+
 /**
   Compute the checksum for a NET_BUF.
 
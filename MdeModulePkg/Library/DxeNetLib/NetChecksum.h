@@ -0,0 +1,49 @@
+/** @file
+  Internal interface of the checksum kernels of the network library.
+
+  NetblockChecksum () sums the unaligned head and the tail of the data
+  itself and hands the bulk of it to InternalNetChecksumBulk (), which
+  has a generic C version and SIMD versions for X64 and AArch64.
+
+Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef _NET_CHECKSUM_H_
+#define _NET_CHECKSUM_H_
+
+//
+// The bulk kernel works on blocks of NET_CHECKSUM_BLOCK_SIZE bytes,
+// starting from an address aligned on NET_CHECKSUM_ALIGN. Its 32-bit
+// lanes can't overflow on NET_CHECKSUM_MAX_CHUNK bytes, it is called
+// once per chunk on larger data.
+//
+#define NET_CHECKSUM_BLOCK_SIZE   64
+#define NET_CHECKSUM_ALIGN        8
+#define NET_CHECKSUM_MAX_CHUNK    0x20000
+
+/**
+  Sum the 16-bit words of a bulk of data, without folding the sum.
+
+  @param[in]   Bulk                  Pointer to the data, aligned on NET_CHECKSUM_ALIGN.
+  @param[in]   Len                   Length of the data, in bytes. A non zero multiple of
+                                     NET_CHECKSUM_BLOCK_SIZE, at most NET_CHECKSUM_MAX_CHUNK.
+
+  @return    The sum of the data, congruent to its one's complement
+             sum modulo 0xffff, and 0 only if all the data is 0.
+
+**/
+UINT64
+EFIAPI
+InternalNetChecksumBulk (
+  IN CONST UINT8            *Bulk,
+  IN UINTN                  Len
+  );
+
+#endif
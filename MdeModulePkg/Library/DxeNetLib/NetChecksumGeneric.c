@@ -0,0 +1,60 @@
+/** @file
+  Generic C version of the checksum kernel of the network library.
+
+Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include "NetChecksum.h"
+
+/**
+  Sum the 16-bit words of a bulk of data, without folding the sum.
+
+  The data is read 32 bits at a time into two 64-bit accumulators. As
+  0x10000 is 1 modulo 0xffff, a 32-bit word adds the same to the one's
+  complement sum as its two 16-bit halves.
+
+  @param[in]   Bulk                  Pointer to the data, aligned on NET_CHECKSUM_ALIGN.
+  @param[in]   Len                   Length of the data, in bytes. A non zero multiple of
+                                     NET_CHECKSUM_BLOCK_SIZE, at most NET_CHECKSUM_MAX_CHUNK.
+
+  @return    The sum of the data, congruent to its one's complement
+             sum modulo 0xffff, and 0 only if all the data is 0.
+
+**/
+UINT64
+EFIAPI
+InternalNetChecksumBulk (
+  IN CONST UINT8            *Bulk,
+  IN UINTN                  Len
+  )
+{
+  CONST UINT32              *Word;
+  UINT64                    Sum0;
+  UINT64                    Sum1;
+  UINTN                     Index;
+
+  Word = (CONST UINT32 *) Bulk;
+  Sum0 = 0;
+  Sum1 = 0;
+
+  while (Len > 0) {
+    for (Index = 0; Index < NET_CHECKSUM_BLOCK_SIZE / sizeof (UINT32); Index += 2) {
+      Sum0 += Word[Index];
+      Sum1 += Word[Index + 1];
+    }
+
+    Word += NET_CHECKSUM_BLOCK_SIZE / sizeof (UINT32);
+    Len  -= NET_CHECKSUM_BLOCK_SIZE;
+  }
+
+  return Sum0 + Sum1;
+}
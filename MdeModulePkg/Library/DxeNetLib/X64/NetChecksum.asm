@@ -0,0 +1,78 @@
+;------------------------------------------------------------------------------
+;
+; Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+; This program and the accompanying materials
+; are licensed and made available under the terms and conditions of the BSD License
+; which accompanies this distribution.  The full text of the license may be found at
+; http://opensource.org/licenses/bsd-license.php.
+;
+; THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+; WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+;
+; Module Name:
+;
+;   NetChecksum.Asm
+;
+; Abstract:
+;
+;   SSE2 version of the checksum kernel of the network library
+;
+;   A 32-bit lane gains 8 words of at most 0xffff per iteration, which
+;   can't overflow on NET_CHECKSUM_MAX_CHUNK bytes. Only the volatile
+;   registers xmm0-xmm5 are used.
+;
+;------------------------------------------------------------------------------
+
+    .code
+
+;------------------------------------------------------------------------------
+; UINT64
+; EFIAPI
+; InternalNetChecksumBulk (
+;   IN CONST UINT8            *Bulk,
+;   IN UINTN                  Len
+;   );
+;------------------------------------------------------------------------------
+InternalNetChecksumBulk PROC
+    pxor    xmm5, xmm5                  ; xmm5 <- 0
+    pxor    xmm4, xmm4                  ; xmm4 <- sum, 4 x 32 bits
+@@:
+    movdqu  xmm0, [rcx]
+    movdqu  xmm2, [rcx + 10h]
+    movdqa  xmm1, xmm0
+    movdqa  xmm3, xmm2
+    punpcklwd xmm0, xmm5                ; zero extend the words to 32 bits
+    punpckhwd xmm1, xmm5
+    punpcklwd xmm2, xmm5
+    punpckhwd xmm3, xmm5
+    paddd   xmm4, xmm0
+    paddd   xmm4, xmm1
+    paddd   xmm4, xmm2
+    paddd   xmm4, xmm3
+    movdqu  xmm0, [rcx + 20h]
+    movdqu  xmm2, [rcx + 30h]
+    movdqa  xmm1, xmm0
+    movdqa  xmm3, xmm2
+    punpcklwd xmm0, xmm5
+    punpckhwd xmm1, xmm5
+    punpcklwd xmm2, xmm5
+    punpckhwd xmm3, xmm5
+    paddd   xmm4, xmm0
+    paddd   xmm4, xmm1
+    paddd   xmm4, xmm2
+    paddd   xmm4, xmm3
+    add     rcx, 40h
+    sub     rdx, 40h
+    jnz     @B
+    movdqa  xmm0, xmm4                  ; zero extend the lanes to 64 bits
+    punpckldq xmm4, xmm5
+    punpckhdq xmm0, xmm5
+    paddq   xmm4, xmm0
+    movq    rax, xmm4
+    psrldq  xmm4, 8
+    movq    rdx, xmm4
+    add     rax, rdx                    ; rax <- sum of the 2 lanes
+    ret
+InternalNetChecksumBulk ENDP
+
+    END
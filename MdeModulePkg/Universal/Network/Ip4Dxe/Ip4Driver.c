@@ -192,6 +192,7 @@ Ip4CreateService (
 {
   IP4_SERVICE               *IpSb;
   EFI_STATUS                Status;
+  UINT32                    TxChecksum;
 
   ASSERT (Service != NULL);
 
@@ -361,6 +362,12 @@ Ip4CreateService (
     IpSb->MaxPacketSize -= NET_VLAN_TAG_LEN;
   }
   IpSb->OldMaxPacketSize = IpSb->MaxPacketSize;
+
+  //
+  // The header checksum is computed along with the header on transmit,
+  // only the receive side is worth offloading.
+  //
+  NetLibGetChecksumOffload (IpSb->Controller, &IpSb->RxChecksum, &TxChecksum);
   *Service = IpSb;
 
   return EFI_SUCCESS;
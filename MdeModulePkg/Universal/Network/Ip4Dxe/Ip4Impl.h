@@ -223,6 +223,7 @@ struct _IP4_SERVICE {
 
   UINT32                          MaxPacketSize;
   UINT32                          OldMaxPacketSize; ///< The MTU before IPsec enable.
+  UINT32                          RxChecksum;       ///< The checksums the device validates.
 };
 
 #define IP4_INSTANCE_FROM_PROTOCOL(Ip4) \
@@ -743,12 +743,15 @@ Ip4PreProcessPacket (
   }
 
   //
-  // Some OS may send IP packets without checksum.
+  // Some OS may send IP packets without checksum. The device may
+  // have validated it already.
   //
-  Checksum = (UINT16) (~NetblockChecksum ((UINT8 *) Head, HeadLen));
+  if ((IpSb->RxChecksum & EDKII_NET_CHECKSUM_IP4_HEADER) == 0) {
+    Checksum = (UINT16) (~NetblockChecksum ((UINT8 *) Head, HeadLen));
 
-  if ((Head->Checksum != 0) && (Checksum != 0)) {
-    return EFI_INVALID_PARAMETER;
+    if ((Head->Checksum != 0) && (Checksum != 0)) {
+      return EFI_INVALID_PARAMETER;
+    }
   }
 
   //
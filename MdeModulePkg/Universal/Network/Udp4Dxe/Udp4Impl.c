@@ -17,6 +17,34 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 UINT16  mUdp4RandomPort;
 
+/**
+  Find out which UDP checksums the device handles. Called once when the
+  service is created, and again whenever IPsec is installed, as the device
+  can't see the UDP header of an ESP packet.
+
+  @param[in]  Event                  The IPsec protocol notification event.
+  @param[in]  Context                Pointer to the UDP4_SERVICE_DATA.
+
+**/
+VOID
+EFIAPI
+Udp4ChecksumOffloadNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  UDP4_SERVICE_DATA   *Udp4Service;
+  UINT32              RxChecksum;
+  UINT32              TxChecksum;
+
+  Udp4Service = (UDP4_SERVICE_DATA *) Context;
+
+  NetLibGetChecksumOffload (Udp4Service->ControllerHandle, &RxChecksum, &TxChecksum);
+  Udp4Service->RxChecksumOffload = (BOOLEAN) ((RxChecksum & EDKII_NET_CHECKSUM_UDP4) != 0);
+  Udp4Service->TxChecksumOffload = (BOOLEAN) ((TxChecksum & EDKII_NET_CHECKSUM_UDP4) != 0);
+}
+
+
 /**
   This function checks and timeouts the I/O datagrams holding by the corresponding
   service context.
@@ -340,6 +368,19 @@ Udp4CreateService (
     goto ON_ERROR;
   }
 
+  //
+  // Find out which checksums the device handles, now and once IPsec is
+  // installed.
+  //
+  Udp4ChecksumOffloadNotify (NULL, Udp4Service);
+  Udp4Service->IpSecNotifyEvent = EfiCreateProtocolNotifyEvent (
+                                    &gEfiIpSec2ProtocolGuid,
+                                    TPL_CALLBACK,
+                                    Udp4ChecksumOffloadNotify,
+                                    Udp4Service,
+                                    &Udp4Service->IpSecRegistration
+                                    );
+
   return EFI_SUCCESS;
 
 ON_ERROR:
@@ -375,6 +416,10 @@ Udp4CleanService (
   //
   gBS->CloseEvent (Udp4Service->TimeoutEvent);
 
+  if (Udp4Service->IpSecNotifyEvent != NULL) {
+    gBS->CloseEvent (Udp4Service->IpSecNotifyEvent);
+  }
+
   //
   // Destroy the IpIo.
   //
@@ -1614,7 +1659,11 @@ Udp4Demultiplex (
   Udp4Header = (EFI_UDP_HEADER *) NetbufGetByte (Packet, 0, NULL);
   ASSERT (Udp4Header != NULL);
 
-  if (Udp4Header->Checksum != 0) {
+  //
+  // The device only validates the checksum of unfragmented datagrams.
+  //
+  if ((Udp4Header->Checksum != 0) &&
+      (!Udp4Service->RxChecksumOffload || IP4_IS_FRAGMENTED (NetSession->IpHdr.Ip4Hdr->Fragmentation))) {
     //
     // check the checksum.
     //
@@ -19,6 +19,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <Protocol/Ip4.h>
 #include <Protocol/Udp4.h>
+#include <Protocol/IpSec.h>
 
 #include <Library/IpIoLib.h>
 #include <Library/DebugLib.h>
@@ -72,6 +73,11 @@ typedef struct _UDP4_SERVICE_DATA_ {
   IP_IO                         *IpIo;
 
   EFI_EVENT                     TimeoutEvent;
+
+  BOOLEAN                       RxChecksumOffload;  ///< The device validates the UDP checksum.
+  BOOLEAN                       TxChecksumOffload;  ///< The device computes the UDP checksum.
+  EFI_EVENT                     IpSecNotifyEvent;   ///< Updates the above when IPsec is installed.
+  VOID                          *IpSecRegistration;
 } UDP4_SERVICE_DATA;
 
 #define UDP4_INSTANCE_DATA_SIGNATURE  SIGNATURE_32('U', 'd', 'p', 'I')
@@ -445,6 +451,22 @@ Udp4CleanService (
   IN UDP4_SERVICE_DATA  *Udp4Service
   );
 
+/**
+  Find out which UDP checksums the device handles. Called once when the
+  service is created, and again whenever IPsec is installed, as the device
+  can't see the UDP header of an ESP packet.
+
+  @param[in]  Event                  The IPsec protocol notification event.
+  @param[in]  Context                Pointer to the UDP4_SERVICE_DATA.
+
+**/
+VOID
+EFIAPI
+Udp4ChecksumOffloadNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
 /**
   This function intializes the new created udp instance.
 
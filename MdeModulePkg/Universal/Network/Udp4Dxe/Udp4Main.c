@@ -516,6 +516,8 @@ Udp4Transmit (
   IP_IO_OVERRIDE          Override;
   UINT16                  HeadSum;
   EFI_IP_ADDRESS          IpDestAddr;
+  EFI_IP4_MODE_DATA       Ip4ModeData;
+  BOOLEAN                 ChecksumOffload;
 
   if ((This == NULL) || (Token == NULL)) {
     return EFI_INVALID_PARAMETER;
@@ -630,14 +632,28 @@ Udp4Transmit (
   }
 
   //
-  // calculate the checksum.
+  // calculate the checksum, unless the device does it for an unfragmented datagram.
+  // The MTU of the IP child changes as IPsec is enabled and disabled.
   //
-  Udp4Header->Checksum = Udp4Checksum (Packet, HeadSum);
-  if (Udp4Header->Checksum == 0) {
-    //
-    // If the calculated checksum is 0, fill the Checksum field with all ones.
-    //
-    Udp4Header->Checksum = 0xffff;
+  ChecksumOffload = FALSE;
+  if (Udp4Service->TxChecksumOffload) {
+    Status = Instance->IpInfo->Ip.Ip4->GetModeData (
+                                         Instance->IpInfo->Ip.Ip4,
+                                         &Ip4ModeData,
+                                         NULL,
+                                         NULL
+                                         );
+    ChecksumOffload = (BOOLEAN) (!EFI_ERROR (Status) && (Packet->TotalSize <= Ip4ModeData.MaxPacketSize));
+  }
+
+  if (!ChecksumOffload) {
+    Udp4Header->Checksum = Udp4Checksum (Packet, HeadSum);
+    if (Udp4Header->Checksum == 0) {
+      //
+      // If the calculated checksum is 0, fill the Checksum field with all ones.
+      //
+      Udp4Header->Checksum = 0xffff;
+    }
   }
 
   //
@@ -78,6 +78,36 @@ typedef struct {
   BOOLEAN         Volatile;
 } VARIABLE_POINTER_TRACK;
 
+///
+/// Number of hash buckets in the index of a variable store.
+///
+#define VARIABLE_INDEX_BUCKETS  256
+
+///
+/// One variable of a store in its index. Entries are linked through Next,
+/// which is the entry number plus one, 0 ending the chain.
+///
+typedef struct {
+  UINT32          Offset;
+  UINT32          Hash;
+  UINT32          Next;
+} VARIABLE_INDEX_ENTRY;
+
+///
+/// Hash index of the variables of a store by name and vendor GUID.
+/// Offsets are relative to the store header, so the index does not need
+/// to be converted after SetVirtualAddressMap. Variables past IndexedEnd
+/// are added the next time the index is used.
+///
+typedef struct {
+  UINT32                Capacity;
+  UINT32                Count;
+  UINTN                 IndexedEnd;
+  BOOLEAN               Overflow;
+  UINT32                Bucket[VARIABLE_INDEX_BUCKETS];
+  VARIABLE_INDEX_ENTRY  Entry[1];
+} VARIABLE_INDEX;
+
 typedef struct {
   EFI_PHYSICAL_ADDRESS  HobVariableBase;
   EFI_PHYSICAL_ADDRESS  VolatileVariableBase;
@@ -106,6 +136,7 @@ typedef struct {
   CHAR8           *PlatformLang;
   CHAR8           Lang[ISO_639_2_ENTRY_SIZE + 1];
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL *FvbInstance;
+  VARIABLE_INDEX  *VariableIndex[VariableStoreTypeMax];
 } VARIABLE_MODULE_GLOBAL;
 
 /**
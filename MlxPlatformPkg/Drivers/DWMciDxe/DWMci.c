@@ -36,6 +36,24 @@ STATIC int cardId = 0;
 #define DWMCI_CLK_400KHZ_DIVIDER (DWMCI_CLK / (400000 * 2))
 #define DWMCI_CLK_24MHZ_DIVIDER  (DWMCI_CLK / (24000000 * 2))
 
+// Time allowed for a DMA transfer to complete, in microseconds, per block.
+#define DWMCI_DMA_BLOCK_TIMEOUT  10000
+
+// Time allowed for the FIFO to make progress on a PIO block, in microseconds.
+#define DWMCI_PIO_BLOCK_TIMEOUT  10000
+#define DWMCI_BLOCK_WORDS        (512 / 4)
+
+BOOLEAN gDWMciUseDma = FALSE;
+
+// IDMAC descriptor chain, in uncached memory.
+STATIC DWMCI_IDMAC_DESC  *mDWMciDesc;
+STATIC PHYSICAL_ADDRESS   mDWMciDescAddr;
+
+// Block data command waiting for its buffer, when the IDMAC is used.
+STATIC BOOLEAN  mDWMciCmdPending;
+STATIC MMC_CMD  mDWMciPendingCmd;
+STATIC UINT32   mDWMciPendingArg;
+
 BOOLEAN
 DWMciIsCardPresent (
   IN EFI_MMC_HOST_PROTOCOL     *This
@@ -266,13 +284,14 @@ DWMciInitializeController (
 
 VOID
 DWMciPrepareDataPath (
+  IN UINTN  Length
   )
 {
   // Set Data Timer
   MmioWrite32 (DW_TMOUT_REG, 0xFFFFFFFF);
 
-  // Set byte count to one block
-  MmioWrite32 (DW_BYTCNT_REG, 512);
+  // Set byte count to the size of the transfer
+  MmioWrite32 (DW_BYTCNT_REG, Length);
 }
 
 VOID
@@ -323,11 +342,12 @@ DwMciUpdateSwitchCmd (
   }
 }
 
+STATIC
 EFI_STATUS
-DWMciSendCommand (
-  IN EFI_MMC_HOST_PROTOCOL     *This,
+DWMciIssueCommand (
   IN MMC_CMD                    MmcCmd,
-  IN UINT32                     Argument
+  IN UINT32                     Argument,
+  IN UINTN                      Length
   )
 {
   UINT32  IntStatus;
@@ -339,16 +359,12 @@ DWMciSendCommand (
 
   CmdIndex = MMC_GET_INDX (MmcCmd) & DW_CMD_INDEX;
 
-  // We do not support multi-block reads or writes.
-  if (CmdIndex == MMC_READ_MULTIPLE_BLOCK ||
-      CmdIndex == MMC_WRITE_MULTIPLE_BLOCK) {
-    return EFI_INVALID_PARAMETER;
-  }
-
   if (CmdIndex == MMC_SEND_EXT_CSD ||
       CmdIndex == MMC_READ_SINGLE_BLOCK ||
-      CmdIndex == MMC_WRITE_BLOCK) {
-    DWMciPrepareDataPath ();
+      CmdIndex == MMC_READ_MULTIPLE_BLOCK ||
+      CmdIndex == MMC_WRITE_BLOCK ||
+      CmdIndex == MMC_WRITE_MULTIPLE_BLOCK) {
+    DWMciPrepareDataPath (Length);
   }
 
   // Create controller command
@@ -376,11 +392,16 @@ DWMciSendCommand (
   switch (CmdIndex) {
   case MMC_SEND_EXT_CSD:
   case MMC_READ_SINGLE_BLOCK:
+  case MMC_READ_MULTIPLE_BLOCK:
     Cmd |= DW_CMD_DATA_EXPECTED;
     break;
   case MMC_WRITE_BLOCK:
+  case MMC_WRITE_MULTIPLE_BLOCK:
     Cmd |= DW_CMD_DATA_EXPECTED | DW_CMD_READ_WRITE;
     break;
+  case MMC_STOP_TRANSMISSION:
+    Cmd |= DW_CMD_STOP_ABORT_CMD;
+    break;
   }
 
   IntStatus = MmioRead32 (DW_RINTSTS_REG);
@@ -438,6 +459,42 @@ DWMciSendCommand (
   return RetVal;
 }
 
+EFI_STATUS
+DWMciSendCommand (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN MMC_CMD                    MmcCmd,
+  IN UINT32                     Argument
+  )
+{
+  UINT32  CmdIndex;
+
+  CmdIndex = MMC_GET_INDX (MmcCmd) & DW_CMD_INDEX;
+
+  // Multi-block reads or writes are only offered along with the IDMAC.
+  if (!gDWMciUseDma &&
+      (CmdIndex == MMC_READ_MULTIPLE_BLOCK ||
+       CmdIndex == MMC_WRITE_MULTIPLE_BLOCK)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  // The IDMAC must be programmed with the buffer before the data command
+  // is sent, and the byte count is only known then, so hold on to block
+  // data commands until ReadBlockData or WriteBlockData provide both.
+  if (gDWMciUseDma &&
+      (CmdIndex == MMC_READ_SINGLE_BLOCK ||
+       CmdIndex == MMC_READ_MULTIPLE_BLOCK ||
+       CmdIndex == MMC_WRITE_BLOCK ||
+       CmdIndex == MMC_WRITE_MULTIPLE_BLOCK)) {
+    mDWMciCmdPending = TRUE;
+    mDWMciPendingCmd = MmcCmd;
+    mDWMciPendingArg = Argument;
+    return EFI_SUCCESS;
+  }
+
+  mDWMciCmdPending = FALSE;
+  return DWMciIssueCommand (MmcCmd, Argument, 512);
+}
+
 EFI_STATUS
 DWMciReceiveResponse (
   IN EFI_MMC_HOST_PROTOCOL     *This,
@@ -465,6 +522,189 @@ DWMciReceiveResponse (
   return EFI_SUCCESS;
 }
 
+STATIC
+EFI_STATUS
+DWMciIdmacInitialize (
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Hcon;
+  UINTN       Bytes;
+  UINTN       Index;
+  UINT64      Next;
+  VOID       *Mapping;
+
+  Hcon = MmioRead32 (DW_HCON_REG);
+  if (DW_HCON_DMA_INTERFACE (Hcon) != DW_HCON_DMA_INTERFACE_IDMAC ||
+      (Hcon & DW_HCON_ADDR_CONFIG_64) == 0) {
+    DEBUG ((EFI_D_INFO, "DWMCI: no 64-bit IDMAC (HCON 0x%x), using PIO\n",
+            Hcon));
+    return EFI_UNSUPPORTED;
+  }
+
+  Bytes = sizeof (DWMCI_IDMAC_DESC) * DWMCI_IDMAC_DESC_COUNT;
+  Status = DmaAllocateBuffer (EfiBootServicesData, EFI_SIZE_TO_PAGES (Bytes),
+                              (VOID **)&mDWMciDesc);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = DmaMap (MapOperationBusMasterCommonBuffer, mDWMciDesc, &Bytes,
+                   &mDWMciDescAddr, &Mapping);
+  if (EFI_ERROR (Status)) {
+    DmaFreeBuffer (EFI_SIZE_TO_PAGES (Bytes), mDWMciDesc);
+    mDWMciDesc = NULL;
+    return Status;
+  }
+
+  // Chain the descriptors into a ring. The chain stays mapped for the
+  // lifetime of the driver.
+  ZeroMem (mDWMciDesc, Bytes);
+  for (Index = 0; Index < DWMCI_IDMAC_DESC_COUNT; Index++) {
+    Next = mDWMciDescAddr +
+      sizeof (DWMCI_IDMAC_DESC) * ((Index + 1) % DWMCI_IDMAC_DESC_COUNT);
+    mDWMciDesc[Index].Des6 = (UINT32)Next;
+    mDWMciDesc[Index].Des7 = (UINT32)(Next >> 32);
+  }
+  mDWMciDesc[DWMCI_IDMAC_DESC_COUNT - 1].Des0 = DW_IDMAC_DES0_ER;
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+DWMciIdmacStop (
+  )
+{
+  MmioWrite32 (DW_BMOD_REG, MmioRead32 (DW_BMOD_REG) & ~DW_BMOD_DE);
+  MmioWrite32 (DW_CTRL_REG, MmioRead32 (DW_CTRL_REG) &
+    ~(DW_CTRL_DMA_ENABLE | DW_CTRL_USE_INTERNAL_DMAC));
+  // Back to single transfers for PIO.
+  MmioWrite32 (DW_FIFOTH_REG, 0x007f0080);
+  MmioWrite32 (DW_IDSTS64_REG, 0xFFFFFFFF);
+}
+
+/**
+  Move the data of the pending block command with the IDMAC.
+
+  The descriptor chain is built over the mapped buffer, the command is
+  issued and completion is polled at the caller's TPL.
+
+  @retval EFI_UNSUPPORTED  The buffer could not be mapped, the command has
+                           not been issued and PIO should be used instead.
+**/
+STATIC
+EFI_STATUS
+DWMciDmaTransfer (
+  IN BOOLEAN                    Read,
+  IN UINTN                      Length,
+  IN VOID                      *Buffer
+  )
+{
+  EFI_STATUS        Status;
+  PHYSICAL_ADDRESS  DeviceAddress;
+  VOID             *Mapping;
+  UINTN             Bytes;
+  UINTN             Count;
+  UINTN             Index;
+  UINTN             Chunk;
+  UINTN             Timer;
+  UINT32            Errors;
+  UINT32            IntStatus;
+  UINT32            IdStatus;
+
+  if (Length == 0 || Length > DWMCI_IDMAC_MAX_TRANSFER) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Bytes = Length;
+  Status = DmaMap (Read ? MapOperationBusMasterWrite : MapOperationBusMasterRead,
+                   Buffer, &Bytes, &DeviceAddress, &Mapping);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+  if (Bytes < Length) {
+    DmaUnmap (Mapping);
+    return EFI_UNSUPPORTED;
+  }
+
+  // Fill one descriptor per DWMCI_IDMAC_DESC_LEN bytes.
+  Count = (Length + DWMCI_IDMAC_DESC_LEN - 1) / DWMCI_IDMAC_DESC_LEN;
+  for (Index = 0; Index < Count; Index++) {
+    Chunk = MIN (Length - Index * DWMCI_IDMAC_DESC_LEN, DWMCI_IDMAC_DESC_LEN);
+    mDWMciDesc[Index].Des2 = Chunk;
+    mDWMciDesc[Index].Des4 = (UINT32)DeviceAddress;
+    mDWMciDesc[Index].Des5 = (UINT32)(DeviceAddress >> 32);
+    mDWMciDesc[Index].Des0 = DW_IDMAC_DES0_OWN | DW_IDMAC_DES0_CH |
+      DW_IDMAC_DES0_DIC |
+      ((Index == 0) ? DW_IDMAC_DES0_FS : 0) |
+      ((Index == Count - 1) ? DW_IDMAC_DES0_LD : 0) |
+      ((Index == DWMCI_IDMAC_DESC_COUNT - 1) ? DW_IDMAC_DES0_ER : 0);
+    DeviceAddress += Chunk;
+  }
+
+  // Make sure the descriptors are in memory before the IDMAC looks.
+  MemoryFence ();
+
+  // Reset the FIFO and the IDMAC, then hand them the chain.
+  DWMciCtrlReset (DW_CTRL_FIFO_RESET | DW_CTRL_DMA_RESET);
+  MmioWrite32 (DW_BMOD_REG, DW_BMOD_SWR);
+  MmioWrite32 (DW_IDSTS64_REG, 0xFFFFFFFF);
+  MmioWrite32 (DW_IDINTEN64_REG, 0);
+  MmioWrite32 (DW_DBADDRL_REG, (UINT32)mDWMciDescAddr);
+  MmioWrite32 (DW_DBADDRU_REG, (UINT32)(mDWMciDescAddr >> 32));
+  MmioWrite32 (DW_FIFOTH_REG, DW_FIFOTH_IDMAC);
+  MmioWrite32 (DW_CTRL_REG, MmioRead32 (DW_CTRL_REG) |
+    DW_CTRL_DMA_ENABLE | DW_CTRL_USE_INTERNAL_DMAC);
+  MmioWrite32 (DW_BMOD_REG, DW_BMOD_FB | DW_BMOD_DE);
+  MemoryFence ();
+  MmioWrite32 (DW_PLDMND_REG, 1);
+
+  IntStatus = MmioRead32 (DW_RINTSTS_REG);
+  MmioWrite32 (DW_RINTSTS_REG, IntStatus & (DW_INT_DTO | DW_INT_READ_ERRORS));
+
+  Errors = Read ? DW_INT_READ_ERRORS : DW_INT_WRITE_ERRORS;
+
+  Status = DWMciIssueCommand (mDWMciPendingCmd, mDWMciPendingArg, Length);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  // Wait for the transfer with interrupts left enabled.
+  Timer = DWMCI_DMA_BLOCK_TIMEOUT * (Length / 512 + 1);
+  do {
+    IntStatus = MmioRead32 (DW_RINTSTS_REG);
+    IdStatus = MmioRead32 (DW_IDSTS64_REG);
+    if ((IntStatus & (DW_INT_DTO | Errors)) != 0 ||
+        (IdStatus & DW_IDSTS_ERRORS) != 0) {
+      break;
+    }
+    MicroSecondDelay (1);
+  } while (--Timer > 0);
+
+  if ((IntStatus & Errors) != 0 || (IdStatus & DW_IDSTS_ERRORS) != 0) {
+    DEBUG ((EFI_D_ERROR, "DWMciDmaTransfer() error: RINTSTS 0x%x IDSTS 0x%x\n",
+            IntStatus, IdStatus));
+    Status = ((IntStatus & Errors) == DW_INT_DRTO) ?
+      EFI_TIMEOUT : EFI_DEVICE_ERROR;
+  } else if ((IntStatus & DW_INT_DTO) == 0) {
+    DEBUG ((EFI_D_ERROR, "DWMciDmaTransfer() timeout: BYTCNT 0x%x TBBCNT 0x%x\n",
+            MmioRead32 (DW_BYTCNT_REG), MmioRead32 (DW_TBBCNT_REG)));
+    Status = EFI_TIMEOUT;
+  }
+
+Exit:
+  MmioWrite32 (DW_RINTSTS_REG, IntStatus & (DW_INT_DTO | Errors));
+  DWMciIdmacStop ();
+  if (EFI_ERROR (Status)) {
+    DWMciCtrlReset (DW_CTRL_FIFO_RESET | DW_CTRL_DMA_RESET);
+  }
+
+  DmaUnmap (Mapping);
+
+  return Status;
+}
+
 EFI_STATUS
 DWMciReadBlockData (
   IN EFI_MMC_HOST_PROTOCOL     *This,
@@ -477,40 +717,83 @@ DWMciReadBlockData (
   UINTN Count;
   UINTN Read;
   UINTN Finish;
+  UINTN BlockEnd;
+  UINTN Timer;
   UINT32 IntStatus;
   EFI_TPL Tpl;
+  EFI_STATUS RetVal;
 
-  if (Length > DWMCI_FIFO_DEPTH * 4) {
+  if (Length % 4 != 0) {
     return EFI_INVALID_PARAMETER;
   }
 
-  if (Length % 4 != 0) {
+  if (mDWMciCmdPending) {
+    mDWMciCmdPending = FALSE;
+    RetVal = DWMciDmaTransfer (TRUE, Length, Buffer);
+    if (RetVal != EFI_UNSUPPORTED) {
+      return RetVal;
+    }
+
+    // Fall back to PIO for this transfer. The FIFO is serviced as the
+    // data streams, so any length will do.
+    RetVal = DWMciIssueCommand (mDWMciPendingCmd, mDWMciPendingArg, Length);
+    if (EFI_ERROR (RetVal)) {
+      return RetVal;
+    }
+  } else if (Length > DWMCI_FIFO_DEPTH * 4) {
     return EFI_INVALID_PARAMETER;
   }
 
-  // Raise the TPL to the highest level to disable interrupts.
-  Tpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
-
-  // Read data from the RX FIFO
+  // Read data from the RX FIFO one block at a time with interrupts
+  // disabled, letting them in between blocks.
   Read = 0;
   Finish = Length / 4;
   IntStatus = 0;
   while (Read < Finish) {
-    Count = DW_STATUS_FIFO_COUNT (MmioRead32 (DW_STATUS_REG));
-
-    for (I = 0; (I < Count) && (Read < Finish); I++) {
-      Buffer[Read++] = MmioRead32 (DW_FIFO_REG);
+    BlockEnd = MIN (Read + DWMCI_BLOCK_WORDS, Finish);
+    Timer = DWMCI_PIO_BLOCK_TIMEOUT;
+
+    // Raise the TPL to the highest level to disable interrupts.
+    Tpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+    while (Read < BlockEnd) {
+      Count = DW_STATUS_FIFO_COUNT (MmioRead32 (DW_STATUS_REG));
+
+      for (I = 0; (I < Count) && (Read < BlockEnd); I++) {
+        Buffer[Read++] = MmioRead32 (DW_FIFO_REG);
+      }
+
+      // Check for errors.
+      IntStatus = MmioRead32 (DW_RINTSTS_REG);
+      if (IntStatus & DW_INT_READ_ERRORS) {
+        break;
+      }
+
+      // Give up on a card which stopped sending data.
+      if (Count == 0) {
+        if (Timer == 0) {
+          break;
+        }
+        MicroSecondDelay (1);
+        Timer--;
+      }
     }
 
-    // Check for errors.
-    IntStatus = MmioRead32 (DW_RINTSTS_REG);
+    // Restore TPL
+    gBS->RestoreTPL (Tpl);
+
     if (IntStatus & DW_INT_READ_ERRORS) {
       break;
     }
-  }
 
-  // Restore TPL
-  gBS->RestoreTPL (Tpl);
+    if (Read < BlockEnd) {
+      DEBUG ((EFI_D_ERROR,
+              "DWMciReadBlockData() timeout: words read 0x%x of 0x%x\n",
+              Read, Finish));
+      DWMciCtrlReset (DW_CTRL_FIFO_RESET);
+      return EFI_TIMEOUT;
+    }
+  }
 
   if (IntStatus & DW_INT_READ_ERRORS) {
     DEBUG ((EFI_D_ERROR, "DWMciReadBlockData() error: "));
@@ -551,44 +834,86 @@ DWMciWriteBlockData (
   UINTN Count;
   UINTN Written;
   UINTN Finish;
+  UINTN BlockEnd;
   UINTN Timer;
   UINT32 IntStatus;
   UINT32 Status;
   UINTN Remaining;
   EFI_TPL Tpl;
+  EFI_STATUS RetVal;
 
-  if (Length > DWMCI_FIFO_DEPTH * 4) {
+  if (Length % 4 != 0) {
     return EFI_INVALID_PARAMETER;
   }
 
-  if (Length % 4 != 0) {
+  if (mDWMciCmdPending) {
+    mDWMciCmdPending = FALSE;
+    RetVal = DWMciDmaTransfer (FALSE, Length, Buffer);
+    if (RetVal != EFI_UNSUPPORTED) {
+      return RetVal;
+    }
+
+    // Fall back to PIO for this transfer. The FIFO is serviced as the
+    // data streams, so any length will do.
+    RetVal = DWMciIssueCommand (mDWMciPendingCmd, mDWMciPendingArg, Length);
+    if (EFI_ERROR (RetVal)) {
+      return RetVal;
+    }
+  } else if (Length > DWMCI_FIFO_DEPTH * 4) {
     return EFI_INVALID_PARAMETER;
   }
 
-  // Raise the TPL at the highest level to disable interrupts.
-  Tpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
-
-  // Write the data to the TX FIFO
+  // Write the data to the TX FIFO one block at a time with interrupts
+  // disabled, letting them in between blocks.
   Written = 0;
   Finish = Length / 4;
   IntStatus = 0;
   while (Written < Finish) {
-    Count = (DWMCI_FIFO_DEPTH -
-             DW_STATUS_FIFO_COUNT (MmioRead32 (DW_STATUS_REG)));
-
-    for (I = 0; (I < Count) && (Written < Finish); I++) {
-      MmioWrite32 (DW_FIFO_REG, Buffer[Written++]);
+    BlockEnd = MIN (Written + DWMCI_BLOCK_WORDS, Finish);
+    Timer = DWMCI_PIO_BLOCK_TIMEOUT;
+
+    // Raise the TPL at the highest level to disable interrupts.
+    Tpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+    while (Written < BlockEnd) {
+      Count = (DWMCI_FIFO_DEPTH -
+               DW_STATUS_FIFO_COUNT (MmioRead32 (DW_STATUS_REG)));
+
+      for (I = 0; (I < Count) && (Written < BlockEnd); I++) {
+        MmioWrite32 (DW_FIFO_REG, Buffer[Written++]);
+      }
+
+      // Check for errors.
+      IntStatus = MmioRead32 (DW_RINTSTS_REG);
+      if (IntStatus & DW_INT_WRITE_ERRORS) {
+        break;
+      }
+
+      // Give up on a card which stopped taking data.
+      if (Count == 0) {
+        if (Timer == 0) {
+          break;
+        }
+        MicroSecondDelay (1);
+        Timer--;
+      }
     }
 
-    // Check for errors.
-    IntStatus = MmioRead32 (DW_RINTSTS_REG);
+    // Restore TPL
+    gBS->RestoreTPL (Tpl);
+
     if (IntStatus & DW_INT_WRITE_ERRORS) {
       break;
     }
-  }
 
-  // Restore TPL
-  gBS->RestoreTPL (Tpl);
+    if (Written < BlockEnd) {
+      DEBUG ((EFI_D_ERROR,
+              "DWMciWriteBlockData() timeout: words written 0x%x of 0x%x\n",
+              Written, Finish));
+      DWMciCtrlReset (DW_CTRL_FIFO_RESET);
+      return EFI_TIMEOUT;
+    }
+  }
 
   if (IntStatus & DW_INT_WRITE_ERRORS) {
     DEBUG ((EFI_D_ERROR, "DWMciWriteBlockData() error: "));
@@ -681,6 +1006,16 @@ DWMciBuildDevicePath (
   return EFI_SUCCESS;
 }
 
+UINTN
+DWMciGetMaxBlockCount (
+  IN EFI_MMC_HOST_PROTOCOL     *This
+  )
+{
+  // Multi-block transfers are left to the IDMAC, PIO moves one block at a
+  // time with interrupts disabled.
+  return gDWMciUseDma ? DWMCI_IDMAC_MAX_TRANSFER / 512 : 1;
+}
+
 EFI_MMC_HOST_PROTOCOL gDWMciHost = {
   MMC_HOST_PROTOCOL_REVISION,
   DWMciIsCardPresent,
@@ -690,7 +1025,8 @@ EFI_MMC_HOST_PROTOCOL gDWMciHost = {
   DWMciSendCommand,
   DWMciReceiveResponse,
   DWMciReadBlockData,
-  DWMciWriteBlockData
+  DWMciWriteBlockData,
+  DWMciGetMaxBlockCount
 };
 
 EFI_STATUS
@@ -701,6 +1037,7 @@ DWMciDxeInitialize (
 {
   EFI_STATUS    Status;
   EFI_HANDLE    Handle;
+  EFI_EVENT     Event;
 
   Handle = NULL;
 
@@ -708,6 +1045,15 @@ DWMciDxeInitialize (
   // size.
   ASSERT (DWMCI_FIFO_DEPTH >= 128);
 
+  // Move block data with the IDMAC when possible, PIO otherwise.
+  gDWMciUseDma = !EFI_ERROR (DWMciIdmacInitialize ());
+
+  if (FeaturePcdGet (PcdDWMciDiagnostics)) {
+    Status = EfiCreateEventReadyToBootEx (TPL_CALLBACK, DWMciDiagnostics,
+                                          NULL, &Event);
+    ASSERT_EFI_ERROR (Status);
+  }
+
   // Publish Component Name, BlockIO protocol interfaces
   Status = gBS->InstallMultipleProtocolInterfaces (
                   &Handle,
@@ -26,6 +26,7 @@
 #include <Library/IoLib.h>
 #include <Library/TimerLib.h>
 #include <Library/PcdLib.h>
+#include <Library/DmaLib.h>
 
 #define DWMCI_DXE_VERSION 0x01
 
@@ -191,6 +192,80 @@
 #define DW_STATUS_DATA_STATE_MC_BUSY BIT10
 #define DW_STATUS_FIFO_COUNT(s) (((s) >> 17) & 0x1fff)
 
+#define DW_HCON_DMA_INTERFACE(h)     (((h) >> 16) & 0x3)
+#define DW_HCON_DMA_INTERFACE_IDMAC  0
+#define DW_HCON_ADDR_CONFIG_64       BIT27
+
+#define DW_BMOD_SWR                  BIT0  // Software reset
+#define DW_BMOD_FB                   BIT1  // Fixed burst
+#define DW_BMOD_DE                   BIT7  // IDMAC enable
+
+#define DW_IDSTS_TI                  BIT0  // Transmit interrupt
+#define DW_IDSTS_RI                  BIT1  // Receive interrupt
+#define DW_IDSTS_FBE                 BIT2  // Fatal bus error
+#define DW_IDSTS_DU                  BIT4  // Descriptor unavailable
+#define DW_IDSTS_CES                 BIT5  // Card error summary
+#define DW_IDSTS_NIS                 BIT8  // Normal interrupt summary
+#define DW_IDSTS_AIS                 BIT9  // Abnormal interrupt summary
+
+#define DW_IDSTS_ERRORS \
+  (DW_IDSTS_FBE | DW_IDSTS_DU | DW_IDSTS_CES | DW_IDSTS_AIS)
+
+// FIFOTH with a burst of 8 transfers for the IDMAC. Both watermarks of
+// 0x007f0080 stay multiples of the burst size.
+#define DW_FIFOTH_IDMAC              0x207f0080
+
+//
+// IDMAC descriptor, 64-bit address configuration.
+//
+typedef struct {
+  UINT32  Des0;          // Control and status
+  UINT32  Des1;          // Reserved
+  UINT32  Des2;          // Buffer 1 size (12:0)
+  UINT32  Des3;          // Reserved
+  UINT32  Des4;          // Buffer 1 address, low
+  UINT32  Des5;          // Buffer 1 address, high
+  UINT32  Des6;          // Next descriptor address, low
+  UINT32  Des7;          // Next descriptor address, high
+} DWMCI_IDMAC_DESC;
+
+#define DW_IDMAC_DES0_DIC            BIT1  // Disable completion interrupt
+#define DW_IDMAC_DES0_LD             BIT2  // Last descriptor
+#define DW_IDMAC_DES0_FS             BIT3  // First descriptor
+#define DW_IDMAC_DES0_CH             BIT4  // Second address chained
+#define DW_IDMAC_DES0_ER             BIT5  // End of ring
+#define DW_IDMAC_DES0_CES            BIT30 // Card error summary
+#define DW_IDMAC_DES0_OWN            BIT31 // Owned by the IDMAC
+
+// Bytes covered by one descriptor, and the number of descriptors in the
+// chain. This bounds a single DMA transfer to 1MB.
+#define DWMCI_IDMAC_DESC_LEN         SIZE_4KB
+#define DWMCI_IDMAC_DESC_COUNT       256
+#define DWMCI_IDMAC_MAX_TRANSFER     (DWMCI_IDMAC_DESC_LEN * DWMCI_IDMAC_DESC_COUNT)
+
+// TRUE once the IDMAC descriptor chain is set up. Block data commands are
+// then moved by the IDMAC, and the FIFO is only used by PIO as a fallback.
+extern BOOLEAN gDWMciUseDma;
+
+extern EFI_MMC_HOST_PROTOCOL gDWMciHost;
+
+/**
+  Measure and compare the PIO and IDMAC read throughput.
+
+  Runs at ReadyToBoot when PcdDWMciDiagnostics is TRUE. The card is read
+  through the BlockIo MmcDxe produced for it, so MmcDxe keeps owning the
+  card state.
+
+  @param  Event    The ReadyToBoot event.
+  @param  Context  Unused.
+**/
+VOID
+EFIAPI
+DWMciDiagnostics (
+  IN EFI_EVENT  Event,
+  IN VOID      *Context
+  );
+
 #define DWMCI_TRACE(txt)                DEBUG ((EFI_D_BLKIO, "DWMCI: " txt "\n"))
 
 #endif /* __DWMCI_H__ */
@@ -0,0 +1,191 @@
+/** @file
+  Read throughput diagnostics for the Designware MMC controller.
+
+  Copyright (c) 2016, Mellanox Technologies. All rights reserved.
+
+  This program and the accompanying materials are licensed and made
+  available under the terms and conditions of the BSD License which
+  accompanies this distribution.  The full text of the license may be
+  found at http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS"
+  BASIS, WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER
+  EXPRESS OR IMPLIED.
+
+**/
+
+#include "DWMci.h"
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Protocol/BlockIo.h>
+
+/**
+  Find the BlockIo MmcDxe produced for the card behind this controller.
+
+  @param  BlockIo  The BlockIo of the card.
+**/
+STATIC
+EFI_STATUS
+DWMciLocateBlockIo (
+  OUT EFI_BLOCK_IO_PROTOCOL   **BlockIo
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *Node;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_DEVICE_PATH_PROTOCOL  *Remaining;
+  EFI_HANDLE                Handle;
+
+  Status = gDWMciHost.BuildDevicePath (&gDWMciHost, &Node);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  DevicePath = AppendDevicePathNode (NULL, Node);
+  FreePool (Node);
+  if (DevicePath == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  // The card itself, not one of its partitions
+  Remaining = DevicePath;
+  Status = gBS->LocateDevicePath (&gEfiBlockIoProtocolGuid, &Remaining, &Handle);
+  if (!EFI_ERROR (Status) && !IsDevicePathEnd (Remaining)) {
+    Status = EFI_NOT_FOUND;
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->HandleProtocol (Handle, &gEfiBlockIoProtocolGuid,
+                                  (VOID **)BlockIo);
+  }
+
+  FreePool (DevicePath);
+  return Status;
+}
+
+/**
+  Read block 0 of the card Blocks times, one block at a time.
+
+  @param  BlockIo  The BlockIo of the card.
+  @param  UseDma   Move the data with the IDMAC rather than PIO.
+  @param  Blocks   Number of blocks to read.
+  @param  Buffer   A buffer to read the block into.
+  @param  KBps     Resulting throughput in KB/s.
+**/
+STATIC
+EFI_STATUS
+DWMciMeasureRead (
+  IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN  BOOLEAN                UseDma,
+  IN  UINT32                 Blocks,
+  OUT VOID                   *Buffer,
+  OUT UINT64                 *KBps
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+  BOOLEAN     SavedUseDma;
+  UINT32      BlockSize;
+  UINT32      Index;
+  UINT64      Start;
+  UINT64      ElapsedNs;
+
+  BlockSize = BlockIo->Media->BlockSize;
+
+  // MmcDxe serves the queued BlockIo2 requests from a TPL_CALLBACK timer,
+  // keep it from running one while the transfer mode is switched.
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  SavedUseDma = gDWMciUseDma;
+  gDWMciUseDma = UseDma;
+
+  Status = EFI_SUCCESS;
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < Blocks; Index++) {
+    Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, 0,
+                                  BlockSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  ElapsedNs = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+
+  gDWMciUseDma = SavedUseDma;
+  gBS->RestoreTPL (OldTpl);
+
+  *KBps = 0;
+  if (ElapsedNs != 0) {
+    *KBps = DivU64x64Remainder (MultU64x32 ((UINT64)Index * BlockSize, 1000000),
+                                ElapsedNs, NULL);
+  }
+
+  return Status;
+}
+
+VOID
+EFIAPI
+DWMciDiagnostics (
+  IN EFI_EVENT  Event,
+  IN VOID      *Context
+  )
+{
+  EFI_STATUS             Status;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  UINT32                 Blocks;
+  UINTN                  Pages;
+  VOID                   *PioBuffer;
+  VOID                   *DmaBuffer;
+  UINT64                 PioKBps;
+  UINT64                 DmaKBps;
+
+  gBS->CloseEvent (Event);
+
+  Status = DWMciLocateBlockIo (&BlockIo);
+  if (EFI_ERROR (Status) || !BlockIo->Media->MediaPresent) {
+    DEBUG ((EFI_D_INFO, "DWMCI: no card to measure\n"));
+    return;
+  }
+
+  Blocks = FixedPcdGet32 (PcdDWMciDiagnosticBlocks);
+  Pages = EFI_SIZE_TO_PAGES (BlockIo->Media->BlockSize);
+
+  PioBuffer = AllocatePages (Pages);
+  DmaBuffer = AllocatePages (Pages);
+  if (PioBuffer == NULL || DmaBuffer == NULL) {
+    goto Exit;
+  }
+
+  Status = DWMciMeasureRead (BlockIo, FALSE, Blocks, PioBuffer, &PioKBps);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "DWMCI: PIO read failed: %r\n", Status));
+    goto Exit;
+  }
+
+  if (!gDWMciUseDma) {
+    DEBUG ((EFI_D_INFO, "DWMCI: %d blocks, PIO %Ld KB/s, no IDMAC\n",
+            Blocks, PioKBps));
+    goto Exit;
+  }
+
+  Status = DWMciMeasureRead (BlockIo, TRUE, Blocks, DmaBuffer, &DmaKBps);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "DWMCI: DMA read failed: %r\n", Status));
+    goto Exit;
+  }
+
+  DEBUG ((EFI_D_INFO, "DWMCI: %d blocks, PIO %Ld KB/s, DMA %Ld KB/s\n",
+          Blocks, PioKBps, DmaKBps));
+
+  if (CompareMem (PioBuffer, DmaBuffer, BlockIo->Media->BlockSize) != 0) {
+    DEBUG ((EFI_D_ERROR, "DWMCI: PIO and DMA data differ\n"));
+  }
+
+Exit:
+  if (PioBuffer != NULL) {
+    FreePages (PioBuffer, Pages);
+  }
+  if (DmaBuffer != NULL) {
+    FreePages (DmaBuffer, Pages);
+  }
+}
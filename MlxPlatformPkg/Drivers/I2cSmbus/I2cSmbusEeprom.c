@@ -42,8 +42,9 @@ STATIC I2C_SMBUS_REQUEST_PACKET mRequestPacket;
 // reading data bytes.
 // Note that this transfer uses the I2C_REQUEST_PACKET that encapsulates the
 // transaction information which allow the bus controller to perform SMBus
-// cycles. Also note that EEPROM transaction defines MAX_PAGE_SIZE bytes per
-// operation -i.e the allowed number per block transfer.
+// cycles. Also note that EEPROM write transactions are limited to a page;
+// the SMBus Host Protocol splits longer writes at page boundaries and
+// streams the pages to the device.
 EFI_STATUS
 EFIAPI
 I2cSmbusEepromTransfer (
@@ -57,7 +58,6 @@ I2cSmbusEepromTransfer (
   EFI_SMBUS_DEVICE_ADDRESS  DeviceAddress;
   EFI_SMBUS_OPERATION       SmbusOperation;
   UINTN                     BufferLength;
-  UINT16                    PageSize, PageOffset;
   BOOLEAN                   PecEnable;
   UINT32                    Transmitted    = 0;
   UINT32                    CurrentAddress = Address;
@@ -67,7 +67,6 @@ I2cSmbusEepromTransfer (
   // Set Smbus slave address.
   DeviceAddress.SmbusDeviceAddress = (UINT8) gEepromContext.Chip;
 
-  PageSize  = gEepromContext.PageSize;
   PecEnable = gEepromContext.PecEnable;
 
   mRequestPacket.OperationCount = 1;
@@ -100,30 +99,13 @@ I2cSmbusEepromTransfer (
     CurrentAddress  = (Address + Transmitted) % gEepromContext.Size;
     // Set transaction data buffer length.
     //
-    // Note that the EEPROM device used to store system variables supports
-    // a "page write" mode. In "page write" mode, the data byte address lower
-    // bits (corresponding to the page mask (= PageSize - 1)) are internally
-    // incremented following the receipt of each data byte. The higher data
-    // byte address bits are not incremented, retaining the memory page row
-    // location. When the byte address, internally generated, reaches the page
-    // boundary, the following byte is placed at the beginning of the same page,
-    // i.e. the address roll over is from the last byte of the current page to
-    // the first byte of the same page. If more than PAGE_SIZE data bytes are
-    // transmitted to the EEPROM, the data word address will "roll over" and
-    // previous data will be overwritten. In order to recreate a sequential
-    // write, we have to trancate writes at page boundaries.
-    if (Operation != EEPROM_READ) {
-        PageOffset   = CurrentAddress & (PageSize - 1);
-        BufferLength = ((PageOffset + Length) <= PageSize) ? \
-                    Length : (PageSize - PageOffset);
-    } else {
-        // Note that read transactions are not limited by a "page" mode, but
-        // offer full sequential semantics. As a result, we don't have to
-        // truncate reads at page boundaries. Note that when the memory address
-        // limit is reached, the data byte address will roll over and the
-        // sequential read will continue.
-        BufferLength = Length;
-    }
+    // Note that read transactions are not limited by a "page" mode, but
+    // offer full sequential semantics. Note that when the memory address
+    // limit is reached, the data byte address will roll over and the
+    // sequential read will continue. Writes are truncated at page boundaries
+    // by the SMBus Host Protocol, which streams the whole buffer without
+    // returning in between.
+    BufferLength = Length;
 
     mRequestPacket.Operation[OpIdx].Buffer         = Buffer + Transmitted;
     mRequestPacket.Operation[OpIdx].LengthInBytes  = BufferLength;
@@ -745,6 +745,77 @@ I2cSmbusReturnTransactionStatus (
   return EFI_NO_RESPONSE;
 }
 
+// Wait for the end of the write cycle of a slave device, if a previous
+// write transaction to it started one. EEPROM devices do not acknowledge
+// their address while they copy the received data to memory, so address
+// the device, with no data, until it responds. This costs a few bus cycles
+// per poll instead of a fixed SMBUS_WRITE_TRANS_TIMEOUT delay per write.
+STATIC
+EFI_STATUS
+I2cSmbusWaitForWriteCycle (
+  IN SMBUS_INFO *SmbusInfo,
+  IN UINT8      SlaveAddress
+  )
+{
+  UINT32     ControlWord;
+  UINTN      Timeout;
+  EFI_STATUS Status;
+
+  if (SmbusInfo->WriteCycleSlave != SlaveAddress)
+    return EFI_SUCCESS;
+
+  // Set Master GW control word. The data descriptor holds the slave address
+  // byte only.
+  ControlWord  = 0;
+  ControlWord |= 0x1               << MASTER_LOCK_BIT_OFF;
+  ControlWord |= 0x1               << MASTER_BUSY_BIT_OFF;
+  ControlWord |= SlaveAddress      << MASTER_SLV_ADDR_BIT_OFF;
+  ControlWord |= 0x1               << MASTER_START_BIT_OFF;
+  ControlWord |= 0x1               << MASTER_STOP_BIT_OFF;
+  ControlWord |= 0                 << MASTER_READ_BIT_OFF;
+  ControlWord |= 0                 << MASTER_CTL_READ_BIT_OFF;
+  ControlWord |= 0                 << MASTER_WRITE_BIT_OFF;
+  ControlWord |= 0x1               << MASTER_CTL_WRITE_BIT_OFF;
+  ControlWord |= 0                 << MASTER_PARSE_EXP_BIT_OFF;
+  ControlWord |= 0                 << MASTER_SEND_PEC_BIT_OFF;
+
+  Timeout = (SMBUS_WRITE_TRANS_TIMEOUT / SMBUS_ACK_POLL_PERIOD) + 1;
+
+  do {
+    if (!I2cSmbusMasterIsIdle (SmbusInfo))
+      return EFI_TIMEOUT;
+
+    // Write Slave address to the data descriptor. Slave address is shifted
+    // left by 1 as required by hardware.
+    TYU_WRITE_DATA (SmbusInfo->Io.Smbus + MASTER_DATA_DESC_ADDR,
+                    (SlaveAddress & 0x7f) << 1);
+
+    // Clear status bits.
+    TYU_WRITE (SmbusInfo->Io.Smbus       + SMBUS_MASTER_STATUS,      0x0);
+    // Set the cause data.
+    TYU_WRITE (SmbusInfo->Io.CauseMaster + TYU_CAUSE_OR_CLEAR_BITS, ~0x0);
+    // Zero PEC byte.
+    TYU_WRITE (SmbusInfo->Io.Smbus       + SMBUS_MASTER_PEC,         0x0);
+    // Zero sent and received byte count.
+    TYU_WRITE (SmbusInfo->Io.Smbus       + SMBUS_RS_BYTES,           0x0);
+
+    // GW activation
+    TYU_WRITE (SmbusInfo->Io.Smbus       + SMBUS_MASTER_GW, ControlWord);
+
+    // The device is ready once it acknowledges its address; a NACK means
+    // the write cycle is still in progress.
+    Status = I2cSmbusReturnTransactionStatus (SmbusInfo);
+    if (!EFI_ERROR (Status)) {
+      SmbusInfo->WriteCycleSlave = 0;
+      return EFI_SUCCESS;
+    }
+
+    I2cSmbusStall (SMBUS_ACK_POLL_PERIOD);
+  } while (Timeout-- != 0);
+
+  return EFI_TIMEOUT;
+}
+
 STATIC
 SMBUS_INFO *
 I2cSmbusGetSmbusInfoFromSlaveDeviceAddr (
@@ -901,6 +972,12 @@ I2cSmbusRead (
   if (!I2cSmbusMasterIsIdle (SmbusInfo))
     goto out;
 
+  // The device does not respond until the end of the write cycle started
+  // by a previous write transaction.
+  Status = I2cSmbusWaitForWriteCycle (SmbusInfo, SlaveAddress);
+  if (EFI_ERROR (Status))
+    goto out;
+
   // Write Slave address to the MSB of control data. Slave address is shifted
   // left by 1 as required by hardware.
   ControlData  = (SlaveAddress & 0x7f) << 1;
@@ -990,9 +1067,13 @@ I2cSmbusWriteData (
   }
 }
 
+// Write data bytes to a slave device in a single bus transaction, i.e.
+// from one START token to one STOP token. The transaction may need several
+// Master GW loads.
 STATIC
 EFI_STATUS
-I2cSmbusWrite (
+I2cSmbusWriteTransaction (
+  IN SMBUS_INFO         *SmbusInfo,
   IN UINT8              SlaveAddress,
   IN UINT32             Command,
   IN OUT CONST UINT8    *DataBuf,
@@ -1001,7 +1082,6 @@ I2cSmbusWrite (
   IN UINTN              PecEnable
   )
 {
-  SMBUS_INFO *SmbusInfo;
   UINT8      DataDesc[MASTER_DATA_DESC_SIZE] = { 0 };
   UINT8      DataDescLength, DataByteLength, WriteSize;
   UINT8      ByteIdx, ByteOff;
@@ -1011,23 +1091,6 @@ I2cSmbusWrite (
   BOOLEAN    LastTransaction, FirstTransaction;
   EFI_STATUS Status = EFI_SUCCESS;
 
-  SmbusInfo = I2cSmbusGetSmbusInfoFromSlaveDeviceAddr (SlaveAddress);
-  if (!SmbusInfo)
-    return EFI_NOT_FOUND;
-
-  *ByteSent = 0;
-  // The Smbus Data Write flow:
-  // - The control bits are copied to the first Master GW control word.
-  // - The slave address byte and SMBus command bytes are copied to the first
-  //   data word in the Master GW Data Descriptor, followed by the data bytes.
-  // Note that Master GW data is shifted left so the data will start at the
-  // beginning.
-  I2cSmbusAcquireLock (&gSmbusContext.Lock);
-
-  // Check whether the SMBus Master GW is idle.
-  if (!I2cSmbusMasterIsIdle (SmbusInfo))
-    goto out;
-
   FirstTransaction = TRUE;
   LastTransaction  = FALSE;
 
@@ -1146,16 +1209,92 @@ I2cSmbusWrite (
     if (EFI_ERROR (Status))
       break;
 
-    // EEPROM devices require 5ms delay after I2C Write to copy out data
-    // from the cache.
-    if (!IsSimulator())
-      I2cSmbusStall (SMBUS_WRITE_TRANS_TIMEOUT);
-
     // Update remaining data bytes to write. Note that control bytes does not
     // count. Indeed, these bytes are required by the write transfer.
     DataLength -= DataByteLength;
   } while (DataLength > 0);
 
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+I2cSmbusWrite (
+  IN UINT8              SlaveAddress,
+  IN UINT32             Command,
+  IN OUT CONST UINT8    *DataBuf,
+  IN UINTN              DataLength,
+  IN OUT UINTN          *ByteSent,
+  IN UINTN              PecEnable
+  )
+{
+  SMBUS_INFO *SmbusInfo;
+  UINTN      PageSize, PageOffset;
+  UINTN      SegmentLength;
+  EFI_STATUS Status = EFI_SUCCESS;
+
+  SmbusInfo = I2cSmbusGetSmbusInfoFromSlaveDeviceAddr (SlaveAddress);
+  if (!SmbusInfo)
+    return EFI_NOT_FOUND;
+
+  *ByteSent = 0;
+  // The Smbus Data Write flow:
+  // - The control bits are copied to the first Master GW control word.
+  // - The slave address byte and SMBus command bytes are copied to the first
+  //   data word in the Master GW Data Descriptor, followed by the data bytes.
+  // Note that Master GW data is shifted left so the data will start at the
+  // beginning.
+  I2cSmbusAcquireLock (&gSmbusContext.Lock);
+
+  // Check whether the SMBus Master GW is idle.
+  if (!I2cSmbusMasterIsIdle (SmbusInfo))
+    goto out;
+
+  // Note that the EEPROM device used to store system variables supports
+  // a "page write" mode. In "page write" mode, the data byte address lower
+  // bits (corresponding to the page mask (= PageSize - 1)) are internally
+  // incremented following the receipt of each data byte. The higher data
+  // byte address bits are not incremented, retaining the memory page row
+  // location. When the byte address, internally generated, reaches the page
+  // boundary, the following byte is placed at the beginning of the same page,
+  // i.e. the address roll over is from the last byte of the current page to
+  // the first byte of the same page. If more than PAGE_SIZE data bytes are
+  // transmitted to the EEPROM, the data word address will "roll over" and
+  // previous data will be overwritten. In order to recreate a sequential
+  // write, we have to trancate writes at page boundaries.
+  // The pages are streamed back to back under the same lock: each one is
+  // sent as soon as the device acknowledges its address again, i.e. once
+  // the write cycle of the previous page completed.
+  PageSize = 0;
+  if (SlaveAddress == gEepromContext.Chip)
+    PageSize = gEepromContext.PageSize;
+
+  while (DataLength > 0) {
+    Status = I2cSmbusWaitForWriteCycle (SmbusInfo, SlaveAddress);
+    if (EFI_ERROR (Status))
+      break;
+
+    SegmentLength = DataLength;
+    if (PageSize != 0) {
+      PageOffset    = (Command + *ByteSent) & (PageSize - 1);
+      SegmentLength = MIN (DataLength, PageSize - PageOffset);
+    }
+
+    Status = I2cSmbusWriteTransaction (SmbusInfo, SlaveAddress, Command,
+                                       DataBuf, SegmentLength, ByteSent,
+                                       PecEnable);
+    if (EFI_ERROR (Status))
+      break;
+
+    // The device now copies the data out of its cache and ignores the bus
+    // until done. Rather than waiting here, the next transaction to the
+    // device polls for the end of the write cycle.
+    if (!IsSimulator())
+      SmbusInfo->WriteCycleSlave = SlaveAddress;
+
+    DataLength -= SegmentLength;
+  }
+
 out:
   I2cSmbusReleaseLock (&gSmbusContext.Lock);
   return Status;
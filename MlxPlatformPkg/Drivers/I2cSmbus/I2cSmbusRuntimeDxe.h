@@ -306,6 +306,9 @@
 #define SMBUS_WRITE_TRANS_TIMEOUT       (6   * 1000) //   6ms
 // Polling frequency expressed in microseconds.
 #define SMBUS_POLL_FREQ                 1
+// Period of the acknowledge polling of a device in its write cycle, in
+// microseconds.
+#define SMBUS_ACK_POLL_PERIOD           50
 // Timeout is given in nanosecond.
 #define SMBUS_WAIT_FOR_COALESCE_TIMEOUT (10 * 1000 * 1000)
 
@@ -377,6 +380,8 @@ typedef struct {
   UINT8         Slaves [SMBUS_SLAVE_ADDR_CNT];   // List of slave controllers.
   UINT8         SlavesCnt;      // Number of slave controllers
   UINT8         Status;         // Whether it is enabled or disabled.
+  UINT8         WriteCycleSlave;  // Slave device that may be in its write
+                                  // cycle, 0 if none.
 } SMBUS_INFO;
 
 // Enums for SMBUS_INFO. Status field.
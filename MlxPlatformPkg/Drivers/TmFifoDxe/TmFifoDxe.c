@@ -50,6 +50,113 @@ static UINT8 BCastMac[NET_ETHER_ADDR_LEN] = {
   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
   };
 
+/*
+ *  Write the queued frames to the Tx FIFO as long as it has room for them.
+ *  Frames stay queued while the console is writing the FIFO. Must be called
+ *  at TPL_NOTIFY.
+ */
+STATIC
+VOID
+TmFifoTxKick (
+  IN OUT TMFIFO_DRIVER *LanDriver
+  )
+{
+  TMFIFO_TX_DESC *Desc;
+  UINT32          Avail;
+  UINTN           Words, Left;
+  UINT64          Value;
+
+  if (LanDriver->TxSendTag == LanDriver->NextPacketTag || LanDriver->TxBusy) {
+    return;
+  }
+
+  LanDriver->TxBusy = TRUE;
+  Avail = TmFifoTxAvail (8);
+  while (LanDriver->TxSendTag != LanDriver->NextPacketTag) {
+    Desc = &LanDriver->TxRing[LanDriver->TxSendTag % TMFIFO_TX_RING_NUM_ENTRIES];
+
+    // Header words + payload rounded up to 8 bytes
+    Words = 3 + (Desc->PayloadSize + sizeof (UINT64) - 1) / sizeof (UINT64);
+    if (Avail < Words) {
+      break;
+    }
+
+    TmFifoWriteBurst (Desc->HdrWords, 3);
+
+    // Write the 8-byte blocks directly from the caller's buffer
+    TmFifoWriteBurst (Desc->Payload, Desc->PayloadSize / sizeof (UINT64));
+
+    // Write the leftover data and padded it to 8 bytes.
+    Left = Desc->PayloadSize % sizeof (UINT64);
+    if (Left > 0) {
+      Value = 0;
+      CopyMem ((UINT8*)&Value, Desc->Payload + Desc->PayloadSize - Left, Left);
+      TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
+    }
+
+    Avail -= Words;
+    LanDriver->TxWords += Words;
+    Desc->EndWord = LanDriver->TxWords;
+    LanDriver->TxSendTag++;
+  }
+  LanDriver->TxBusy = FALSE;
+}
+
+/*
+ *  Retire the frames the host has drained from the Tx FIFO.
+ *
+ *  The FIFO has no per-frame completion, so the drain level is derived from
+ *  the number of words written so far minus the words still pending in the
+ *  FIFO. Console data shares the FIFO and isn't accounted in TxWords, which
+ *  only makes the estimate conservative: every frame completes at the latest
+ *  once the FIFO is empty. Must be called at TPL_NOTIFY.
+ */
+STATIC
+VOID
+TmFifoTxReap (
+  IN OUT TMFIFO_DRIVER *LanDriver
+  )
+{
+  UINT64 Drained;
+  UINT32 Pending;
+
+  if (LanDriver->TxDoneTag == LanDriver->TxSendTag) {
+    return;
+  }
+
+  Pending = TmFifoTxPending ();
+  Drained = (LanDriver->TxWords > Pending) ? LanDriver->TxWords - Pending : 0;
+
+  while (LanDriver->TxDoneTag != LanDriver->TxSendTag &&
+         LanDriver->TxRing[LanDriver->TxDoneTag %
+                           TMFIFO_TX_RING_NUM_ENTRIES].EndWord <= Drained) {
+    LanDriver->TxDoneTag++;
+  }
+}
+
+/*
+ *  Periodic poller.
+ *
+ *  Drains the FIFO into the receive ring while the interface is initialized,
+ *  so frames arriving between two Receive() calls are not left in the FIFO.
+ *  It never writes the Tx FIFO, the frames queued while it was full are
+ *  pushed by Transmit() and GetStatus().
+ */
+STATIC
+VOID
+EFIAPI
+TmFifoRxPollNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  TMFIFO_DRIVER *LanDriver = Context;
+
+  if (LanDriver->SnpMode.State == EfiSimpleNetworkInitialized) {
+    TmFifoRxDrain (LanDriver);
+  }
+}
+
 /*
  *  UEFI Start() function
  *
@@ -108,6 +215,7 @@ TmFifoSnpStop (
   switch (Snp->Mode->State) {
     case EfiSimpleNetworkStarted:
     case EfiSimpleNetworkInitialized:
+      gBS->SetTimer (INSTANCE_FROM_SNP_THIS (Snp)->RxPollEvent, TimerCancel, 0);
       Snp->Mode->State = EfiSimpleNetworkStopped;
       break;
     default:
@@ -131,12 +239,15 @@ TmFifoSnpInitialize (
   )
 {
   MLNX_EFI_INFO *Info = (MLNX_EFI_INFO *)MLNX_EFI_INFO_ADDR;
+  TMFIFO_DRIVER *LanDriver;
 
   // Check Snp Instance
   if (Snp == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
+  LanDriver = INSTANCE_FROM_SNP_THIS (Snp);
+
   // First check that driver has not already been initialized
   if (Snp->Mode->State == EfiSimpleNetworkInitialized) {
     DEBUG ((EFI_D_WARN, "TMFIFO Driver already initialized\n"));
@@ -162,9 +273,16 @@ TmFifoSnpInitialize (
     }
   }
 
+  // Start the throughput measurement window
+  LanDriver->StatsStartTick = GetPerformanceCounter ();
+
   // Declare the driver as initialized
   Snp->Mode->State = EfiSimpleNetworkInitialized;
 
+  // Start filling the receive ring
+  gBS->SetTimer (LanDriver->RxPollEvent, TimerPeriodic,
+                 FixedPcdGet32 (PcdTmFifoRxPollPeriod));
+
   return EFI_SUCCESS;
 }
 
@@ -179,6 +297,9 @@ TmFifoSnpReset (
   IN        BOOLEAN Verification
   )
 {
+  TMFIFO_DRIVER *LanDriver;
+  EFI_TPL        OldTpl;
+
   // Check Snp Instance
   if (Snp == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -193,8 +314,21 @@ TmFifoSnpReset (
     return EFI_NOT_STARTED;
   }
 
-  // Initiate the FIFO
+  LanDriver = INSTANCE_FROM_SNP_THIS (Snp);
+
+  // Initiate the FIFO and discard the frames pending in the receive ring
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
   TmFifoInit();
+  LanDriver->RxHdr.Data = 0;
+  LanDriver->RxSize = 0;
+  LanDriver->RxCons = LanDriver->RxProd;
+
+  // The queued frames are dropped, their buffers are still handed back by
+  // GetStatus()
+  LanDriver->TxSendTag = LanDriver->NextPacketTag;
+  LanDriver->TxDoneTag = LanDriver->NextPacketTag;
+  LanDriver->TxWords = 0;
+  gBS->RestoreTPL (OldTpl);
 
   return EFI_SUCCESS;
 }
@@ -224,6 +358,7 @@ TmFifoSnpShutdown (
   }
 
   // Back to the started and thus not initialized state
+  gBS->SetTimer (INSTANCE_FROM_SNP_THIS (Snp)->RxPollEvent, TimerCancel, 0);
   Snp->Mode->State = EfiSimpleNetworkStarted;
 
   return EFI_SUCCESS;
@@ -395,6 +530,7 @@ TmFifoSnpStatistics (
 {
   TMFIFO_DRIVER  *LanDriver;
   EFI_STATUS      Status;
+  UINT64          ElapsedNs;
 
   // Check Snp instance
   if (Snp == NULL) {
@@ -414,9 +550,25 @@ TmFifoSnpStatistics (
     return EFI_NOT_STARTED;
   }
 
+  // Report the throughput since the last reset. EFI_NETWORK_STATISTICS has
+  // no field for it, so it goes to the debug log.
+  ElapsedNs = GetTimeInNanoSecond (GetPerformanceCounter () -
+                                   LanDriver->StatsStartTick);
+  if (ElapsedNs >= 1000000) {
+    DEBUG ((EFI_D_INFO, "TMFIFO: Tx %Ld KB/s, Rx %Ld KB/s\n",
+      DivU64x64Remainder (MultU64x32 (LanDriver->Stats.TxTotalBytes, 1000000),
+                          ElapsedNs, NULL),
+      DivU64x64Remainder (MultU64x32 (LanDriver->Stats.RxTotalBytes, 1000000),
+                          ElapsedNs, NULL)));
+  }
+  DEBUG ((EFI_D_INFO, "TMFIFO: Rx dropped %Ld, ring overruns %Ld\n",
+    LanDriver->Stats.RxDroppedFrames, LanDriver->RxOverruns));
+
   // Reset the statistics.
   if (Reset) {
     ZeroMem (&LanDriver->Stats, sizeof (EFI_NETWORK_STATISTICS));
+    LanDriver->RxOverruns = 0;
+    LanDriver->StatsStartTick = GetPerformanceCounter ();
   }
 
   Status = EFI_SUCCESS;
@@ -545,6 +697,7 @@ TmFifoSnpGetStatus (
 {
   UINT16          PacketTag;
   TMFIFO_DRIVER *LanDriver;
+  EFI_TPL        OldTpl;
 
   // Check preliminaries
   if (Snp == NULL) {
@@ -562,16 +715,35 @@ TmFifoSnpGetStatus (
     return EFI_NOT_STARTED;
   }
 
-  if (LanDriver->PacketTag != LanDriver->NextPacketTag) {
-    PacketTag = LanDriver->PacketTag;
-    if (TxBuff != NULL) {
-      *TxBuff = LanDriver->TxRing[PacketTag % TMFIFO_TX_RING_NUM_ENTRIES];
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  // Push the queued frames and retire the ones drained by the host
+  TmFifoTxKick (LanDriver);
+  TmFifoTxReap (LanDriver);
+
+  if (IrqStat != NULL) {
+    *IrqStat = 0;
+    if (LanDriver->RxProd != LanDriver->RxCons) {
+      *IrqStat |= EFI_SIMPLE_NETWORK_RECEIVE_INTERRUPT;
+    }
+    if (LanDriver->PacketTag != LanDriver->TxDoneTag) {
+      *IrqStat |= EFI_SIMPLE_NETWORK_TRANSMIT_INTERRUPT;
     }
-    LanDriver->PacketTag++;
-  } else if (TxBuff != NULL) {
+  }
+
+  // Recycle one drained buffer per call
+  if (TxBuff != NULL) {
+    if (LanDriver->PacketTag != LanDriver->TxDoneTag) {
+      PacketTag = LanDriver->PacketTag;
+      *TxBuff = LanDriver->TxRing[PacketTag % TMFIFO_TX_RING_NUM_ENTRIES].Buff;
+      LanDriver->PacketTag++;
+    } else {
       *TxBuff = NULL;
+    }
   }
 
+  gBS->RestoreTPL (OldTpl);
+
   return EFI_SUCCESS;
 }
 
@@ -593,11 +765,11 @@ TmFifoSnpTransmit (
   )
 {
   TMFIFO_DRIVER *LanDriver;
-  UINT32 TxFreeSpace;
-  UINT16 PacketTag, LocalProtocol;
+  TMFIFO_TX_DESC *Desc;
+  UINT16 LocalProtocol;
   TMFIFO_MSG_HDR Hdr;
-  UINT64 Value;
   UINT8 *Data = (UINT8 *)Buff;
+  EFI_TPL OldTpl;
 
   // Check preliminaries
   if ((Snp == NULL) || (Data == NULL)) {
@@ -633,9 +805,14 @@ TmFifoSnpTransmit (
       return EFI_BUFFER_TOO_SMALL;
   }
 
-  // Get FIFO free space in bytes
-  TxFreeSpace = TmFifoTxAvail (8) * sizeof (UINT64);
-  if (TxFreeSpace < BuffSize + sizeof (TMFIFO_MSG_HDR)) {
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  // The frame is queued if the FIFO is full, so only a full Tx ring, which
+  // means the consumer doesn't recycle the buffers, stops the transmission.
+  TmFifoTxReap (LanDriver);
+  if ((UINT16)(LanDriver->NextPacketTag - LanDriver->PacketTag) >=
+      TMFIFO_TX_RING_NUM_ENTRIES) {
+    gBS->RestoreTPL (OldTpl);
     return EFI_NOT_READY;
   }
 
@@ -662,50 +839,39 @@ TmFifoSnpTransmit (
     LanDriver->Stats.TxUnicastFrames += 1;
   }
 
-  // Write the packet header
+  // Build the packet header and the rewritten Ethernet header now, as the
+  // address and protocol arguments don't have to outlive this call. They
+  // go out in the same burst as the payload.
+  Desc = &LanDriver->TxRing[LanDriver->NextPacketTag %
+                            TMFIFO_TX_RING_NUM_ENTRIES];
   Hdr.Data = 0;
   Hdr.Type = VIRTIO_ID_NET;
   Hdr.Len = HTONS(BuffSize);
-  TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Hdr.Data);
+  Desc->HdrWords[0] = Hdr.Data;
 
-  // Write Dst-MAC (6B) + Src-MAC (2B)
-  CopyMem (&Value, DstAddr->Addr, NET_ETHER_ADDR_LEN);
-  CopyMem ((UINT8*)&Value + 6, SrcAddr->Addr, 2);
-  TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
+  // Dst-MAC (6B) + Src-MAC (2B)
+  CopyMem (&Desc->HdrWords[1], DstAddr->Addr, NET_ETHER_ADDR_LEN);
+  CopyMem ((UINT8*)&Desc->HdrWords[1] + 6, SrcAddr->Addr, 2);
 
-  // Write Src-MAC (4B) + Protocol (2B) + Data (2B)
-  CopyMem ((UINT8*)&Value, (UINT8*)SrcAddr->Addr + 2, 4);
-  *(UINT16*)((UINT8*)&Value + 4) = LocalProtocol;
-  CopyMem ((UINT8*)&Value + 6, Data + 14, 2);
-  TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
+  // Src-MAC (4B) + Protocol (2B) + Data (2B)
+  CopyMem ((UINT8*)&Desc->HdrWords[2], (UINT8*)SrcAddr->Addr + 2, 4);
+  *(UINT16*)((UINT8*)&Desc->HdrWords[2] + 4) = LocalProtocol;
+  CopyMem ((UINT8*)&Desc->HdrWords[2] + 6, Data + 14, 2);
 
-  // Write the 8-byte blocks
-  BuffSize -= 2 * sizeof (UINT64);
-  Data += 2 * sizeof (UINT64);
-  while (BuffSize >= sizeof (UINT64)) {
-    CopyMem ((UINT8*)&Value, Data, sizeof (UINT64));
-    TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
-    BuffSize -= sizeof (UINT64);
-    Data += sizeof (UINT64);
-  }
-
-  // Write the leftover data and padded it to 8 bytes.
-  if (BuffSize > 0) {
-    Value = 0;
-    CopyMem ((UINT8*)&Value, Data, BuffSize);
-    TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
-  }
+  Desc->Buff = Buff;
+  Desc->Payload = Data + 2 * sizeof (UINT64);
+  Desc->PayloadSize = BuffSize - 2 * sizeof (UINT64);
 
   LanDriver->Stats.TxTotalFrames += 1;
   LanDriver->Stats.TxGoodFrames += 1;
   LanDriver->Stats.TxTotalBytes += BuffSize;
 
-  // Save the address of the submitted packet so we can notify the consumer that
-  // it has been sent in GetStatus. When the packet tag appears in the Tx Status
-  // Fifo, we will return Buffer in the TxBuff parameter of GetStatus.
-  PacketTag = LanDriver->NextPacketTag;
-  LanDriver->TxRing[PacketTag % TMFIFO_TX_RING_NUM_ENTRIES] = Buff;
+  // Queue the frame and write it out if the FIFO has room. The buffer is
+  // handed back by GetStatus() once the host has drained it from the FIFO.
   LanDriver->NextPacketTag++;
+  TmFifoTxKick (LanDriver);
+
+  gBS->RestoreTPL (OldTpl);
 
   return EFI_SUCCESS;
 }
@@ -728,10 +894,13 @@ TmFifoSnpReceive (
   )
 {
   TMFIFO_DRIVER  *LanDriver;
+  TMFIFO_RX_DESC *Desc;
   UINT8          *RawData;
   ETHER_HEAD     *EthHdr;
   UINT32          PLength; // Packet length
   UINT32          ReceiveFilterSetting;
+  EFI_STATUS      Status;
+  EFI_TPL         OldTpl;
 
   // Check preliminaries
   if ((Snp == NULL) || (Data == NULL) || (BuffSize == NULL)) {
@@ -749,37 +918,36 @@ TmFifoSnpReceive (
     return EFI_NOT_STARTED;
   }
 
-  // Check if a complete packet has been received.
+  // The ring is shared with the periodic poller
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  // Drain the FIFO in case the poller hasn't run since the last call, then
+  // check if a complete packet has been received.
   if (!TmFifoPoll (LanDriver)) {
-    return EFI_NOT_READY;
+    Status = EFI_NOT_READY;
+    goto Exit;
   }
 
-  // Get the received packet length
-  PLength = NTOHS(LanDriver->RxHdr.Len);
+  Desc = &LanDriver->RxRing[LanDriver->RxCons % LanDriver->RxRingSize];
+  PLength = Desc->Len;
 
-  // Ignore non-networking packets
-  if (PLength == 0 || LanDriver->RxHdr.Type != VIRTIO_ID_NET) {
-    return EFI_NOT_READY;
+  // Check buffer size. The frame stays in the ring so the caller can retry
+  // with a larger buffer.
+  if (*BuffSize < PLength) {
+    *BuffSize = PLength;
+    Status = EFI_BUFFER_TOO_SMALL;
+    goto Exit;
   }
 
-  // Ready for next packet
-  LanDriver->RxHdr.Len = 0;
-  LanDriver->RxSize = 0;
-
+  // The frame is consumed from now on
+  LanDriver->RxCons++;
   LanDriver->Stats.RxTotalBytes += PLength;
   LanDriver->Stats.RxTotalFrames++;
 
-  // Check buffer size
-  if (*BuffSize < PLength) {
-    *BuffSize = PLength;
-    LanDriver->Stats.RxDroppedFrames++;
-    return EFI_BUFFER_TOO_SMALL;
-  }
-
   //
   // Software filtering processing.
   //
-  EthHdr = (ETHER_HEAD *)LanDriver->RxPkt;
+  EthHdr = (ETHER_HEAD *)Desc->Data;
   ReceiveFilterSetting = Snp->Mode->ReceiveFilterSetting;
 
   if (!(ReceiveFilterSetting & EFI_SIMPLE_NETWORK_RECEIVE_PROMISCUOUS)) {
@@ -788,13 +956,15 @@ TmFifoSnpReceive (
                       NET_ETHER_ADDR_LEN) != 0) {
         // If not promiscuous, drop unicast packets if not destined to this MAC.
         // No need to update the drop-counter (similar to HW NIC behavior).
-        return EFI_NOT_READY;
+        Status = EFI_NOT_READY;
+        goto Exit;
       }
     } else if (CompareMem (EthHdr->DstMac, BCastMac, NET_ETHER_ADDR_LEN) == 0) {
       // Drop broadcast packets if not allowed.
       if (!(ReceiveFilterSetting & EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST)) {
         LanDriver->Stats.RxDroppedFrames++;
-        return EFI_NOT_READY;
+        Status = EFI_NOT_READY;
+        goto Exit;
       }
     }
   }
@@ -808,8 +978,9 @@ TmFifoSnpReceive (
   // Format the pointer
   RawData = (UINT8*)Data;
 
-  // Get Rx Packet
-  CopyMem (RawData, LanDriver->RxPkt, PLength);
+  // Get Rx Packet straight from the ring entry the FIFO was drained into.
+  // The entry can't be reused by the poller before we restore the TPL.
+  CopyMem (RawData, Desc->Data, PLength);
 
   // Get the destination MAC address
   if (DstAddr != NULL) {
@@ -827,8 +998,11 @@ TmFifoSnpReceive (
   }
 
   LanDriver->Stats.RxGoodFrames++;
+  Status = EFI_SUCCESS;
 
-  return EFI_SUCCESS;
+Exit:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
 }
 
 /*
@@ -854,6 +1028,26 @@ TmFifoDxeEntry (
   if (LanDriver == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
+  LanDriver->RxRingSize = FixedPcdGet32 (PcdTmFifoRxRingEntries);
+  ASSERT (LanDriver->RxRingSize > 0);
+  LanDriver->RxRing = AllocateZeroPool (LanDriver->RxRingSize *
+                                        sizeof (TMFIFO_RX_DESC));
+  if (LanDriver->RxRing == NULL) {
+    FreePool (LanDriver);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  TmFifoRxPollNotify,
+                  LanDriver,
+                  &LanDriver->RxPollEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    FreePool (LanDriver->RxRing);
+    FreePool (LanDriver);
+    return Status;
+  }
   TmFifoPath = (TMFIFO_DEVICE_PATH*)AllocateCopyPool (
                  sizeof (TMFIFO_DEVICE_PATH), &TmFifoPathTemplate);
   if (TmFifoPath == NULL) {
@@ -909,8 +1103,8 @@ TmFifoDxeEntry (
   // Mac address is changeable as it is loaded from erasable memory
   SnpMode->MacAddressChangeable = TRUE;
 
-  // Can only transmit one packet at a time
-  SnpMode->MultipleTxSupported = FALSE;
+  // Frames are queued while the FIFO is full
+  SnpMode->MultipleTxSupported = TRUE;
 
   // MediaPresent checks for cable connection and partner link
   SnpMode->MediaPresentSupported = FALSE;
@@ -956,6 +1150,8 @@ TmFifoDxeEntry (
                   );
   // Say what the status of loading the protocol structure is
   if (EFI_ERROR(Status)) {
+    gBS->CloseEvent (LanDriver->RxPollEvent);
+    FreePool (LanDriver->RxRing);
     FreePool (LanDriver);
   } else {
     MLNX_EFI_INFO *Info = (MLNX_EFI_INFO *)MLNX_EFI_INFO_ADDR;
@@ -32,6 +32,7 @@
 #include <Library/IoLib.h>
 #include <Library/PcdLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/TimerLib.h>
 
 #include "rsh_def.h"
 #include "TmFifoLib.h"
@@ -47,6 +48,28 @@
 
 #define TMFIFO_CONS_RING_SIZE        1024
 
+/*------------------------------------------------------------------------------
+  Transmit ring descriptor. The tmfifo and Ethernet headers are built when the
+  frame is queued, the payload is written from the caller's buffer once the
+  FIFO has room for the whole frame.
+ -----------------------------------------------------------------------------*/
+typedef struct {
+  VOID   *Buff;         // Caller's buffer, handed back by GetStatus()
+  UINT8  *Payload;      // Data following the first 16 bytes of the frame
+  UINTN  PayloadSize;
+  UINT64 HdrWords[3];   // tmfifo header + first 16 bytes of the frame
+  UINT64 EndWord;       // TxWords value once the frame is in the FIFO
+} TMFIFO_TX_DESC;
+
+/*------------------------------------------------------------------------------
+  Receive ring descriptor. Frames are drained from the FIFO straight into the
+  descriptor and handed to the SNP consumer from there.
+ -----------------------------------------------------------------------------*/
+typedef struct {
+  UINT16 Len;
+  UINT64 Data[TMFIFO_RX_PKT_SIZE / sizeof (UINT64)];
+} TMFIFO_RX_DESC;
+
 /*------------------------------------------------------------------------------
   TMFIFO Information Structure
  -----------------------------------------------------------------------------*/
@@ -62,16 +85,38 @@ struct TMFIFO_DRIVER {
   // EFI Snp statistics instance
   EFI_NETWORK_STATISTICS Stats;
 
-  // Saved transmitted buffers so we can notify consumers when packets have
-  // been sent.
+  // Performance counter value when the statistics were last reset, used to
+  // report the FIFO throughput.
+  UINT64  StatsStartTick;
+
+  // Transmit ring. The free-running tags split it into frames which were
+  // drained by the host and wait to be recycled by GetStatus()
+  // [PacketTag, TxDoneTag), frames in the FIFO [TxDoneTag, TxSendTag) and
+  // frames queued while the FIFO was full [TxSendTag, NextPacketTag).
   UINT16  PacketTag;
+  UINT16  TxDoneTag;
+  UINT16  TxSendTag;
   UINT16  NextPacketTag;
-  VOID    *TxRing[TMFIFO_TX_RING_NUM_ENTRIES];
+  TMFIFO_TX_DESC TxRing[TMFIFO_TX_RING_NUM_ENTRIES];
+
+  // Number of words written to the Tx FIFO by the network interface
+  UINT64  TxWords;
 
-  // Rx Packet
+  // Rx Packet being drained from the FIFO. RxBuf points either to the
+  // producer entry of the receive ring or to RxPkt, which holds console
+  // data and frames dropped because the ring is full.
   UINT16 RxSize;
   TMFIFO_MSG_HDR RxHdr;
-  UINT8  RxPkt[TMFIFO_RX_PKT_SIZE];
+  UINT64 *RxBuf;
+  UINT64 RxPkt[TMFIFO_RX_PKT_SIZE / sizeof (UINT64)];
+
+  // Network receive ring, filled by the poller and consumed by Receive().
+  // RxProd and RxCons are free-running indexes.
+  TMFIFO_RX_DESC *RxRing;
+  UINT32 RxRingSize;
+  UINT32 RxProd, RxCons;
+  UINT64 RxOverruns;
+  EFI_EVENT RxPollEvent;
 
   // Console ring
   UINT8  ConsRing[TMFIFO_CONS_RING_SIZE];
@@ -81,6 +126,11 @@ struct TMFIFO_DRIVER {
   UINT64 ConsTxWord;
   UINT16 ConsTxSize;
 
+  // Set while a message is being written to the Tx FIFO. The console writes
+  // the FIFO at any TPL, so a writer which finds it set backs off rather
+  // than interleaving its words with the other message.
+  BOOLEAN TxBusy;
+
   UINT32 RxBase;
   UINT32 TxBase;
 };
@@ -75,103 +75,159 @@ TmFifoConsAvailSpace(
   return TMFIFO_CONS_RING_SIZE - Used;
 }
 
+/*
+ * Pick the buffer the packet described by RxHdr is drained into. Network
+ * packets go straight into the next free receive ring entry; console data,
+ * packets received while the interface is down and packets arriving while
+ * the ring is full go into the RxPkt staging buffer.
+ */
+STATIC
+VOID
+TmFifoRxSelectBuffer (
+  IN OUT TMFIFO_DRIVER *LanDriver
+  )
+{
+  LanDriver->RxBuf = LanDriver->RxPkt;
+
+  if (LanDriver->RxHdr.Type != VIRTIO_ID_NET ||
+      LanDriver->SnpMode.State != EfiSimpleNetworkInitialized ||
+      LanDriver->RxRing == NULL) {
+    return;
+  }
+
+  if (LanDriver->RxProd - LanDriver->RxCons >= LanDriver->RxRingSize) {
+    LanDriver->RxOverruns++;
+    LanDriver->Stats.RxDroppedFrames++;
+    return;
+  }
+
+  LanDriver->RxBuf =
+    LanDriver->RxRing[LanDriver->RxProd % LanDriver->RxRingSize].Data;
+}
+
+/*
+ * Hand the completely drained packet over to its consumer.
+ */
+STATIC
+VOID
+TmFifoRxComplete (
+  IN OUT TMFIFO_DRIVER *LanDriver
+  )
+{
+  UINT32 Len;
+  UINT8  *RxPkt = (UINT8 *)LanDriver->RxPkt;
+
+  Len = ntohs (LanDriver->RxHdr.Len);
+
+  // Publish the network packet in the receive ring
+  if (LanDriver->RxBuf != LanDriver->RxPkt) {
+    LanDriver->RxRing[LanDriver->RxProd % LanDriver->RxRingSize].Len = Len;
+    LanDriver->RxProd++;
+    return;
+  }
+
+  if (LanDriver->RxHdr.Type != VIRTIO_ID_CONSOLE) {
+    // Drop
+    return;
+  }
+
+  // Save the console input if there is enough space, or else drop it
+  if (TmFifoConsAvailSpace(LanDriver) > Len) {
+    if (LanDriver->ConsTail + Len <= TMFIFO_CONS_RING_SIZE) {
+      CopyMem (&LanDriver->ConsRing[LanDriver->ConsTail], RxPkt, Len);
+      LanDriver->ConsTail += Len;
+      if (LanDriver->ConsTail >= TMFIFO_CONS_RING_SIZE) {
+        LanDriver->ConsTail -= TMFIFO_CONS_RING_SIZE;
+      }
+    } else {
+      CopyMem (&LanDriver->ConsRing[LanDriver->ConsTail], RxPkt,
+               TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail);
+      CopyMem (&LanDriver->ConsRing[0],
+               &RxPkt[TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail],
+               Len - (TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail));
+      LanDriver->ConsTail = Len - (TMFIFO_CONS_RING_SIZE -
+                                   LanDriver->ConsTail);
+    }
+  }
+}
+
 BOOLEAN
 EFIAPI
 TmFifoPoll (
   IN OUT TMFIFO_DRIVER *LanDriver
   )
 {
-  UINT64 Data;
-  UINT32 Avail = 0, Len;
+  UINT64 Flush[2];
   TMFIFO_MSG_HDR Hdr;
 
   // Flush the pending console Tx word if not in the middle of a network packet
   if (LanDriver->RxHdr.Len == 0 && LanDriver->ConsTxSize > 0 &&
+      !LanDriver->TxBusy &&
       sizeof (Hdr) + LanDriver->ConsTxSize <= TmFifoTxAvail (0) * 8) {
+    LanDriver->TxBusy = TRUE;
     Hdr.Data = 0;
     Hdr.Type = VIRTIO_ID_CONSOLE;
     ((UINT8*)&Hdr.Len)[0] = (LanDriver->ConsTxSize >> 8) & 0xFF;
     ((UINT8*)&Hdr.Len)[1] = LanDriver->ConsTxSize & 0xFF;
-    TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Hdr.Data);
-    TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, LanDriver->ConsTxWord);
+    Flush[0] = Hdr.Data;
+    Flush[1] = LanDriver->ConsTxWord;
+    TmFifoWriteBurst (Flush, 2);
     LanDriver->ConsTxSize = 0;
+    LanDriver->TxBusy = FALSE;
   }
 
-  // Read packet header
-  if (LanDriver->RxHdr.Len == 0) {
-    Avail = TmFifoRxAvail ();
-    if (Avail * sizeof(UINT64) < sizeof (LanDriver->RxHdr))
-      return FALSE;
-
-    LanDriver->RxHdr.Data = TmFifoRead64 (RSH_TM_HOST_TO_TILE_DATA);
-    Avail--;
-    if (LanDriver->RxHdr.Len == 0)
-      return FALSE;
-
-    if (ntohs (LanDriver->RxHdr.Len) >= sizeof (LanDriver->RxPkt)) {
-      DEBUG ((EFI_D_ERROR, "Error: RxHdr.Len = %d too big\n",
-        ntohs (LanDriver->RxHdr.Len)));
-      LanDriver->RxHdr.Data = 0;
-      return FALSE;
-    }
-  }
+  return TmFifoRxDrain (LanDriver);
+}
 
-  while (LanDriver->RxSize < ntohs (LanDriver->RxHdr.Len)) {
-    // Check the available data in the FIFO
-    if (Avail == 0) {
-      Avail = TmFifoRxAvail ();
-      if (Avail == 0)
-        return FALSE;
+BOOLEAN
+EFIAPI
+TmFifoRxDrain (
+  IN OUT TMFIFO_DRIVER *LanDriver
+  )
+{
+  UINT32 Avail, Words;
+
+  // Drain the words the FIFO reports in one pass. A packet which is only
+  // partially available is resumed on the next poll.
+  Avail = TmFifoRxAvail ();
+  while (Avail > 0) {
+    // Read packet header
+    if (LanDriver->RxHdr.Len == 0) {
+      LanDriver->RxHdr.Data = TmFifoRead64 (RSH_TM_HOST_TO_TILE_DATA);
+      Avail--;
+      if (LanDriver->RxHdr.Len == 0)
+        continue;
+
+      if (ntohs (LanDriver->RxHdr.Len) >= sizeof (LanDriver->RxPkt)) {
+        DEBUG ((EFI_D_ERROR, "Error: RxHdr.Len = %d too big\n",
+          ntohs (LanDriver->RxHdr.Len)));
+        LanDriver->RxHdr.Data = 0;
+        continue;
+      }
+
+      TmFifoRxSelectBuffer (LanDriver);
     }
 
-    Data = TmFifoRead64 (RSH_TM_HOST_TO_TILE_DATA);
-    Avail--;
-    CopyMem (&LanDriver->RxPkt[LanDriver->RxSize], &Data, sizeof (UINT64));
-    LanDriver->RxSize += sizeof (UINT64);
-  }
+    Words = (ntohs (LanDriver->RxHdr.Len) - LanDriver->RxSize +
+             sizeof (UINT64) - 1) / sizeof (UINT64);
+    if (Words > Avail)
+      Words = Avail;
+
+    TmFifoReadBurst (&LanDriver->RxBuf[LanDriver->RxSize / sizeof (UINT64)],
+                     Words);
+    Avail -= Words;
+    LanDriver->RxSize += Words * sizeof (UINT64);
+
+    if (LanDriver->RxSize >= ntohs (LanDriver->RxHdr.Len)) {
+      TmFifoRxComplete (LanDriver);
 
-  // Packet handling
-  switch (LanDriver->RxHdr.Type) {
-  case VIRTIO_ID_NET:
-    // Drop the network packet if interface is not up.
-    if (LanDriver->SnpMode.State != EfiSimpleNetworkInitialized) {
+      // Ready for next packet
       LanDriver->RxSize = 0;
       LanDriver->RxHdr.Len = 0;
     }
-    break;
-
-  case VIRTIO_ID_CONSOLE:
-    Len = ntohs (LanDriver->RxHdr.Len);
-
-    // Save the console input if there is enough space, or else drop it
-    if (TmFifoConsAvailSpace(LanDriver) > Len) {
-      if (LanDriver->ConsTail + Len <= TMFIFO_CONS_RING_SIZE) {
-        CopyMem (&LanDriver->ConsRing[LanDriver->ConsTail], LanDriver->RxPkt,
-                 Len);
-        LanDriver->ConsTail += Len;
-        if (LanDriver->ConsTail >= TMFIFO_CONS_RING_SIZE) {
-          LanDriver->ConsTail -= TMFIFO_CONS_RING_SIZE;
-        }
-      } else {
-        CopyMem (&LanDriver->ConsRing[LanDriver->ConsTail], LanDriver->RxPkt,
-                 TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail);
-        CopyMem (&LanDriver->ConsRing[0],
-                 &LanDriver->RxPkt[TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail],
-                 Len - (TMFIFO_CONS_RING_SIZE - LanDriver->ConsTail));
-        LanDriver->ConsTail = Len - (TMFIFO_CONS_RING_SIZE -
-                                     LanDriver->ConsTail);
-      }
-    }
-    // continue the default logic
-
-  default:
-    // Drop
-    LanDriver->RxSize = 0;
-    LanDriver->RxHdr.Len = 0;
-    return FALSE;
   }
 
-  return TRUE;
+  return (LanDriver->RxProd != LanDriver->RxCons) ? TRUE : FALSE;
 }
 
 UINT32
@@ -210,17 +266,27 @@ TmFifoRxAvail (
   return TMFIFO_GET_FIELD(Sts, TMFIFO_RX_STS_COUNT);
 }
 
+UINT32
+EFIAPI
+TmFifoTxPending (
+  VOID
+  )
+{
+  UINT64 Sts;
+
+  Sts = TmFifoRead64 (RSH_TM_TILE_TO_HOST_STS);
+  return TMFIFO_GET_FIELD(Sts, TMFIFO_TX_STS_COUNT);
+}
+
 UINT32
 EFIAPI
 TmFifoTxAvail (
   IN UINT32 Reserve
   )
 {
-  UINT64 Sts;
   UINT32 Used, TxFifoSize = TmFifoTxSize();
 
-  Sts = TmFifoRead64 (RSH_TM_TILE_TO_HOST_STS);
-  Used = TMFIFO_GET_FIELD(Sts, TMFIFO_TX_STS_COUNT);
+  Used = TmFifoTxPending ();
 
   return (TxFifoSize > Reserve + Used) ?
     (TxFifoSize - Reserve - Used) : 0;
@@ -278,26 +344,67 @@ TmFifoWrite64(
   return MmioWrite64 (PcdGet64 (PcdRshimBase) + Address, Value);
 }
 
-UINT64
+VOID
 EFIAPI
-TmFifoConsWrite(
-  IN UINT8     *Buffer,
-  IN UINTN     BuffSize
+TmFifoWriteBurst (
+  IN CONST VOID *Buffer,
+  IN UINTN      Count
   )
 {
-  UINT64         Value;
-  TMFIFO_MSG_HDR Hdr;
-  UINTN          BuffSizeLeft = BuffSize, ConsTxSize = 0;
-  TMFIFO_DRIVER *LanDriver;
-  MLNX_EFI_INFO *Info = (MLNX_EFI_INFO *)MLNX_EFI_INFO_ADDR;
+  UINTN         Address;
+  CONST UINT64  *Words;
+  CONST UINT8   *Bytes;
 
-  if (!Info->TmFifoInit) {
-    Info->TmFifoInit = 1;
-    TmFifoInit();
+  Address = PcdGet64 (PcdRshimBase) + RSH_TM_TILE_TO_HOST_DATA;
+
+  // Fast path for the aligned buffer, which is the common case for the
+  // network payload after the Ethernet header.
+  if (((UINTN)Buffer & (sizeof (UINT64) - 1)) == 0) {
+    for (Words = Buffer; Count > 0; Count--) {
+      MmioWrite64 (Address, *Words++);
+    }
+    return;
+  }
+
+  for (Bytes = Buffer; Count > 0; Count--) {
+    MmioWrite64 (Address, ReadUnaligned64 ((CONST UINT64 *)Bytes));
+    Bytes += sizeof (UINT64);
   }
+}
+
+VOID
+EFIAPI
+TmFifoReadBurst (
+  OUT UINT64    *Buffer,
+  IN  UINTN     Count
+  )
+{
+  UINTN         Address;
+
+  Address = PcdGet64 (PcdRshimBase) + RSH_TM_HOST_TO_TILE_DATA;
+  while (Count > 0) {
+    *Buffer++ = MmioRead64 (Address);
+    Count--;
+  }
+}
+
+/*
+ * Write console data to the Tx FIFO. The caller keeps the network interface
+ * off the FIFO meanwhile.
+ */
+STATIC
+UINT64
+TmFifoConsWriteLocked (
+  IN TMFIFO_DRIVER *LanDriver,
+  IN UINT8         *Buffer,
+  IN UINTN         BuffSize
+  )
+{
+  UINT64         Value;
+  TMFIFO_MSG_HDR Hdr;
+  UINTN          BuffSizeLeft = BuffSize, ConsTxSize = 0, Words;
 
   // Fill in the temporary Tx Word first
-  LanDriver = (TMFIFO_DRIVER *)Info->TmFifo;
   if (LanDriver != NULL) {
     if (LanDriver->ConsTxSize + BuffSizeLeft <= sizeof (UINT64)) {
       CopyMem ((UINT8*)&LanDriver->ConsTxWord + LanDriver->ConsTxSize,
@@ -337,12 +444,10 @@ TmFifoConsWrite(
   }
 
   // Write the 8-byte blocks
-  while (BuffSizeLeft >= sizeof (UINT64)) {
-    CopyMem ((UINT8*)&Value, Buffer, sizeof (UINT64));
-    TmFifoWrite64 (RSH_TM_TILE_TO_HOST_DATA, Value);
-    BuffSizeLeft -= sizeof (UINT64);
-    Buffer += sizeof (UINT64);
-  }
+  Words = BuffSizeLeft / sizeof (UINT64);
+  TmFifoWriteBurst (Buffer, Words);
+  BuffSizeLeft -= Words * sizeof (UINT64);
+  Buffer += Words * sizeof (UINT64);
 
   // Write the leftover data and padded it to 8 bytes.
   if (BuffSizeLeft > 0) {
@@ -354,6 +459,40 @@ TmFifoConsWrite(
   return BuffSize;
 }
 
+UINT64
+EFIAPI
+TmFifoConsWrite(
+  IN UINT8     *Buffer,
+  IN UINTN     BuffSize
+  )
+{
+  TMFIFO_DRIVER *LanDriver;
+  MLNX_EFI_INFO *Info = (MLNX_EFI_INFO *)MLNX_EFI_INFO_ADDR;
+
+  if (!Info->TmFifoInit) {
+    Info->TmFifoInit = 1;
+    TmFifoInit();
+  }
+
+  // Back off if this interrupted the network interface writing the Tx FIFO,
+  // as when it finds the FIFO full. Otherwise keep it off the FIFO until done.
+  LanDriver = (TMFIFO_DRIVER *)Info->TmFifo;
+  if (LanDriver != NULL) {
+    if (LanDriver->TxBusy) {
+      return 0;
+    }
+    LanDriver->TxBusy = TRUE;
+  }
+
+  BuffSize = TmFifoConsWriteLocked (LanDriver, Buffer, BuffSize);
+
+  if (LanDriver != NULL) {
+    LanDriver->TxBusy = FALSE;
+  }
+
+  return BuffSize;
+}
+
 UINT64
 EFIAPI
 TmFifoConsRead(
@@ -38,11 +38,12 @@ TmFifoInit (
   );
 
 /*
- *  Poll the TmFifo and receive a packet into the packet buffer.
+ *  Poll the TmFifo: flush the pending console Tx word and drain the
+ *  available words into the receive ring.
  *
  *  @param LanDriver    The TmFifo driver.
  *
- *  @return TRUE if a complete packet is ready, otherwise FALSE.
+ *  @return TRUE if the receive ring holds a complete packet, otherwise FALSE.
  */
 BOOLEAN
 EFIAPI
@@ -50,6 +51,20 @@ TmFifoPoll (
   IN OUT    TMFIFO_DRIVER *LanDriver
   );
 
+/*
+ *  Drain the available words into the receive ring without touching the
+ *  Tx FIFO.
+ *
+ *  @param LanDriver    The TmFifo driver.
+ *
+ *  @return TRUE if the receive ring holds a complete packet, otherwise FALSE.
+ */
+BOOLEAN
+EFIAPI
+TmFifoRxDrain (
+  IN OUT    TMFIFO_DRIVER *LanDriver
+  );
+
 /*
  * Get Rx available words.
  *
@@ -76,6 +91,18 @@ TmFifoTxAvail (
   IN UINT32 Reserve
   );
 
+/*
+ *  Get Tx pending words.
+ *
+ *  @return the number of words written to the Tx FIFO and not yet drained
+ *          by the host.
+ */
+UINT32
+EFIAPI
+TmFifoTxPending (
+  VOID
+  );
+
 /*
  * Get Rx FIFO size.
  *
@@ -138,6 +165,35 @@ TmFifoWrite64 (
   IN UINT64 Value
   );
 
+/*
+ * Write a burst of 64-bit words to the Tx FIFO.
+ * The caller must have checked that the FIFO has room for Count words.
+ * Buffer doesn't need to be 8-byte aligned.
+ *
+ * @param Buffer       The source buffer.
+ * @param Count        The number of 64-bit words to write.
+ */
+VOID
+EFIAPI
+TmFifoWriteBurst (
+  IN CONST VOID *Buffer,
+  IN UINTN      Count
+  );
+
+/*
+ * Read a burst of 64-bit words from the Rx FIFO.
+ * The caller must have checked that the FIFO holds at least Count words.
+ *
+ * @param Buffer       The 8-byte aligned destination buffer.
+ * @param Count        The number of 64-bit words to read.
+ */
+VOID
+EFIAPI
+TmFifoReadBurst (
+  OUT UINT64    *Buffer,
+  IN  UINTN     Count
+  );
+
 /*
  * Send data buffer to TMFIFO console.
  *
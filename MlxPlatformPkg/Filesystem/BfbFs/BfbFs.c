@@ -27,6 +27,7 @@
 #include <Library/IoLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 
@@ -66,6 +67,260 @@ STATIC UINT64 mResidue;
 // How many bytes have we read or skipped from the current image?
 STATIC INTN mCurOffset;
 
+// The boot FIFO is drained into a staging ring ahead of the consumer, both
+// from a periodic timer and whenever a read needs more data.  The ring size
+// is a power of two number of words; mRingHead and mRingTail are
+// free-running word indexes of the consumer and the producer.
+STATIC UINT64 *mRing;
+STATIC UINTN  mRingWords;
+STATIC UINTN  mRingHead;
+STATIC UINTN  mRingTail;
+STATIC EFI_EVENT mPrefetchEvent;
+
+// Images consumed from the stream can be kept in memory, so that they can
+// be reopened and seeked backwards.  The cache is indexed by image ID and
+// an image is only cached if it fits in what's left of the
+// PcdBfbFsCacheSize budget.  Data is valid up to mCurOffset for the image
+// at the head of the stream, and entirely once Complete is set.
+#define BFB_MAX_IMAGE_ID       256
+
+typedef struct {
+  UINT8   *Data;
+  UINT64  Len;
+  BOOLEAN Complete;
+} BFB_CACHE_ENTRY;
+
+STATIC BFB_CACHE_ENTRY mCache[BFB_MAX_IMAGE_ID];
+STATIC UINT64 mCacheUsed;
+
+// Prefetch period, in 100ns units.
+#define BFB_PREFETCH_PERIOD    10000
+
+// Per-image statistics: when we started reading it, and how long we spent
+// waiting for the boot FIFO to deliver data.
+STATIC UINT64 mImageStartTick;
+STATIC UINT64 mFifoIdleTicks;
+STATIC BOOLEAN mImageDone;
+
+// The CRC is computed over blocks of 4 lanes of BFB_CRC_LANE_WORDS words,
+// i.e. 16 cache lines, so that the 4 crc32x dependency chains can run in
+// parallel.  The lane CRCs are then combined: appending N bytes to a
+// message multiplies its CRC register by a constant GF(2) matrix, whose
+// columns for N = lane size are kept in mCrcShift.
+#define BFB_CRC_LANES          4
+#define BFB_CRC_LANE_WORDS     32
+STATIC UINT32 mCrcShift[32];
+
+STATIC inline
+UINT32
+BfbCrc32Word (
+  IN UINT32 Crc,
+  IN UINT64 Data
+  )
+{
+  // FIXME use a compiler instrinsic here, once we have one
+  __asm__ ("crc32x %w0, %w0, %x1" : "+r" (Crc) : "r" (Data));
+  return Crc;
+}
+
+/** Advance a CRC register over one lane's worth of zero bytes.
+ *
+ * @param Crc CRC register.
+ * @return The CRC register of the lane data followed by the lane size.
+ */
+STATIC
+UINT32
+BfbCrcShift (
+  IN UINT32 Crc
+  )
+{
+  UINT32 Result = 0;
+  UINTN  Bit;
+
+  for (Bit = 0; Crc != 0; Bit++, Crc >>= 1) {
+    if (Crc & 1) {
+      Result ^= mCrcShift[Bit];
+    }
+  }
+
+  return Result;
+}
+
+STATIC
+VOID
+BfbCrcInit (
+  VOID
+  )
+{
+  UINT32 Crc;
+  UINTN  Bit, Index;
+
+  for (Bit = 0; Bit < 32; Bit++) {
+    Crc = 1U << Bit;
+    for (Index = 0; Index < BFB_CRC_LANE_WORDS; Index++) {
+      Crc = BfbCrc32Word (Crc, 0);
+    }
+    mCrcShift[Bit] = Crc;
+  }
+}
+
+/** Update a CRC register over a buffer of words.
+ *
+ * @param Crc CRC register.
+ * @param Data Words to add to the CRC.
+ * @param Words Number of words.
+ * @return The updated CRC register.
+ */
+STATIC
+UINT32
+BfbCrc (
+  IN UINT32       Crc,
+  IN CONST UINT64 *Data,
+  IN UINTN        Words
+  )
+{
+  UINT32 Crc0, Crc1, Crc2, Crc3;
+  UINTN  Index;
+
+  while (Words >= BFB_CRC_LANES * BFB_CRC_LANE_WORDS) {
+    Crc0 = Crc;
+    Crc1 = 0;
+    Crc2 = 0;
+    Crc3 = 0;
+    for (Index = 0; Index < BFB_CRC_LANE_WORDS; Index++) {
+      Crc0 = BfbCrc32Word (Crc0, Data[Index]);
+      Crc1 = BfbCrc32Word (Crc1, Data[Index + BFB_CRC_LANE_WORDS]);
+      Crc2 = BfbCrc32Word (Crc2, Data[Index + 2 * BFB_CRC_LANE_WORDS]);
+      Crc3 = BfbCrc32Word (Crc3, Data[Index + 3 * BFB_CRC_LANE_WORDS]);
+    }
+    Crc = BfbCrcShift (BfbCrcShift (BfbCrcShift (Crc0) ^ Crc1) ^ Crc2) ^ Crc3;
+
+    Data += BFB_CRC_LANES * BFB_CRC_LANE_WORDS;
+    Words -= BFB_CRC_LANES * BFB_CRC_LANE_WORDS;
+  }
+
+  while (Words-- > 0) {
+    Crc = BfbCrc32Word (Crc, *Data++);
+  }
+
+  return Crc;
+}
+
+/** Move whatever the boot FIFO holds into the staging ring, as long as
+ *  there is room for it.
+ */
+STATIC
+VOID
+BfbPrefetch (
+  VOID
+  )
+{
+  UINT64 Count;
+  UINTN  Free;
+
+  Free = mRingWords - (mRingTail - mRingHead);
+  if (Free == 0) {
+    return;
+  }
+
+  Count = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_COUNT);
+  if (Count > Free) {
+    Count = Free;
+  }
+
+  for (; Count > 0; Count--) {
+    mRing[mRingTail & (mRingWords - 1)] =
+      MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
+    mRingTail++;
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+BfbPrefetchNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  if (!mFatalError) {
+    BfbPrefetch ();
+  }
+}
+
+/** Wait until the staging ring holds some data.
+ *
+ * @param Words Minimum number of words to wait for.
+ * @return The number of words available in the ring.
+ */
+STATIC
+UINTN
+BfbWaitWords (
+  IN UINTN Words
+  )
+{
+  UINT64 IdleStart;
+
+  ASSERT (Words <= mRingWords);
+
+  if (mRingTail - mRingHead >= Words) {
+    return mRingTail - mRingHead;
+  }
+
+  BfbPrefetch ();
+  if (mRingTail - mRingHead < Words) {
+    IdleStart = GetPerformanceCounter ();
+    do {
+      BfbPrefetch ();
+    } while (mRingTail - mRingHead < Words);
+    mFifoIdleTicks += GetPerformanceCounter () - IdleStart;
+  }
+
+  return mRingTail - mRingHead;
+}
+
+/** Take the next word from the staging ring, waiting for it if needed.
+ *
+ * @return The word read.
+ */
+STATIC
+UINT64
+BfbPopWord (
+  VOID
+  )
+{
+  UINT64 Data;
+
+  BfbWaitWords (1);
+  Data = mRing[mRingHead & (mRingWords - 1)];
+  mRingHead++;
+
+  return Data;
+}
+
+/** Log the time it took to stream the image which was just consumed.
+ */
+STATIC
+VOID
+BfbReportImageStats (
+  VOID
+  )
+{
+  UINT64 ElapsedNs;
+  UINT64 IdleNs;
+
+  ElapsedNs = GetTimeInNanoSecond (GetPerformanceCounter () - mImageStartTick);
+  IdleNs = GetTimeInNanoSecond (mFifoIdleTicks);
+
+  DEBUG ((EFI_D_INFO,
+    "BlueField boot: image %d: %d bytes in %Ld us (%Ld KB/s), FIFO idle %Ld us\n",
+    mHeader.data.image_id, mHeader.data.image_len,
+    DivU64x32 (ElapsedNs, 1000),
+    (ElapsedNs == 0) ? 0 :
+      DivU64x64Remainder (MultU64x32 (mHeader.data.image_len, 1000000),
+                          ElapsedNs, NULL),
+    DivU64x32 (IdleNs, 1000)));
+}
 
 /** Read bytes from the current image into a buffer, or throw them away if
  *  the buffer is NULL.  We also keep track of the CRC of the data seen so
@@ -87,7 +342,23 @@ BfbRead (
     return 1;
   }
 
+  BFB_CACHE_ENTRY *Cache = &mCache[FileId];
+  UINT8 *CacheDst = NULL;
+  UINTN CacheSize = 0;
+
+  // Keep a copy of the data if the image is being cached.  Skipped data is
+  // read straight into the cache.
+  if (Cache->Data != NULL && !Cache->Complete &&
+      mCurOffset < mHeader.data.image_len) {
+    CacheDst = Cache->Data + mCurOffset;
+    CacheSize = MIN (BufferSize, mHeader.data.image_len - mCurOffset);
+    if (Buffer == NULL && CacheSize == BufferSize) {
+      Buffer = CacheDst;
+    }
+  }
+
   UINT8 *Buffer8 = (UINT8 *)Buffer;
+  EFI_TPL OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
 
   mCurOffset += BufferSize;
 
@@ -100,39 +371,29 @@ BfbRead (
     mResidue >>= 8;
   }
 
-  UINT64 *Buffer64 = (UINT64 *)Buffer8;
-  UINT64 Count = 0;
-
-  for (; BufferSize >= 8; BufferSize -= 8) {
-    if (Count <= 0) {
-      while ((Count = MmioRead64 (PcdGet64 (PcdRshimBase) +
-                                  RSH_BOOT_FIFO_COUNT)) <= 0)
-        ;
-    }
+  // Consume whole words straight from the staging ring, as much as is
+  // contiguous in the ring at a time.
+  while (BufferSize >= 8) {
+    UINTN Words = BfbWaitWords (1);
+    UINTN Index = mRingHead & (mRingWords - 1);
 
-    UINT64 Data = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
+    Words = MIN (Words, BufferSize / 8);
+    Words = MIN (Words, mRingWords - Index);
 
-    // FIXME use a compiler instrinsic here, once we have one
-    __asm__ ("crc32x %w0, %w0, %x1" : "+r" (mPartialCrc) : "r" (Data));
-    if (Buffer64 != NULL) {
-      *Buffer64++ = Data;
+    mPartialCrc = BfbCrc (mPartialCrc, &mRing[Index], Words);
+    if (Buffer8 != NULL) {
+      CopyMem (Buffer8, &mRing[Index], Words * 8);
+      Buffer8 += Words * 8;
     }
-    Count--;
+
+    mRingHead += Words;
+    BufferSize -= Words * 8;
   }
 
   if (BufferSize > 0) {
-    Buffer8 = (UINT8 *)Buffer64;
-
-    if (Count <= 0) {
-      while ((Count = MmioRead64 (PcdGet64 (PcdRshimBase) +
-                                  RSH_BOOT_FIFO_COUNT)) <= 0)
-        ;
-    }
-
-    UINT64 Data = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
+    UINT64 Data = BfbPopWord ();
 
-    // FIXME use a compiler instrinsic here, once we have one
-    __asm__ ("crc32x %w0, %w0, %x1" : "+r" (mPartialCrc) : "r" (Data));
+    mPartialCrc = BfbCrc32Word (mPartialCrc, Data);
     INTN i;
     for (i = 0; i < BufferSize; i++) {
       if (Buffer8 != NULL) {
@@ -145,6 +406,12 @@ BfbRead (
     mResidueBytes = 8 - BufferSize;
   }
 
+  gBS->RestoreTPL (OldTpl);
+
+  if (CacheDst != NULL && CacheDst != Buffer && Buffer != NULL) {
+    CopyMem (CacheDst, Buffer, CacheSize);
+  }
+
   // If we've consumed the entire image, then the CRC should match
   // what was in the header.
 
@@ -153,9 +420,22 @@ BfbRead (
     DEBUG ((EFI_D_ERROR,
       "BlueField boot: image %d bad CRC: expected 0x%x actual 0x%x\n",
       mHeader.data.image_id, mHeader.data.image_crc, ~mPartialCrc));
+    if (Cache->Data != NULL && !Cache->Complete) {
+      FreePool (Cache->Data);
+      mCacheUsed -= Cache->Len;
+      Cache->Data = NULL;
+    }
     return 1;
   }
 
+  if (mCurOffset >= mHeader.data.image_len && !mImageDone) {
+    mImageDone = TRUE;
+    if (Cache->Data != NULL) {
+      Cache->Complete = TRUE;
+    }
+    BfbReportImageStats ();
+  }
+
   return 0;
 }
 
@@ -170,6 +450,8 @@ BfbGetNextHeader (
   VOID
   )
 {
+  EFI_TPL OldTpl;
+
   if (mFatalError) {
     return 1;
   }
@@ -178,17 +460,21 @@ BfbGetNextHeader (
     BfbRead (mHeader.data.image_id, NULL, mHeader.data.image_len - mCurOffset);
   }
 
-  while (MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_COUNT) < 3)
-    ;
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
 
-  mHeader.words[0] = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
-  mHeader.words[1] = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
-  mHeader.words[2] = MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
+  mFifoIdleTicks = 0;
+  mImageStartTick = GetPerformanceCounter ();
+
+  BfbWaitWords (3);
+  mHeader.words[0] = BfbPopWord ();
+  mHeader.words[1] = BfbPopWord ();
+  mHeader.words[2] = BfbPopWord ();
 
   if (mHeader.data.magic != BFB_IMGHDR_MAGIC) {
     DEBUG ((EFI_D_ERROR, "BlueField boot: bad magic number 0x%x\n",
            mHeader.data.magic));
     mFatalError = 1;
+    gBS->RestoreTPL (OldTpl);
     return 1;
   }
 
@@ -196,6 +482,7 @@ BfbGetNextHeader (
     DEBUG ((EFI_D_ERROR, "BlueField boot: bad major version %d\n",
           mHeader.data.major));
     mFatalError = 1;
+    gBS->RestoreTPL (OldTpl);
     return 1;
   }
 
@@ -204,9 +491,11 @@ BfbGetNextHeader (
   {
     INTN i;
     for (i = 0; i < mHeader.data.hdr_len - 3; i++)
-      (void) MmioRead64 (PcdGet64 (PcdRshimBase) + RSH_BOOT_FIFO_DATA);
+      (void) BfbPopWord ();
   }
 
+  gBS->RestoreTPL (OldTpl);
+
   DEBUG ((EFI_D_INFO,
     "BlueField ImgHdr V%d.%d Len %d ID %d ImLen %d HdCRC 0x%x FolIm 0x%lx\n",
     mHeader.data.major, mHeader.data.minor, mHeader.data.hdr_len,
@@ -217,6 +506,19 @@ BfbGetNextHeader (
   mResidueBytes = 0;
   mCurOffset = 0;
   mHeaderValid = 1;
+  mImageDone = FALSE;
+
+  // Start caching the image if it fits in the budget.
+  BFB_CACHE_ENTRY *Cache = &mCache[mHeader.data.image_id];
+  if (Cache->Data == NULL && mHeader.data.image_len > 0 &&
+      mCacheUsed + mHeader.data.image_len <= PcdGet32 (PcdBfbFsCacheSize)) {
+    Cache->Data = AllocatePool (mHeader.data.image_len);
+    if (Cache->Data != NULL) {
+      Cache->Len = mHeader.data.image_len;
+      Cache->Complete = FALSE;
+      mCacheUsed += Cache->Len;
+    }
+  }
 
   return 0;
 }
@@ -287,6 +589,12 @@ BfbOpen (
     return EFI_NOT_FOUND;
   }
 
+  // Images already seen are served from the cache.
+  if (mCache[Id].Complete) {
+    *FileId = Id;
+    return EFI_SUCCESS;
+  }
+
   if (!mHeaderValid && BfbGetNextHeader ()) {
     return EFI_DEVICE_ERROR;
   }
@@ -307,8 +615,10 @@ BfbOpen (
   return EFI_SUCCESS;
 }
 
-/** Provide the length of the image at the head of the boot stream.
- * @param FileId File ID, which must match that of the current image.
+/** Provide the length of the image at the head of the boot stream, or of
+ *  a cached image.
+ * @param FileId File ID, which must match that of the current image unless
+ *               the image is cached.
  * @param FileLen Returned file length.
  * @return Nonzero on error, else 0.
  */
@@ -318,6 +628,11 @@ BfbGetLen (
   IN OUT UINT64 *FileLen
   )
 {
+  if (mCache[FileId].Complete) {
+    *FileLen = mCache[FileId].Len;
+    return 0;
+  }
+
   if (!mHeaderValid || mHeader.data.image_id != FileId) {
     return 1;
   }
@@ -326,6 +641,77 @@ BfbGetLen (
   return 0;
 }
 
+/** Tell whether data of an image before the stream position can still be
+ *  read, i.e. whether the image is being cached.
+ * @param FileId File ID.
+ * @return TRUE if the file can be read at any position.
+ */
+STATIC BOOLEAN
+BfbIsSeekable (
+  IN     UINTN  FileId
+  )
+{
+  return (mCache[FileId].Data != NULL) ? TRUE : FALSE;
+}
+
+/** Read bytes from an image at a given offset.  Data which has been
+ *  consumed already is copied from the cache, the rest comes from the
+ *  stream, skipping forward if needed.
+ *
+ * @param FileId Numeric ID of the file being read.
+ * @param Offset Offset in the file to read from.
+ * @param Buffer Destination for bytes read.
+ * @param BufferSize Number of bytes to read.
+ * @return Nonzero on error, else zero.
+ */
+STATIC INTN
+BfbReadAt (
+  IN     UINTN  FileId,
+  IN     UINT64 Offset,
+  IN OUT VOID   *Buffer,
+  IN     UINTN  BufferSize
+  )
+{
+  BFB_CACHE_ENTRY *Cache = &mCache[FileId];
+  UINT64          Cached;
+  UINTN           Size;
+
+  if (Cache->Data != NULL) {
+    if (Cache->Complete) {
+      Cached = Cache->Len;
+    } else if (mHeaderValid && mHeader.data.image_id == FileId) {
+      Cached = MIN (mCurOffset, Cache->Len);
+    } else {
+      Cached = 0;
+    }
+
+    if (Offset < Cached) {
+      Size = (UINTN)MIN (BufferSize, Cached - Offset);
+      CopyMem (Buffer, Cache->Data + Offset, Size);
+      Buffer = (UINT8 *)Buffer + Size;
+      BufferSize -= Size;
+      Offset += Size;
+    }
+  }
+
+  if (BufferSize == 0) {
+    return 0;
+  }
+
+  // The rest has to come from the stream, which only moves forward.
+  if (!mHeaderValid || mHeader.data.image_id != FileId ||
+      Offset < mCurOffset) {
+    return 1;
+  }
+
+  if (Offset > mCurOffset &&
+      BfbRead (FileId, NULL, Offset - mCurOffset)) {
+    return 1;
+  }
+
+  return BfbRead (FileId, Buffer, BufferSize);
+}
+
 #define DEFAULT_BFB_FS_LABEL   L"BfbFs"
 
 STATIC CHAR16 *mBfbFsLabel;
@@ -648,7 +1034,7 @@ FileRead (
     *BufferSize = Fcb->Info.FileSize - Fcb->Position;
   }
 
-  if (BfbRead (Fcb->FileId, Buffer, *BufferSize)) {
+  if (BfbReadAt (Fcb->FileId, Fcb->Position, Buffer, *BufferSize)) {
     return EFI_DEVICE_ERROR;
   }
 
@@ -759,12 +1145,9 @@ FileSetPosition (
       Position = Fcb->Info.FileSize;
     }
 
-    // Can't seek backwards.
-    if (Position < Fcb->Position) {
-      return EFI_DEVICE_ERROR;
-    }
-
-    if (BfbRead (Fcb->FileId, NULL, Position - Fcb->Position)) {
+    // Can't seek backwards, unless the image is cached.  Seeking forward
+    // is deferred to the next read, which skips the stream as needed.
+    if (Position < Fcb->Position && !BfbIsSeekable (Fcb->FileId)) {
       return EFI_DEVICE_ERROR;
     }
   }
@@ -1020,6 +1403,35 @@ BfbFsEntryPoint (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  // Set up the staging ring the boot FIFO is prefetched into.
+  mRingWords = PcdGet32 (PcdBfbFsPrefetchBufferSize) / sizeof (UINT64);
+  ASSERT (mRingWords >= BFB_CRC_LANES * BFB_CRC_LANE_WORDS);
+  ASSERT ((mRingWords & (mRingWords - 1)) == 0);
+  mRing = AllocatePages (EFI_SIZE_TO_PAGES (mRingWords * sizeof (UINT64)));
+  if (mRing == NULL) {
+    FreePool (mBfbFsLabel);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BfbCrcInit ();
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  BfbPrefetchNotify,
+                  NULL,
+                  &mPrefetchEvent
+                  );
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->SetTimer (mPrefetchEvent, TimerPeriodic,
+                            BFB_PREFETCH_PERIOD);
+  }
+  if (EFI_ERROR (Status)) {
+    FreePages (mRing, EFI_SIZE_TO_PAGES (mRingWords * sizeof (UINT64)));
+    FreePool (mBfbFsLabel);
+    return Status;
+  }
+
   Status = gBS->InstallMultipleProtocolInterfaces (
                   &gInstallHandle,
                   &gEfiSimpleFileSystemProtocolGuid, &gBfbFs,
@@ -1028,6 +1440,8 @@ BfbFsEntryPoint (
                   );
 
   if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (mPrefetchEvent);
+    FreePages (mRing, EFI_SIZE_TO_PAGES (mRingWords * sizeof (UINT64)));
     FreePool (mBfbFsLabel);
   }
 
@@ -18,6 +18,16 @@
 #ifndef _SMBUS_EEPROM_NV_STORE_H_
 #define _SMBUS_EEPROM_NV_STORE_H_
 
+///
+/// Bytes of an EEPROM page of the NV store changed in memory and not yet
+/// written, [Start, End) from the start of the page. End is 0 when the
+/// page is clean.
+///
+typedef struct {
+  UINT16  Start;
+  UINT16  End;
+} NV_STORE_DIRTY_SPAN;
+
 /**
   Copy the NV store from EEProm into memory.  The work in this
   function is done exactly once, after VariableCommonInitialize has
@@ -37,8 +47,11 @@ IsActiveNvStore ();
 /**
   Flush data to the active NV store in Smbus EEProm.
 
+  The data is only recorded as dirty, and written by CommitNvStore (),
+  unless write-back is disabled.
+
   @param  Offset         The offset to the NV store.
-  @param  Data           The data to write.
+  @param  Data           The data to write, in the memory copy of the store.
   @param  DataSize       The size of the data in bytes.
 
 **/
@@ -49,6 +62,14 @@ FlushToNvStore (
   IN  UINTN   DataSize
   );
 
+/**
+  Schedule the write of the data flushed so far to the NV store in Smbus
+  EEProm before EndOfDxe, or write it now.
+
+**/
+VOID
+CommitNvStore ();
+
 /**
   Commit the result of a reclaiming operation to the NV store in Smbus
   EEProm.  This requires: (1) write the new store data to inactive
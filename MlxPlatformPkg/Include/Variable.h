@@ -98,6 +98,35 @@ typedef struct {
   BOOLEAN         Volatile;
 } VARIABLE_POINTER_TRACK;
 
+///
+/// Number of hash buckets in the index of a variable store.
+///
+#define VARIABLE_INDEX_BUCKETS  256
+
+///
+/// One variable of a store in its index. Entries are linked through Next,
+/// which is the entry number plus one, 0 ending the chain.
+///
+typedef struct {
+  UINT32          Offset;
+  UINT32          Hash;
+  UINT32          Next;
+} VARIABLE_INDEX_ENTRY;
+
+///
+/// Hash index of the variables of a store by name and vendor GUID.
+/// Offsets are relative to the store header. Variables past IndexedEnd
+/// are added the next time the index is used.
+///
+typedef struct {
+  UINT32                Capacity;
+  UINT32                Count;
+  UINTN                 IndexedEnd;
+  BOOLEAN               Overflow;
+  UINT32                Bucket[VARIABLE_INDEX_BUCKETS];
+  VARIABLE_INDEX_ENTRY  Entry[1];
+} VARIABLE_INDEX;
+
 typedef struct {
   EFI_PHYSICAL_ADDRESS  VolatileVariableBase;
   EFI_PHYSICAL_ADDRESS  NonVolatileVariableBase;
@@ -117,6 +146,7 @@ typedef struct {
   CHAR8           *LangCodes;
   CHAR8           *PlatformLang;
   CHAR8           Lang[ISO_639_2_ENTRY_SIZE + 1];
+  VARIABLE_INDEX  *VariableIndex[VariableStoreTypeMax];
 } VARIABLE_MODULE_GLOBAL;
 
 ///
@@ -134,6 +164,8 @@ extern AUTH_VAR_LIB_CONTEXT_OUT mAuthContextOut;
 
 extern BLUEFIELD_EEPROM_PROTOCOL mI2cEeprom;
 
+extern NV_STORE_DIRTY_SPAN       *mNvStoreDirty;
+
 /**
 
   This code gets the current status of Variable Store.
@@ -446,6 +478,18 @@ FindVariable (
   IN  VARIABLE_GLOBAL         *Global
   );
 
+/**
+  Drop all entries of the index of a variable store, after the variables
+  of the store have been moved. It is rebuilt the next time it is used.
+
+  @param[in] Type               Type of the variable store.
+
+**/
+VOID
+ResetVariableIndex (
+  IN VARIABLE_STORE_TYPE    Type
+  );
+
 /**
   This function checks to see if the remaining variable space is enough to set
   all variables from the argument list successfully.
@@ -769,6 +769,269 @@ VariableStoreCheckAndRestore (
   return Status;
 }
 
+/**
+  Hash a variable name and vendor GUID for the variable index.
+
+  @param[in] VariableName       Name of the variable.
+  @param[in] NameSize           Size of the name in bytes, including the terminator.
+  @param[in] VendorGuid         Vendor GUID of the variable.
+
+  @return The FNV-1a hash of the name and GUID bytes.
+
+**/
+STATIC
+UINT32
+VariableIndexHash (
+  IN CONST VOID             *VariableName,
+  IN UINTN                  NameSize,
+  IN CONST EFI_GUID         *VendorGuid
+  )
+{
+  CONST UINT8               *Byte;
+  UINT32                    Hash;
+  UINTN                     Index;
+
+  Hash = 0x811c9dc5;
+  Byte = VariableName;
+  for (Index = 0; Index < NameSize; Index++) {
+    Hash = (Hash ^ Byte[Index]) * 0x01000193;
+  }
+  Byte = (CONST UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Byte[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Allocate the index of a variable store, sized for the largest number of
+  variables the store can hold. The store is left unindexed, and searched
+  linearly, if there is no memory for it.
+
+  @param[in] Type                 Type of the variable store.
+  @param[in] VariableStoreHeader  Pointer to the variable store header.
+
+**/
+STATIC
+VOID
+CreateVariableIndex (
+  IN VARIABLE_STORE_TYPE    Type,
+  IN VARIABLE_STORE_HEADER  *VariableStoreHeader
+  )
+{
+  VARIABLE_INDEX            *Index;
+  UINT32                    Capacity;
+
+  //
+  // The smallest variable is a header and a one character name.
+  //
+  Capacity = (UINT32) (VariableStoreHeader->Size /
+                       (sizeof (AUTH_VAR_HEADER) + HEADER_ALIGN (sizeof (CHAR16))));
+
+  Index = AllocateRuntimeZeroPool (OFFSET_OF (VARIABLE_INDEX, Entry) +
+                                   Capacity * sizeof (VARIABLE_INDEX_ENTRY));
+  if (Index == NULL) {
+    DEBUG ((EFI_D_WARN, "Variable: no memory to index store %d\n", Type));
+    return;
+  }
+
+  Index->Capacity = Capacity;
+  mVariableModuleGlobal->VariableIndex[Type] = Index;
+}
+
+/**
+  Drop all entries of the index of a variable store, after the variables
+  of the store have been moved. It is rebuilt the next time it is used.
+
+  @param[in] Type               Type of the variable store.
+
+**/
+VOID
+ResetVariableIndex (
+  IN VARIABLE_STORE_TYPE    Type
+  )
+{
+  VARIABLE_INDEX            *Index;
+
+  Index = mVariableModuleGlobal->VariableIndex[Type];
+  if (Index == NULL) {
+    return;
+  }
+
+  Index->Count      = 0;
+  Index->IndexedEnd = 0;
+  Index->Overflow   = FALSE;
+  ZeroMem (Index->Bucket, sizeof (Index->Bucket));
+}
+
+/**
+  Add the variables appended to a store since the last update to its index.
+
+  Variables are only ever appended to a store, or have their state changed
+  in place, until the store is reclaimed. All headers are indexed whatever
+  their state, which is checked at lookup.
+
+  @param[in] Type                 Type of the variable store.
+  @param[in] VariableStoreHeader  Pointer to the variable store header.
+
+**/
+STATIC
+VOID
+UpdateVariableIndex (
+  IN VARIABLE_STORE_TYPE    Type,
+  IN VARIABLE_STORE_HEADER  *VariableStoreHeader
+  )
+{
+  VARIABLE_INDEX            *Index;
+  VARIABLE_INDEX_ENTRY      *Entry;
+  AUTH_VAR_HEADER           *Variable;
+  UINT32                    Bucket;
+
+  Index = mVariableModuleGlobal->VariableIndex[Type];
+  if (Index == NULL || Index->Overflow) {
+    return;
+  }
+
+  if (Index->IndexedEnd == 0) {
+    Variable = GetStartPointer (VariableStoreHeader);
+  } else {
+    Variable = (AUTH_VAR_HEADER *) ((UINTN) VariableStoreHeader + Index->IndexedEnd);
+  }
+
+  while (IsValidVariableHeader (Variable, GetEndPointer (VariableStoreHeader))) {
+    if (Index->Count == Index->Capacity) {
+      Index->Overflow = TRUE;
+      return;
+    }
+
+    Entry = &Index->Entry[Index->Count];
+    Entry->Offset = (UINT32) ((UINTN) Variable - (UINTN) VariableStoreHeader);
+    Entry->Hash   = VariableIndexHash (GetVariableNamePtr (Variable),
+                                       Variable->NameSize,
+                                       &Variable->VendorGuid);
+
+    //
+    // Entries go at the head of their chain, so chains are in reverse store order.
+    //
+    Bucket = Entry->Hash % VARIABLE_INDEX_BUCKETS;
+    Entry->Next = Index->Bucket[Bucket];
+    Index->Count++;
+    Index->Bucket[Bucket] = Index->Count;
+
+    Variable = GetNextPotentialVariablePtr (Variable);
+  }
+
+  Index->IndexedEnd = (UINTN) Variable - (UINTN) VariableStoreHeader;
+}
+
+/**
+  Find a variable in a store through the index of the store.
+
+  The result is the same as FindVariableEx () on the store: the first live
+  ADDED variable in store order, along with the last IN_DELETED_TRANSITION
+  one before it, or else the last IN_DELETED_TRANSITION variable.
+
+  @param[in]       Type                Type of the variable store.
+  @param[in]       VariableStoreHeader Pointer to the variable store header.
+  @param[in]       VariableName        Name of the variable to be found, not empty.
+  @param[in]       VendorGuid          Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck       Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                       check at runtime when searching variable.
+  @param[in, out]  PtrTrack            Variable Track Pointer structure that contains Variable Information.
+
+  @retval          EFI_SUCCESS         Variable found successfully
+  @retval          EFI_NOT_FOUND       Variable not found
+  @retval          EFI_UNSUPPORTED     The store is not indexed, search it with FindVariableEx ().
+**/
+STATIC
+EFI_STATUS
+FindVariableByIndex (
+  IN     VARIABLE_STORE_TYPE     Type,
+  IN     VARIABLE_STORE_HEADER   *VariableStoreHeader,
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack
+  )
+{
+  VARIABLE_INDEX        *Index;
+  VARIABLE_INDEX_ENTRY  *Entry;
+  AUTH_VAR_HEADER       *Variable;
+  AUTH_VAR_HEADER       *AddedVariable;
+  AUTH_VAR_HEADER       *InDeletedVariable;
+  UINTN                  NameSize;
+  UINT32                 Hash;
+  UINT32                 Next;
+
+  Index = mVariableModuleGlobal->VariableIndex[Type];
+  if (Index == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  UpdateVariableIndex (Type, VariableStoreHeader);
+  if (Index->Overflow) {
+    return EFI_UNSUPPORTED;
+  }
+
+  NameSize = StrSize (VariableName);
+  Hash     = VariableIndexHash (VariableName, NameSize, VendorGuid);
+
+  AddedVariable     = NULL;
+  InDeletedVariable = NULL;
+
+  for (Next = Index->Bucket[Hash % VARIABLE_INDEX_BUCKETS]; Next != 0; Next = Entry->Next) {
+    Entry = &Index->Entry[Next - 1];
+    if (Entry->Hash != Hash) {
+      continue;
+    }
+
+    Variable = (AUTH_VAR_HEADER *) ((UINTN) VariableStoreHeader + Entry->Offset);
+    if (!IsValidVariableHeader (Variable, PtrTrack->EndPtr)) {
+      //
+      // The store has been rewritten behind the index, rebuild it next time.
+      //
+      ResetVariableIndex (Type);
+      return EFI_UNSUPPORTED;
+    }
+
+    if (!VariableIsLive (Variable)) {
+      continue;
+    }
+    if (!IgnoreRtCheck && EfiAtRuntime () &&
+        ((Variable->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+      continue;
+    }
+    if (Variable->NameSize != NameSize ||
+        !CompareGuid (VendorGuid, &Variable->VendorGuid) ||
+        CompareMem (VariableName, GetVariableNamePtr (Variable), NameSize) != 0) {
+      continue;
+    }
+
+    //
+    // Going backwards through the store, the last ADDED variable seen is the
+    // first in store order, and the IN_DELETED_TRANSITION one that goes with
+    // it is the first seen after it.
+    //
+    if (Variable->State == VAR_ADDED) {
+      AddedVariable     = Variable;
+      InDeletedVariable = NULL;
+    } else if (InDeletedVariable == NULL) {
+      InDeletedVariable = Variable;
+    }
+  }
+
+  if (AddedVariable != NULL) {
+    PtrTrack->CurrPtr                = AddedVariable;
+    PtrTrack->InDeletedTransitionPtr = InDeletedVariable;
+    return EFI_SUCCESS;
+  }
+
+  PtrTrack->CurrPtr                = InDeletedVariable;
+  PtrTrack->InDeletedTransitionPtr = NULL;
+  return (PtrTrack->CurrPtr == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
 /**
 
   Variable store garbage collection and reclaim operation.
@@ -937,6 +1200,7 @@ Reclaim (
   SetMem (VariableStoreHeader, VariableStoreHeader->Size, 0xff);
   CopyMem (VariableStoreHeader, Store, CurrPtr - Store);
   *LastVariableOffset = CurrPtr - Store;
+  ResetVariableIndex (IsVolatile ? VariableStoreTypeVolatile : VariableStoreTypeNv);
   if (!IsVolatile) {
     mVariableModuleGlobal->HwErrVariableTotalSize = HwErrVariableTotalSize;
     mVariableModuleGlobal->CommonVariableTotalSize = CommonVariableTotalSize;
@@ -2022,6 +2286,14 @@ UpdateVariable (
 
   UpdateVariableInfo (VariableName, VendorGuid, Variable->Volatile, FALSE, TRUE, FALSE, FALSE);
 
+  if ((Attributes & EFI_VARIABLE_NON_VOLATILE) != 0) {
+    UpdateVariableIndex (VariableStoreTypeNv,
+                         (VARIABLE_STORE_HEADER *) Global->NonVolatileVariableBase);
+  } else {
+    UpdateVariableIndex (VariableStoreTypeVolatile,
+                         (VARIABLE_STORE_HEADER *) Global->VolatileVariableBase);
+  }
+
   Status = EFI_SUCCESS;
 
 Done:
@@ -2043,6 +2315,10 @@ Done:
                            KeyIndex, MonotonicCount, Variable, TimeStamp, TRUE);
   }
 
+  if (IsActiveNvStore ()) {
+    CommitNvStore ();
+  }
+
   return Status;
 
 #undef NVFLUSH
@@ -2148,7 +2424,14 @@ FindVariable (
     PtrTrack->EndPtr    = GetEndPointer   (Header[Index]);
     PtrTrack->Volatile  = (Index == VariableStoreTypeVolatile);
 
-    Status = FindVariableEx (VariableName, VendorGuid, FALSE, PtrTrack);
+    Status = EFI_UNSUPPORTED;
+    if (VariableName[0] != 0) {
+      Status = FindVariableByIndex ((VARIABLE_STORE_TYPE) Index, Header[Index],
+                                    VariableName, VendorGuid, FALSE, PtrTrack);
+    }
+    if (Status == EFI_UNSUPPORTED) {
+      Status = FindVariableEx (VariableName, VendorGuid, FALSE, PtrTrack);
+    }
     if (!EFI_ERROR (Status)) {
       return Status;
     }
@@ -3088,6 +3371,9 @@ InitializeVariableStore (
   VariableStore->Reserved   = 0;
   VariableStore->Reserved1  = 0;
 
+  CreateVariableIndex (VolatileStore ? VariableStoreTypeVolatile : VariableStoreTypeNv,
+                       VariableStore);
+
   if (!VolatileStore) {
     //
     // Get HOB variable store.
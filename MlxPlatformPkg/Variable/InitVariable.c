@@ -199,11 +199,15 @@ VariableClassAddressChangeEvent (
     0x0,
     (VOID **) &mVariableModuleGlobal->VariableGlobal.VolatileVariableBase
     );
+  for (Index = 0; Index < VariableStoreTypeMax; Index++) {
+    EfiConvertPointer (0x0, (VOID **) &mVariableModuleGlobal->VariableIndex[Index]);
+  }
   EfiConvertPointer (0x0, (VOID **) &mVariableModuleGlobal);
 
   // Convert I2cEeprom interface and its transfer protocol.
   EfiConvertPointer (0x0, (VOID **) &mI2cEeprom.Transfer);
   EfiConvertPointer (0x0, (VOID **) &mI2cEeprom);
+  EfiConvertPointer (0x0, (VOID **) &mNvStoreDirty);
 
   if (mAuthContextOut.AddressPointer != NULL) {
     for (Index = 0; Index < mAuthContextOut.AddressPointerCount; Index++) {
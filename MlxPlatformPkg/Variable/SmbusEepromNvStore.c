@@ -16,6 +16,8 @@
 
 #include "Variable.h"
 
+#include <Guid/EventGroup.h>
+
 #define MLNX_VARIABLE_STORE_PREFIX      "NV Store"
 
 ///
@@ -34,6 +36,28 @@ STATIC UINT32 mNvStoreAddr;
 ///
 BLUEFIELD_EEPROM_PROTOCOL   mI2cEeprom;
 
+///
+/// Dirty bytes of each EEPROM page of the NV store, NULL when every change
+/// is written through by FlushToNvStore ().
+///
+NV_STORE_DIRTY_SPAN         *mNvStoreDirty;
+
+STATIC UINT32               mNvStorePageSize;
+STATIC UINT32               mNvStorePageCount;
+STATIC BOOLEAN              mNvStorePending;
+
+///
+/// End of the variables in the EEPROM, and of those in memory. The
+/// variables in between have been appended since the last write.
+///
+STATIC UINT32               mNvStoreFlushedEnd;
+STATIC UINT32               mNvStoreAppendEnd;
+
+///
+/// Write of the NV store a delay after the last update, until EndOfDxe.
+///
+STATIC EFI_EVENT            mNvStoreFlushEvent;
+
 STATIC
 EFI_STATUS
 LocateBluefieldI2cEepromProtocol ()
@@ -57,6 +81,205 @@ LocateBluefieldI2cEepromProtocol ()
   return EFI_SUCCESS;
 }
 
+/**
+  Write the dirty bytes of a page of the NV store to EEProm.
+
+  @param  Store          The NV store in memory.
+  @param  Page           The page to write.
+
+**/
+STATIC
+EFI_STATUS
+FlushNvStorePage (
+  IN  UINT8   *Store,
+  IN  UINT32   Page
+  )
+{
+  EFI_STATUS            Status;
+  NV_STORE_DIRTY_SPAN   *Span;
+  UINT32                Offset;
+
+  Span = &mNvStoreDirty[Page];
+  if (Span->End == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Offset = Page * mNvStorePageSize + Span->Start;
+  Status = mI2cEeprom.Transfer (&mI2cEeprom, (mNvStoreAddr + Offset),
+                                Span->End - Span->Start, Store + Offset,
+                                EEPROM_WRITE);
+  if (!EFI_ERROR (Status)) {
+    Span->Start = 0;
+    Span->End   = 0;
+  }
+
+  return Status;
+}
+
+/**
+  Write the dirty bytes of the NV store to EEProm, one transfer per page.
+
+  The variables appended since the last write go first, from the last page
+  to the first, so the header of the first of them, which makes all of them
+  reachable, is written last. The state changes of the older variables
+  follow; until then an updated variable has two ADDED copies, and
+  VariableStoreCheckAndRestore () keeps the newer one.
+
+**/
+STATIC
+EFI_STATUS
+FlushNvStore ()
+{
+  EFI_STATUS  Status;
+  UINT8       *Store;
+  UINT32      First;
+  UINT32      Page;
+
+  if (!mNvStorePending) {
+    return EFI_SUCCESS;
+  }
+
+  Store = (UINT8 *) (UINTN)
+    mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase;
+
+  if (mNvStoreAppendEnd > mNvStoreFlushedEnd) {
+    First = mNvStoreFlushedEnd / mNvStorePageSize;
+    for (Page = (mNvStoreAppendEnd - 1) / mNvStorePageSize + 1;
+         Page > First; Page--) {
+      Status = FlushNvStorePage (Store, Page - 1);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+    mNvStoreFlushedEnd = mNvStoreAppendEnd;
+  }
+
+  for (Page = 0; Page < mNvStorePageCount; Page++) {
+    Status = FlushNvStorePage (Store, Page);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  mNvStorePending = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Write the NV store once updates have settled.
+
+  @param  Event          The timer event.
+  @param  Context        Not used.
+
+**/
+STATIC
+VOID
+EFIAPI
+NvStoreFlushNotify (
+  IN  EFI_EVENT  Event,
+  IN  VOID      *Context
+  )
+{
+  EFI_STATUS  Status;
+
+  AcquireLockOnlyAtBootTime (
+    &mVariableModuleGlobal->VariableGlobal.VariableServicesLock);
+  Status = FlushNvStore ();
+  ReleaseLockOnlyAtBootTime (
+    &mVariableModuleGlobal->VariableGlobal.VariableServicesLock);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "NvStoreFlushNotify: %r\n", Status));
+  }
+}
+
+/**
+  Write the NV store at EndOfDxe, and return to writing at the end of each
+  update. Platform code, the boot manager and the OS may reset the system
+  at any time from then on.
+
+  @param  Event          The EndOfDxe event.
+  @param  Context        Not used.
+
+**/
+STATIC
+VOID
+EFIAPI
+NvStoreEndOfDxeNotify (
+  IN  EFI_EVENT  Event,
+  IN  VOID      *Context
+  )
+{
+  EFI_STATUS  Status;
+
+  gBS->CloseEvent (Event);
+  gBS->CloseEvent (mNvStoreFlushEvent);
+  mNvStoreFlushEvent = NULL;
+
+  AcquireLockOnlyAtBootTime (
+    &mVariableModuleGlobal->VariableGlobal.VariableServicesLock);
+  Status = FlushNvStore ();
+  ReleaseLockOnlyAtBootTime (
+    &mVariableModuleGlobal->VariableGlobal.VariableServicesLock);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "NvStoreEndOfDxeNotify: %r\n", Status));
+  }
+}
+
+/**
+  Set up the write-back of the NV store, unless the platform does not
+  describe the EEPROM pages. Changes are otherwise written through.
+
+**/
+STATIC
+VOID
+InitNvStoreWriteBack ()
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   Event;
+
+  mNvStorePageSize = PcdGet32 (PcdEepromStorePageSize);
+  if (mNvStorePageSize == 0 || mNvStorePageSize > MAX_UINT16) {
+    return;
+  }
+
+  mNvStorePageCount = (PcdGet32 (PcdVariableStoreSize) + mNvStorePageSize - 1) /
+                      mNvStorePageSize;
+  mNvStoreDirty = AllocateRuntimeZeroPool (mNvStorePageCount *
+                                           sizeof (NV_STORE_DIRTY_SPAN));
+  if (mNvStoreDirty == NULL) {
+    return;
+  }
+
+  mNvStoreFlushedEnd = (UINT32) mVariableModuleGlobal->NonVolatileLastVariableOffset;
+  mNvStoreAppendEnd  = mNvStoreFlushedEnd;
+
+  //
+  // Without a delay, CommitNvStore () writes at the end of each update.
+  // Otherwise updates are batched while drivers are dispatched, until
+  // EndOfDxe.
+  //
+  if (PcdGet32 (PcdEepromNvStoreFlushDelay) == 0) {
+    return;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                             NvStoreFlushNotify, NULL, &mNvStoreFlushEvent);
+  if (EFI_ERROR (Status)) {
+    mNvStoreFlushEvent = NULL;
+    return;
+  }
+
+  Status = gBS->CreateEventEx (EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                               NvStoreEndOfDxeNotify, NULL,
+                               &gEfiEndOfDxeEventGroupGuid, &Event);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (mNvStoreFlushEvent);
+    mNvStoreFlushEvent = NULL;
+  }
+}
+
 /**
   Copy the NV store from EEProm into memory.  The work in this
   function is done exactly once, after VariableCommonInitialize has
@@ -151,6 +374,7 @@ InitNvStore ()
       InitializeLocationForLastVariableOffset (NvHeader,
                     &mVariableModuleGlobal->NonVolatileLastVariableOffset);
       CopyMem (NvStore, Store, StoreSize);
+      ResetVariableIndex (VariableStoreTypeNv);
     }
 
     if (EFI_ERROR (Status)) {
@@ -177,6 +401,8 @@ InitNvStore ()
 
   FreePool (Store);
 
+  InitNvStoreWriteBack ();
+
   PrintVariableStore (MLNX_VARIABLE_STORE_PREFIX, NvStore);
 
   return TRUE;
@@ -207,12 +433,78 @@ FlushToNvStore (
   IN  UINTN   DataSize
   )
 {
-  EFI_STATUS  Status;
+  EFI_STATUS            Status;
+  NV_STORE_DIRTY_SPAN   *Span;
+  UINT32                End;
+  UINT32                Page;
+  UINT32                PageStart;
+  UINT16                Start;
+  UINT16                Stop;
 
   ASSERT (Offset + DataSize <= PcdGet32 (PcdVariableStoreSize));
-  Status = mI2cEeprom.Transfer (&mI2cEeprom, (mNvStoreAddr + Offset),
-                                DataSize, (UINT8 *) Data, EEPROM_WRITE);
-  return Status;
+
+  if (mNvStoreDirty == NULL) {
+    Status = mI2cEeprom.Transfer (&mI2cEeprom, (mNvStoreAddr + Offset),
+                                  DataSize, (UINT8 *) Data, EEPROM_WRITE);
+    return Status;
+  }
+
+  //
+  // The bytes are written from the store in memory later on, merged with
+  // the other changes to the same page.
+  //
+  ASSERT (Data == (UINT8 *) (UINTN)
+    mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase + Offset);
+
+  End = Offset + (UINT32) DataSize;
+  for (Page = Offset / mNvStorePageSize;
+       Page * mNvStorePageSize < End; Page++) {
+    PageStart = Page * mNvStorePageSize;
+    Start     = (UINT16) (MAX (Offset, PageStart) - PageStart);
+    Stop      = (UINT16) (MIN (End, PageStart + mNvStorePageSize) - PageStart);
+
+    Span = &mNvStoreDirty[Page];
+    if (Span->End == 0) {
+      Span->Start = Start;
+      Span->End   = Stop;
+    } else {
+      Span->Start = MIN (Span->Start, Start);
+      Span->End   = MAX (Span->End, Stop);
+    }
+  }
+
+  if (End > mNvStoreAppendEnd) {
+    mNvStoreAppendEnd = End;
+  }
+  mNvStorePending = TRUE;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Schedule the write of the data flushed so far to the NV store in Smbus
+  EEProm before EndOfDxe, or write it now.
+
+**/
+VOID
+CommitNvStore ()
+{
+  EFI_STATUS  Status;
+
+  if (!mNvStorePending) {
+    return;
+  }
+
+  if (!EfiAtRuntime () && mNvStoreFlushEvent != NULL) {
+    gBS->SetTimer (mNvStoreFlushEvent, TimerRelative,
+                   PcdGet32 (PcdEepromNvStoreFlushDelay));
+    return;
+  }
+
+  Status = FlushNvStore ();
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "CommitNvStore: %r\n", Status));
+  }
 }
 
 /**
@@ -245,6 +537,18 @@ ReclaimNvStore (
   if (EFI_ERROR (Status))
     return Status;
 
+  //
+  // The new store is complete, further changes go there. Those pending
+  // for the old one are part of it.
+  //
+  mNvStoreAddr = NewStoreAddr;
+  if (mNvStoreDirty != NULL) {
+    ZeroMem (mNvStoreDirty, mNvStorePageCount * sizeof (NV_STORE_DIRTY_SPAN));
+    mNvStoreFlushedEnd = (UINT32) StoreSize;
+    mNvStoreAppendEnd  = mNvStoreFlushedEnd;
+    mNvStorePending    = FALSE;
+  }
+
   HeaderSize = sizeof (VARIABLE_STORE_HEADER);
   SetMem (&Header, HeaderSize, 0xff);
   Status = mI2cEeprom.Transfer (&mI2cEeprom, OldStoreAddr, HeaderSize,
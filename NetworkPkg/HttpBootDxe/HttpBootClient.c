@@ -226,6 +226,69 @@ HttpBootDiscoverBootInfo (
   return Status;
 }
 
+/**
+  Fill in the configuration of an HTTP child used for the file download.
+
+  @param[in]    Private        The pointer to the driver's private data.
+  @param[out]   ConfigData     The configuration data of the HTTP child.
+
+**/
+STATIC
+VOID
+HttpBootGetHttpIoConfig (
+  IN     HTTP_BOOT_PRIVATE_DATA       *Private,
+     OUT HTTP_IO_CONFIG_DATA          *ConfigData
+  )
+{
+  ZeroMem (ConfigData, sizeof (HTTP_IO_CONFIG_DATA));
+  if (!Private->UsingIpv6) {
+    ConfigData->Config4.HttpVersion = HttpVersion11;
+    ConfigData->Config4.RequestTimeOut = HTTP_BOOT_REQUEST_TIMEOUT;
+    IP4_COPY_ADDRESS (&ConfigData->Config4.LocalIp, &Private->StationIp.v4);
+    IP4_COPY_ADDRESS (&ConfigData->Config4.SubnetMask, &Private->SubnetMask.v4);
+  } else {
+    ASSERT (FALSE);
+  }
+}
+
+/**
+  Return the time elapsed since a value of the performance counter, for the
+  throughput reports of the downloads. Only called from PERF_CODE, since the
+  platform is not required to provide a real TimerLib otherwise.
+
+  @param[in]    StartTime      The value of the performance counter at the start.
+
+  @return The elapsed time in nanoseconds, or 0 if the platform does not report
+          the frequency of its performance counter.
+
+**/
+STATIC
+UINT64
+HttpBootElapsedTime (
+  IN     UINT64                       StartTime
+  )
+{
+  UINT64                              Counter;
+  UINT64                              StartValue;
+  UINT64                              EndValue;
+
+  Counter = GetPerformanceCounter ();
+  if (GetPerformanceCounterProperties (&StartValue, &EndValue) == 0) {
+    return 0;
+  }
+
+  //
+  // The counter may count down, and may wrap once during a download.
+  //
+  if (StartValue > EndValue) {
+    Counter = (StartTime >= Counter) ? StartTime - Counter : StartTime - EndValue + StartValue - Counter;
+  } else {
+    Counter = (Counter >= StartTime) ? Counter - StartTime : EndValue - StartTime + Counter - StartValue;
+  }
+
+  return GetTimeInNanoSecond (Counter);
+}
+
 /**
   Create a HttpIo instance for the file download.
 
@@ -245,15 +308,7 @@ HttpBootCreateHttpIo (
 
   ASSERT (Private != NULL);
 
-  ZeroMem (&ConfigData, sizeof (HTTP_IO_CONFIG_DATA));
-  if (!Private->UsingIpv6) {
-    ConfigData.Config4.HttpVersion = HttpVersion11;
-    ConfigData.Config4.RequestTimeOut = HTTP_BOOT_REQUEST_TIMEOUT;
-    IP4_COPY_ADDRESS (&ConfigData.Config4.LocalIp, &Private->StationIp.v4);
-    IP4_COPY_ADDRESS (&ConfigData.Config4.SubnetMask, &Private->SubnetMask.v4);
-  } else {
-    ASSERT (FALSE);
-  }
+  HttpBootGetHttpIoConfig (Private, &ConfigData);
 
   Status = HttpIoCreateIo (
              Private->Image,
@@ -460,29 +515,34 @@ HttpBootGetBootFileCallback (
   CallbackData = (HTTP_BOOT_CALLBACK_DATA *) Context;
 
   //
-  // Save the data into cache list.
+  // Save the data into cache list, unless it is streamed to the caller.
   //
-  NewEntityData = AllocatePool (sizeof (HTTP_BOOT_ENTITY_DATA));
-  if (NewEntityData == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
-  if (CallbackData->NewBlock) {
-    NewEntityData->Block = CallbackData->Block;
-    CallbackData->Block = NULL;
+  if (CallbackData->Cache != NULL) {
+    NewEntityData = AllocatePool (sizeof (HTTP_BOOT_ENTITY_DATA));
+    if (NewEntityData == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (CallbackData->NewBlock) {
+      NewEntityData->Block = CallbackData->Block;
+      CallbackData->Block = NULL;
+    }
+    NewEntityData->DataLength = Length;
+    NewEntityData->DataStart  = (UINT8*) Data;
+    InsertTailList (&CallbackData->Cache->EntityDataList, &NewEntityData->Link);
   }
-  NewEntityData->DataLength = Length;
-  NewEntityData->DataStart  = (UINT8*) Data;
-  InsertTailList (&CallbackData->Cache->EntityDataList, &NewEntityData->Link);
 
   //
-  // Copy data if caller has provided a buffer.
+  // Copy data if caller has provided a buffer. Data received in place is
+  // already there.
   //
   if (CallbackData->BufferSize > CallbackData->CopyedSize) {
-    CopyMem (
-      CallbackData->Buffer + CallbackData->CopyedSize,
-      Data,
-      MIN (Length, CallbackData->BufferSize - CallbackData->CopyedSize)
-      );
+    if ((UINT8 *) Data != CallbackData->Buffer + CallbackData->CopyedSize) {
+      CopyMem (
+        CallbackData->Buffer + CallbackData->CopyedSize,
+        Data,
+        MIN (Length, CallbackData->BufferSize - CallbackData->CopyedSize)
+        );
+    }
     CallbackData->CopyedSize += MIN (Length, CallbackData->BufferSize - CallbackData->CopyedSize);
   }
 
@@ -532,6 +592,10 @@ HttpBootGetBootFile (
   UINTN                      ContentLength;
   HTTP_BOOT_CACHE_CONTENT    *Cache;
   UINT8                      *Block;
+  UINT8                      *Window;
+  UINTN                      Received;
+  UINT64                     StartTime;
+  UINT64                     ElapsedNs;
   CHAR16                     *Url;
   
   ASSERT (Private != NULL);
@@ -708,15 +772,18 @@ HttpBootGetBootFile (
   }
   
   //
-  // 3.3 Init a message-body parser from the header information.
+  // 3.3 Init a message-body parser from the header information. The
+  // message-body is only cached for the size-probe pass, when the caller
+  // has no buffer yet; otherwise it is streamed into the caller's buffer.
   //
   Parser = NULL;
+  Window = NULL;
   Context.NewBlock   = FALSE;
   Context.Block      = NULL;
   Context.CopyedSize = 0;
   Context.Buffer     = Buffer;
   Context.BufferSize = *BufferSize;
-  Context.Cache      = Cache;
+  Context.Cache      = (*BufferSize == 0) ? Cache : NULL;
   Status = HttpInitMsgParser (
              HeaderOnly? HttpMethodHead : HttpMethodGet,
              ResponseData->Response.StatusCode,
@@ -733,7 +800,76 @@ HttpBootGetBootFile (
   //
   // 3.4 Continue to receive and parse message-body if needed.
   //
-  if (!HeaderOnly) {
+  if (!HeaderOnly && Context.Cache == NULL) {
+    //
+    // When the entity length is known and fits, receive straight into the
+    // caller's buffer, the parser callback then finds the data in place.
+    // Otherwise receive through a single window and copy out of it.
+    //
+    Status = HttpGetEntityLength (Parser, &ContentLength);
+    if (EFI_ERROR (Status) || ContentLength > *BufferSize) {
+      Window = AllocatePool (HTTP_BOOT_RECV_WINDOW_SIZE);
+      if (Window == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto ERROR_6;
+      }
+    }
+
+    ZeroMem (&ResponseBody, sizeof (HTTP_IO_RESOPNSE_DATA));
+    Received  = 0;
+    StartTime = 0;
+    PERF_CODE (
+      StartTime = GetPerformanceCounter ();
+    );
+    while (!HttpIsMessageComplete (Parser)) {
+      if (Window != NULL) {
+        ResponseBody.Body       = (CHAR8*) Window;
+        ResponseBody.BodyLength = HTTP_BOOT_RECV_WINDOW_SIZE;
+      } else {
+        if (Received >= *BufferSize) {
+          Status = EFI_BUFFER_TOO_SMALL;
+          goto ERROR_6;
+        }
+        ResponseBody.Body       = (CHAR8*) Buffer + Received;
+        ResponseBody.BodyLength = *BufferSize - Received;
+      }
+      Status = HttpIoRecvResponse (
+                 &Private->HttpIo,
+                 FALSE,
+                 &ResponseBody
+                 );
+      if (EFI_ERROR (Status)) {
+        goto ERROR_6;
+      }
+      Received += ResponseBody.BodyLength;
+
+      Status = HttpParseMessageBody (
+                 Parser,
+                 ResponseBody.BodyLength,
+                 ResponseBody.Body
+                 );
+      if (EFI_ERROR (Status)) {
+        goto ERROR_6;
+      }
+    }
+
+    PERF_CODE (
+      ElapsedNs = HttpBootElapsedTime (StartTime);
+      DEBUG ((
+        EFI_D_INFO,
+        "HttpBootGetBootFile: %Lu bytes in %Lu ms, %Lu KB/s%a\n",
+        (UINT64) Received,
+        DivU64x32 (ElapsedNs, 1000000),
+        (ElapsedNs == 0) ? 0 : DivU64x64Remainder (MultU64x32 (Received, 1000000), ElapsedNs, NULL),
+        (Window == NULL) ? "" : " (windowed)"
+        ));
+    );
+
+    if (Window != NULL) {
+      FreePool (Window);
+      Window = NULL;
+    }
+  } else if (!HeaderOnly) {
     ZeroMem (&ResponseBody, sizeof (HTTP_IO_RESOPNSE_DATA));
     while (!HttpIsMessageComplete (Parser)) {
       //
@@ -785,11 +921,14 @@ HttpBootGetBootFile (
   *BufferSize = ContentLength;
 
   //
-  // 4. Save the cache item to driver's cache list and return.
+  // 4. Save the cache item to driver's cache list and return. A streamed
+  // download leaves nothing to serve from the cache.
   //
-  if (!HeaderOnly) {
+  if (Context.Cache != NULL) {
     Cache->EntityLength = ContentLength;
     InsertTailList (&Private->CacheList, &Cache->Link);
+  } else if (!HeaderOnly) {
+    HttpBootFreeCache (Cache);
   }
 
   if (Parser != NULL) {
@@ -805,6 +944,9 @@ ERROR_6:
   if (Context.Block != NULL) {
     FreePool (Context.Block);
   }
+  if (Window != NULL) {
+    FreePool (Window);
+  }
   HttpBootFreeCache (Cache);
   
 ERROR_5:
@@ -828,3 +970,488 @@ ERROR_1:
 
   return Status;
 }
+
+/**
+  Build the request header for one part of the boot file.
+
+  @param[in]    Private         The pointer to the driver's private data.
+  @param[in]    Offset          Offset of the part in the boot file.
+  @param[in]    Length          Length of the part.
+  @param[out]   HttpIoHeader    The request header, to be freed with HttpBootFreeHeader().
+
+  @retval EFI_SUCCESS           The header was built.
+  @retval Others                Failed to build the header.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootCreateRangeHeader (
+  IN     HTTP_BOOT_PRIVATE_DATA   *Private,
+  IN     UINTN                    Offset,
+  IN     UINTN                    Length,
+     OUT HTTP_IO_HEADER           **HttpIoHeader
+  )
+{
+  EFI_STATUS                 Status;
+  HTTP_IO_HEADER             *Header;
+  CHAR8                      *HostName;
+  CHAR8                      Range[sizeof ("bytes=18446744073709551615-18446744073709551615")];
+
+  //
+  // Same headers as HttpBootGetBootFile() uses, plus the Range.
+  //
+  Header = HttpBootCreateHeader (4);
+  if (Header == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  HostName = NULL;
+  Status = HttpUrlGetHostName (
+             Private->BootFileUri,
+             Private->BootFileUriParser,
+             &HostName
+             );
+  if (!EFI_ERROR (Status)) {
+    Status = HttpBootSetHeader (Header, HTTP_FIELD_NAME_HOST, HostName);
+    FreePool (HostName);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = HttpBootSetHeader (Header, HTTP_FIELD_NAME_ACCEPT, "*/*");
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = HttpBootSetHeader (Header, HTTP_FIELD_NAME_USER_AGENT, HTTP_USER_AGENT_EFI_HTTP_BOOT);
+  }
+  if (!EFI_ERROR (Status)) {
+    AsciiSPrint (Range, sizeof (Range), "bytes=%Lu-%Lu", (UINT64) Offset, (UINT64) (Offset + Length - 1));
+    Status = HttpBootSetHeader (Header, HTTP_FIELD_NAME_RANGE, Range);
+  }
+  if (EFI_ERROR (Status)) {
+    HttpBootFreeHeader (Header);
+    return Status;
+  }
+
+  *HttpIoHeader = Header;
+  return EFI_SUCCESS;
+}
+
+/**
+  Parse a decimal number of a header field value.
+
+  @param[in, out]  Pointer         On input the start of the number, on output
+                                   the first character after it.
+  @param[out]      Value           The number.
+
+  @retval TRUE                     A number was parsed.
+  @retval FALSE                    There is no number, or it overflows a UINT64.
+
+**/
+STATIC
+BOOLEAN
+HttpBootParseDecimal (
+  IN OUT CHAR8                    **Pointer,
+     OUT UINT64                   *Value
+  )
+{
+  CHAR8                      *String;
+  UINTN                      Digit;
+
+  String = *Pointer;
+  if (*String < '0' || *String > '9') {
+    return FALSE;
+  }
+
+  *Value = 0;
+  for (; *String >= '0' && *String <= '9'; String++) {
+    Digit = *String - '0';
+    if (*Value > DivU64x32 (MAX_UINT64 - Digit, 10)) {
+      return FALSE;
+    }
+    *Value = MultU64x32 (*Value, 10) + Digit;
+  }
+
+  *Pointer = String;
+  return TRUE;
+}
+
+/**
+  Check that the response to the request for one part of the boot file
+  carries that part, with a Content-Range of the form
+  "bytes <first>-<last>/<complete length or *>".
+
+  @param[in]       Range           The part the response was received for.
+  @param[in]       FileSize        The size of the boot file.
+
+  @retval TRUE                     The response carries the requested part.
+  @retval FALSE                    It carries another range or has no Content-Range.
+
+**/
+STATIC
+BOOLEAN
+HttpBootCheckContentRange (
+  IN     HTTP_BOOT_RANGE          *Range,
+  IN     UINTN                    FileSize
+  )
+{
+  EFI_HTTP_HEADER            *Header;
+  CHAR8                      *Pointer;
+  UINT64                     First;
+  UINT64                     Last;
+  UINT64                     Complete;
+
+  Header = HttpBootFindHeader (
+             Range->ResponseData.HeaderCount,
+             Range->ResponseData.Headers,
+             HTTP_FIELD_NAME_CONTENT_RANGE
+             );
+  if (Header == NULL || Header->FieldValue == NULL) {
+    return FALSE;
+  }
+
+  Pointer = Header->FieldValue;
+  while (*Pointer == ' ') {
+    Pointer++;
+  }
+  if (AsciiStrnCmp (Pointer, "bytes ", 6) != 0) {
+    return FALSE;
+  }
+  Pointer += 6;
+  while (*Pointer == ' ') {
+    Pointer++;
+  }
+
+  if (!HttpBootParseDecimal (&Pointer, &First) || *Pointer++ != '-' ||
+      !HttpBootParseDecimal (&Pointer, &Last) || *Pointer++ != '/') {
+    return FALSE;
+  }
+  if (*Pointer == '*') {
+    Complete = FileSize;
+    Pointer++;
+  } else if (!HttpBootParseDecimal (&Pointer, &Complete)) {
+    return FALSE;
+  }
+  while (*Pointer == ' ') {
+    Pointer++;
+  }
+
+  return (BOOLEAN) (*Pointer == '\0' &&
+                    First == Range->Offset &&
+                    Last == Range->Offset + Range->Length - 1 &&
+                    Complete == FileSize);
+}
+
+/**
+  Handle a response received on the connection of one part of the boot file,
+  and queue the next receive if the part is not complete yet.
+
+  @param[in, out]  Range           The part the response was received for.
+  @param[in]       FileSize        The size of the boot file.
+  @param[in]       Buffer          The memory buffer the boot file is loaded in.
+
+  @retval EFI_SUCCESS              The response was handled.
+  @retval EFI_UNSUPPORTED          The server did not answer with the requested range.
+  @retval Others                   Unexpected error happened.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangeReceived (
+  IN OUT HTTP_BOOT_RANGE          *Range,
+  IN     UINTN                    FileSize,
+  IN     UINT8                    *Buffer
+  )
+{
+  EFI_STATUS                 Status;
+  UINTN                      ContentLength;
+
+  if (Range->Parser == NULL) {
+    //
+    // A server ignoring the Range header answers 200 with the whole file,
+    // and one may answer 206 with another range than the one asked for.
+    //
+    if (Range->ResponseData.Response.StatusCode != HTTP_STATUS_206_PARTIAL_CONTENT ||
+        !HttpBootCheckContentRange (Range, FileSize)) {
+      return EFI_UNSUPPORTED;
+    }
+
+    Range->Context.NewBlock   = FALSE;
+    Range->Context.Block      = NULL;
+    Range->Context.CopyedSize = 0;
+    Range->Context.Buffer     = Buffer + Range->Offset;
+    Range->Context.BufferSize = Range->Length;
+    Range->Context.Cache      = NULL;
+    Status = HttpInitMsgParser (
+               HttpMethodGet,
+               Range->ResponseData.Response.StatusCode,
+               Range->ResponseData.HeaderCount,
+               Range->ResponseData.Headers,
+               HttpBootGetBootFileCallback,
+               (VOID*) &Range->Context,
+               &Range->Parser
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Status = HttpGetEntityLength (Range->Parser, &ContentLength);
+    if (EFI_ERROR (Status) || ContentLength != Range->Length) {
+      return EFI_UNSUPPORTED;
+    }
+  } else {
+    Range->Received += Range->ResponseBody.BodyLength;
+    Status = HttpParseMessageBody (
+               Range->Parser,
+               Range->ResponseBody.BodyLength,
+               Range->ResponseBody.Body
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (HttpIsMessageComplete (Range->Parser)) {
+    Range->Complete = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  if (Range->Received >= Range->Length) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  //
+  // Receive the rest of the part in place, the parser callback then finds
+  // the data where it belongs.
+  //
+  Range->ResponseBody.Body       = (CHAR8*) Buffer + Range->Offset + Range->Received;
+  Range->ResponseBody.BodyLength = Range->Length - Range->Received;
+  return HttpIoQueueResponse (&Range->HttpIo, FALSE, &Range->ResponseBody);
+}
+
+/**
+  Download the boot file over several HTTP connections at once, each of them
+  loading a part of the file into Buffer with a ranged GET request.
+
+  The number of connections comes from PcdHttpBootParallelConnections, and is
+  lowered so that no part is smaller than HTTP_BOOT_MIN_RANGE_SIZE. The size
+  of the boot file must already be known.
+
+  @param[in]       Private         The pointer to the driver's private data.
+  @param[in, out]  BufferSize      On input the size of Buffer in bytes. On output with a return
+                                   code of EFI_SUCCESS, the amount of data transferred to
+                                   Buffer. On output with a return code of EFI_BUFFER_TOO_SMALL,
+                                   the size of Buffer required to retrieve the requested file.
+  @param[out]      Buffer          The memory buffer to transfer the file to.
+
+  @retval EFI_SUCCESS              The file was loaded.
+  @retval EFI_UNSUPPORTED          Ranged downloads are disabled or not worth it for this file,
+                                   the file is already cached, or the server did not honor the
+                                   Range header. The caller should use HttpBootGetBootFile().
+  @retval EFI_TIMEOUT              No part received any data for HTTP_BOOT_REQUEST_TIMEOUT.
+  @retval EFI_OUT_OF_RESOURCES     Could not allocate needed resources
+  @retval EFI_BUFFER_TOO_SMALL     The BufferSize is too small to read the boot file.
+                                   BufferSize has been updated with the size needed to complete
+                                   the request.
+  @retval Others                   Unexpected error happened.
+
+**/
+EFI_STATUS
+HttpBootGetBootFileRanged (
+  IN     HTTP_BOOT_PRIVATE_DATA   *Private,
+  IN OUT UINTN                    *BufferSize,
+     OUT UINT8                    *Buffer
+  )
+{
+  EFI_STATUS                 Status;
+  UINTN                      Count;
+  UINTN                      Index;
+  UINTN                      HeaderIndex;
+  UINTN                      Pending;
+  UINTN                      PartSize;
+  HTTP_BOOT_RANGE            *Ranges;
+  HTTP_BOOT_RANGE            *Range;
+  HTTP_IO_CONFIG_DATA        ConfigData;
+  EFI_HTTP_REQUEST_DATA      RequestData;
+  EFI_EVENT                  TimeoutEvent;
+  UINT64                     StartTime;
+  UINT64                     ElapsedNs;
+
+  ASSERT (Private != NULL);
+
+  //
+  // A file cached by the size probe is served from the cache instead.
+  //
+  Count = MIN (PcdGet8 (PcdHttpBootParallelConnections), HTTP_BOOT_MAX_CONNECTIONS);
+  Count = MIN (Count, Private->BootFileSize / HTTP_BOOT_MIN_RANGE_SIZE);
+  if (Count < 2 || Private->UsingIpv6 || !IsListEmpty (&Private->CacheList)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (BufferSize == NULL || Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (*BufferSize < Private->BootFileSize) {
+    *BufferSize = Private->BootFileSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Ranges = AllocateZeroPool (Count * sizeof (HTTP_BOOT_RANGE));
+  if (Ranges == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  RequestData.Method = HttpMethodGet;
+  RequestData.Url = AllocatePool ((AsciiStrLen (Private->BootFileUri) + 1) * sizeof (CHAR16));
+  if (RequestData.Url == NULL) {
+    FreePool (Ranges);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  AsciiStrToUnicodeStr (Private->BootFileUri, RequestData.Url);
+
+  HttpBootGetHttpIoConfig (Private, &ConfigData);
+  TimeoutEvent = NULL;
+
+  //
+  // 1. Open a connection per part and send out all the requests, the last
+  // part takes the remainder of the file.
+  //
+  PartSize  = Private->BootFileSize / Count;
+  StartTime = 0;
+  PERF_CODE (
+    StartTime = GetPerformanceCounter ();
+  );
+  for (Index = 0; Index < Count; Index++) {
+    Range = &Ranges[Index];
+    Range->Offset = Index * PartSize;
+    Range->Length = (Index == Count - 1) ? Private->BootFileSize - Range->Offset : PartSize;
+
+    Status = HttpIoCreateIo (
+               Private->Image,
+               Private->Controller,
+               IP_VERSION_4,
+               &ConfigData,
+               &Range->HttpIo
+               );
+    if (EFI_ERROR (Status)) {
+      goto ON_EXIT;
+    }
+    Range->HttpCreated = TRUE;
+
+    Status = HttpBootCreateRangeHeader (Private, Range->Offset, Range->Length, &Range->RequestHeader);
+    if (EFI_ERROR (Status)) {
+      goto ON_EXIT;
+    }
+
+    Status = HttpIoSendRequest (
+               &Range->HttpIo,
+               &RequestData,
+               Range->RequestHeader->HeaderCount,
+               Range->RequestHeader->Headers,
+               0,
+               NULL
+               );
+    if (EFI_ERROR (Status)) {
+      goto ON_EXIT;
+    }
+
+    Status = HttpIoQueueResponse (&Range->HttpIo, TRUE, &Range->ResponseData);
+    if (EFI_ERROR (Status)) {
+      goto ON_EXIT;
+    }
+  }
+
+  //
+  // 2. Poll the connections in turn, so that every one of them keeps its
+  // receive window moving, until all the parts are complete. Give up when
+  // none of them receives anything for HTTP_BOOT_REQUEST_TIMEOUT.
+  //
+  Status = gBS->CreateEvent (EVT_TIMER, TPL_CALLBACK, NULL, NULL, &TimeoutEvent);
+  if (EFI_ERROR (Status)) {
+    TimeoutEvent = NULL;
+    goto ON_EXIT;
+  }
+  gBS->SetTimer (TimeoutEvent, TimerRelative, HTTP_BOOT_REQUEST_TIMEOUT * TICKS_PER_MS);
+
+  Pending = Count;
+  while (Pending > 0) {
+    if (!EFI_ERROR (gBS->CheckEvent (TimeoutEvent))) {
+      DEBUG ((EFI_D_WARN, "HttpBootGetBootFileRanged: no data for %d ms\n", HTTP_BOOT_REQUEST_TIMEOUT));
+      Status = EFI_TIMEOUT;
+      goto ON_EXIT;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+      Range = &Ranges[Index];
+      if (Range->Complete) {
+        continue;
+      }
+
+      Status = HttpIoPollResponse (
+                 &Range->HttpIo,
+                 (Range->Parser == NULL) ? &Range->ResponseData : &Range->ResponseBody
+                 );
+      if (Status == EFI_NOT_READY) {
+        continue;
+      }
+      if (!EFI_ERROR (Status)) {
+        Status = HttpBootRangeReceived (Range, Private->BootFileSize, Buffer);
+      }
+      if (EFI_ERROR (Status)) {
+        goto ON_EXIT;
+      }
+      gBS->SetTimer (TimeoutEvent, TimerRelative, HTTP_BOOT_REQUEST_TIMEOUT * TICKS_PER_MS);
+      if (Range->Complete) {
+        Pending--;
+      }
+    }
+  }
+
+  PERF_CODE (
+    ElapsedNs = HttpBootElapsedTime (StartTime);
+    DEBUG ((
+      EFI_D_INFO,
+      "HttpBootGetBootFileRanged: %Lu bytes over %d connections in %Lu ms, %Lu KB/s\n",
+      (UINT64) Private->BootFileSize,
+      (UINT32) Count,
+      DivU64x32 (ElapsedNs, 1000000),
+      (ElapsedNs == 0) ? 0 : DivU64x64Remainder (MultU64x32 (Private->BootFileSize, 1000000), ElapsedNs, NULL)
+      ));
+  );
+
+  *BufferSize = Private->BootFileSize;
+  Status = EFI_SUCCESS;
+
+ON_EXIT:
+  if (TimeoutEvent != NULL) {
+    gBS->CloseEvent (TimeoutEvent);
+  }
+  for (Index = 0; Index < Count; Index++) {
+    Range = &Ranges[Index];
+    if (Range->Parser != NULL) {
+      HttpFreeMsgParser (Range->Parser);
+    }
+    if (Range->ResponseData.Headers != NULL) {
+      for (HeaderIndex = 0; HeaderIndex < Range->ResponseData.HeaderCount; HeaderIndex++) {
+        FreePool (Range->ResponseData.Headers[HeaderIndex].FieldName);
+        FreePool (Range->ResponseData.Headers[HeaderIndex].FieldValue);
+      }
+      FreePool (Range->ResponseData.Headers);
+    }
+    if (Range->RequestHeader != NULL) {
+      HttpBootFreeHeader (Range->RequestHeader);
+    }
+    if (Range->HttpCreated) {
+      //
+      // Abort a receive still queued in the caller's buffer before the
+      // child goes away.
+      //
+      if (!Range->HttpIo.IsRxDone) {
+        Range->HttpIo.Http->Cancel (Range->HttpIo.Http, NULL);
+      }
+      HttpIoDestroyIo (&Range->HttpIo);
+    }
+  }
+  FreePool (RequestData.Url);
+  FreePool (Ranges);
+
+  return Status;
+}
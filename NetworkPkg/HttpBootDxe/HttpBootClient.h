@@ -17,10 +17,15 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #define HTTP_BOOT_REQUEST_TIMEOUT            5000      // 5 seconds in uints of millisecond.
 #define HTTP_BOOT_BLOCK_SIZE                 1024
+#define HTTP_BOOT_RECV_WINDOW_SIZE           0x10000   // Receive window when streaming without Content-Length.
+#define HTTP_BOOT_MAX_CONNECTIONS            8         // Upper bound of PcdHttpBootParallelConnections.
+#define HTTP_BOOT_MIN_RANGE_SIZE             0x100000  // Smallest part worth its own connection.
 
 #define HTTP_FIELD_NAME_USER_AGENT           "User-Agent"
 #define HTTP_FIELD_NAME_HOST                 "Host"
 #define HTTP_FIELD_NAME_ACCEPT               "Accept"
+#define HTTP_FIELD_NAME_RANGE                "Range"
+#define HTTP_FIELD_NAME_CONTENT_RANGE        "Content-Range"
 
 
 #define HTTP_USER_AGENT_EFI_HTTP_BOOT        "UefiHttpBoot/1.0"
@@ -66,6 +71,24 @@ typedef struct {
   UINT8                      *Buffer;
 } HTTP_BOOT_CALLBACK_DATA;
 
+//
+// One part of the boot file, downloaded over its own HTTP child with a
+// ranged GET request straight into the caller's buffer.
+//
+typedef struct {
+  HTTP_IO                    HttpIo;
+  BOOLEAN                    HttpCreated;
+  HTTP_IO_HEADER             *RequestHeader;
+  HTTP_IO_RESOPNSE_DATA      ResponseData;    // Response header.
+  HTTP_IO_RESOPNSE_DATA      ResponseBody;    // Points into the caller's buffer.
+  VOID                       *Parser;         // NULL until the response header is received.
+  HTTP_BOOT_CALLBACK_DATA    Context;
+  UINTN                      Offset;
+  UINTN                      Length;
+  UINTN                      Received;
+  BOOLEAN                    Complete;
+} HTTP_BOOT_RANGE;
+
 /**
   Discover all the boot information for boot file.
 
@@ -125,6 +148,40 @@ HttpBootGetBootFile (
      OUT UINT8                    *Buffer
   );
 
+/**
+  Download the boot file over several HTTP connections at once, each of them
+  loading a part of the file into Buffer with a ranged GET request.
+
+  The number of connections comes from PcdHttpBootParallelConnections, and is
+  lowered so that no part is smaller than HTTP_BOOT_MIN_RANGE_SIZE. The size
+  of the boot file must already be known.
+
+  @param[in]       Private         The pointer to the driver's private data.
+  @param[in, out]  BufferSize      On input the size of Buffer in bytes. On output with a return
+                                   code of EFI_SUCCESS, the amount of data transferred to
+                                   Buffer. On output with a return code of EFI_BUFFER_TOO_SMALL,
+                                   the size of Buffer required to retrieve the requested file.
+  @param[out]      Buffer          The memory buffer to transfer the file to.
+
+  @retval EFI_SUCCESS              The file was loaded.
+  @retval EFI_UNSUPPORTED          Ranged downloads are disabled or not worth it for this file,
+                                   the file is already cached, or the server did not honor the
+                                   Range header. The caller should use HttpBootGetBootFile().
+  @retval EFI_TIMEOUT              No part received any data for HTTP_BOOT_REQUEST_TIMEOUT.
+  @retval EFI_OUT_OF_RESOURCES     Could not allocate needed resources
+  @retval EFI_BUFFER_TOO_SMALL     The BufferSize is too small to read the boot file.
+                                   BufferSize has been updated with the size needed to complete
+                                   the request.
+  @retval Others                   Unexpected error happened.
+
+**/
+EFI_STATUS
+HttpBootGetBootFileRanged (
+  IN     HTTP_BOOT_PRIVATE_DATA   *Private,
+  IN OUT UINTN                    *BufferSize,
+     OUT UINT8                    *Buffer
+  );
+
 /**
   Clean up all cached data.
 
@@ -191,8 +191,18 @@ HttpBootLoadFile (
   }
 
   //
-  // Load the boot file into Buffer
+  // Load the boot file into Buffer, over parallel ranged requests when they
+  // are enabled. Whatever keeps those from working, fall back to a single
+  // request, which also serves a file cached by the size probe.
   //
+  Status = HttpBootGetBootFileRanged (Private, BufferSize, Buffer);
+  if (!EFI_ERROR (Status) || Status == EFI_BUFFER_TOO_SMALL) {
+    return Status;
+  }
+  if (Status != EFI_UNSUPPORTED) {
+    DEBUG ((EFI_D_WARN, "HttpBootLoadFile: ranged download failed: %r\n", Status));
+  }
+
   return  HttpBootGetBootFile (
             Private,
             FALSE,
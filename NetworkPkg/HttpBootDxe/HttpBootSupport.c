@@ -516,28 +516,26 @@ HttpIoSendRequest (
 }
 
 /**
-  Synchronously receive a HTTP RESPONSE message from the server.
-  
+  Queue a request to receive a HTTP RESPONSE message from the server, without
+  waiting for it. HttpIoPollResponse() completes the request.
+
   @param[in]   HttpIo           The HttpIo wrapping the HTTP service.
   @param[in]   RecvMsgHeader    TRUE to receive a new HTTP response (from message header).
                                 FALSE to continue receive the previous response message.
-  @param[out]  ResponseData     Point to a wrapper of the received response data.
-  
-  @retval EFI_SUCCESS            The HTTP resopnse is received.
+  @param[in]   ResponseData     Point to a wrapper of the response data to receive.
+
+  @retval EFI_SUCCESS            The receive request is queued.
   @retval EFI_INVALID_PARAMETER  One or more parameters are invalid.
-  @retval EFI_OUT_OF_RESOURCES   Failed to allocate memory.
-  @retval EFI_DEVICE_ERROR       An unexpected network or system error occurred.
   @retval Others                 Other errors as indicated.
 
 **/
 EFI_STATUS
-HttpIoRecvResponse (
+HttpIoQueueResponse (
   IN      HTTP_IO                  *HttpIo,
   IN      BOOLEAN                  RecvMsgHeader,
-     OUT  HTTP_IO_RESOPNSE_DATA    *ResponseData
+  IN      HTTP_IO_RESOPNSE_DATA    *ResponseData
   )
 {
-  EFI_STATUS                 Status;
   EFI_HTTP_PROTOCOL          *Http;
 
   if (HttpIo == NULL || HttpIo->Http == NULL || ResponseData == NULL) {
@@ -560,26 +558,42 @@ HttpIoRecvResponse (
 
   Http = HttpIo->Http;
   HttpIo->IsRxDone = FALSE;
-  Status = Http->Response (
-                   Http,
-                   &HttpIo->RspToken
-                   );
-  
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
+  return Http->Response (
+                 Http,
+                 &HttpIo->RspToken
+                 );
+}
 
-  //
-  // Poll the network until transmit finish.
-  //
-  while (!HttpIo->IsRxDone) {
-    Http->Poll (Http);
+/**
+  Poll the network once for a receive request queued by HttpIoQueueResponse().
+
+  @param[in]   HttpIo           The HttpIo wrapping the HTTP service.
+  @param[out]  ResponseData     Point to a wrapper of the received response data.
+
+  @retval EFI_NOT_READY          The HTTP response is not received yet.
+  @retval EFI_SUCCESS            The HTTP resopnse is received.
+  @retval Others                 Other errors as indicated.
+
+**/
+EFI_STATUS
+HttpIoPollResponse (
+  IN      HTTP_IO                  *HttpIo,
+     OUT  HTTP_IO_RESOPNSE_DATA    *ResponseData
+  )
+{
+  EFI_STATUS                 Status;
+
+  if (!HttpIo->IsRxDone) {
+    HttpIo->Http->Poll (HttpIo->Http);
+    if (!HttpIo->IsRxDone) {
+      return EFI_NOT_READY;
+    }
   }
 
   //
   // Store the received data into the wrapper.
   //
-  Status = HttpIo->ReqToken.Status;
+  Status = HttpIo->RspToken.Status;
   if (!EFI_ERROR (Status)) {
     ResponseData->HeaderCount = HttpIo->RspToken.Message->HeaderCount;
     ResponseData->Headers     = HttpIo->RspToken.Message->Headers;
@@ -588,3 +602,42 @@ HttpIoRecvResponse (
 
   return Status;
 }
+
+/**
+  Synchronously receive a HTTP RESPONSE message from the server.
+  
+  @param[in]   HttpIo           The HttpIo wrapping the HTTP service.
+  @param[in]   RecvMsgHeader    TRUE to receive a new HTTP response (from message header).
+                                FALSE to continue receive the previous response message.
+  @param[out]  ResponseData     Point to a wrapper of the received response data.
+  
+  @retval EFI_SUCCESS            The HTTP resopnse is received.
+  @retval EFI_INVALID_PARAMETER  One or more parameters are invalid.
+  @retval EFI_OUT_OF_RESOURCES   Failed to allocate memory.
+  @retval EFI_DEVICE_ERROR       An unexpected network or system error occurred.
+  @retval Others                 Other errors as indicated.
+
+**/
+EFI_STATUS
+HttpIoRecvResponse (
+  IN      HTTP_IO                  *HttpIo,
+  IN      BOOLEAN                  RecvMsgHeader,
+     OUT  HTTP_IO_RESOPNSE_DATA    *ResponseData
+  )
+{
+  EFI_STATUS                 Status;
+
+  Status = HttpIoQueueResponse (HttpIo, RecvMsgHeader, ResponseData);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Poll the network until receive finish.
+  //
+  do {
+    Status = HttpIoPollResponse (HttpIo, ResponseData);
+  } while (Status == EFI_NOT_READY);
+
+  return Status;
+}
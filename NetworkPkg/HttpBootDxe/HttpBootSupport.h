@@ -89,6 +89,23 @@ HttpBootFreeHeader (
   IN  HTTP_IO_HEADER       *HttpIoHeader
   );
 
+/**
+  Find a specified header field according to the field name.
+
+  @param[in]   HeaderCount      Number of HTTP header structures in Headers list. 
+  @param[in]   Headers          Array containing list of HTTP headers.
+  @param[in]   FieldName        Null terminated string which describes a field name. 
+
+  @return    Pointer to the found header or NULL.
+
+**/
+EFI_HTTP_HEADER *
+HttpBootFindHeader (
+  IN  UINTN                HeaderCount,
+  IN  EFI_HTTP_HEADER      *Headers,
+  IN  CHAR8                *FieldName
+  );
+
 /**
   Set or update a HTTP header with the field name and corresponding value.
 
@@ -225,6 +242,44 @@ HttpIoSendRequest (
   IN  VOID                   *Body          OPTIONAL
   );
 
+/**
+  Queue a request to receive a HTTP RESPONSE message from the server, without
+  waiting for it. HttpIoPollResponse() completes the request.
+
+  @param[in]   HttpIo           The HttpIo wrapping the HTTP service.
+  @param[in]   RecvMsgHeader    TRUE to receive a new HTTP response (from message header).
+                                FALSE to continue receive the previous response message.
+  @param[in]   ResponseData     Point to a wrapper of the response data to receive.
+
+  @retval EFI_SUCCESS            The receive request is queued.
+  @retval EFI_INVALID_PARAMETER  One or more parameters are invalid.
+  @retval Others                 Other errors as indicated.
+
+**/
+EFI_STATUS
+HttpIoQueueResponse (
+  IN      HTTP_IO                  *HttpIo,
+  IN      BOOLEAN                  RecvMsgHeader,
+  IN      HTTP_IO_RESOPNSE_DATA    *ResponseData
+  );
+
+/**
+  Poll the network once for a receive request queued by HttpIoQueueResponse().
+
+  @param[in]   HttpIo           The HttpIo wrapping the HTTP service.
+  @param[out]  ResponseData     Point to a wrapper of the received response data.
+
+  @retval EFI_NOT_READY          The HTTP response is not received yet.
+  @retval EFI_SUCCESS            The HTTP resopnse is received.
+  @retval Others                 Other errors as indicated.
+
+**/
+EFI_STATUS
+HttpIoPollResponse (
+  IN      HTTP_IO                  *HttpIo,
+     OUT  HTTP_IO_RESOPNSE_DATA    *ResponseData
+  );
+
 /**
   Synchronously receive a HTTP RESPONSE message from the server.
   
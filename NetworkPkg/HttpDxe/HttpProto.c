@@ -647,9 +647,18 @@ HttpConfigureTcp4 (
   Tcp4Option->KeepAliveTime          = HTTP_KEEP_ALIVE_TIME;
   Tcp4Option->KeepAliveInterval      = HTTP_KEEP_ALIVE_INTERVAL;
   Tcp4Option->EnableNagle            = TRUE;
+  Tcp4Option->EnableSelectiveAck     = TRUE;
   Tcp4CfgData->ControlOption         = Tcp4Option;
 
   Status = HttpInstance->Tcp4->Configure (HttpInstance->Tcp4, Tcp4CfgData);
+  if (Status == EFI_UNSUPPORTED) {
+    //
+    // The TCP driver doesn't support SACK, go on without it.
+    //
+    Tcp4Option->EnableSelectiveAck   = FALSE;
+    Status = HttpInstance->Tcp4->Configure (HttpInstance->Tcp4, Tcp4CfgData);
+  }
+
   if (EFI_ERROR (Status)) {
     DEBUG ((EFI_D_ERROR, "HttpConfigureTcp4 - %r\n", Status));
     return Status;
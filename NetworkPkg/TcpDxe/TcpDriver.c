@@ -226,6 +226,33 @@ TcpDriverEntryPoint (
   return EFI_SUCCESS;
 }
 
+/**
+  Find out which TCP checksums the device handles. Called once when the
+  service is created, and again whenever IPsec is installed, as the device
+  can't see the TCP header of an ESP packet.
+
+  @param[in]  Event              The IPsec protocol notification event.
+  @param[in]  Context            Pointer to the TCP_SERVICE_DATA.
+
+**/
+VOID
+EFIAPI
+TcpChecksumOffloadNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  TCP_SERVICE_DATA  *TcpServiceData;
+  UINT32            RxChecksum;
+  UINT32            TxChecksum;
+
+  TcpServiceData = (TCP_SERVICE_DATA *) Context;
+
+  NetLibGetChecksumOffload (TcpServiceData->ControllerHandle, &RxChecksum, &TxChecksum);
+  TcpServiceData->RxChecksumOffload = (BOOLEAN) ((RxChecksum & EDKII_NET_CHECKSUM_TCP4) != 0);
+  TcpServiceData->TxChecksumOffload = (BOOLEAN) ((TxChecksum & EDKII_NET_CHECKSUM_TCP4) != 0);
+}
+
 /**
   Create a new TCP4 or TCP6 driver service binding protocol
 
@@ -308,6 +335,18 @@ TcpCreateService (
 
 
   InitializeListHead (&TcpServiceData->SocketList);
+
+  if (IpVersion == IP_VERSION_4) {
+    TcpChecksumOffloadNotify (NULL, TcpServiceData);
+    TcpServiceData->IpSecNotifyEvent = EfiCreateProtocolNotifyEvent (
+                                         &gEfiIpSec2ProtocolGuid,
+                                         TPL_CALLBACK,
+                                         TcpChecksumOffloadNotify,
+                                         TcpServiceData,
+                                         &TcpServiceData->IpSecRegistration
+                                         );
+  }
+
   ZeroMem (&OpenData, sizeof (IP_IO_OPEN_DATA));
 
   if (IpVersion == IP_VERSION_4) {
@@ -327,6 +366,7 @@ TcpCreateService (
   }
 
   OpenData.PktRcvdNotify  = TcpRxCallback;
+  OpenData.RcvdContext    = TcpServiceData;
   Status                  = IpIoOpen (TcpServiceData->IpIo, &OpenData);
   if (EFI_ERROR (Status)) {
     goto ON_ERROR;
@@ -353,6 +393,10 @@ TcpCreateService (
 
 ON_ERROR:
 
+  if (TcpServiceData->IpSecNotifyEvent != NULL) {
+    gBS->CloseEvent (TcpServiceData->IpSecNotifyEvent);
+  }
+
   if (TcpServiceData->IpIo != NULL) {
     IpIoDestroy (TcpServiceData->IpIo);
     TcpServiceData->IpIo = NULL;
@@ -497,6 +541,10 @@ TcpDestroyService (
     //
     TcpDestroyTimer ();
 
+    if (TcpServiceData->IpSecNotifyEvent != NULL) {
+      gBS->CloseEvent (TcpServiceData->IpSecNotifyEvent);
+    }
+
     //
     // Release the TCP service data
     //
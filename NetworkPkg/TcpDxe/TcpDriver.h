@@ -34,6 +34,10 @@ typedef struct _TCP_SERVICE_DATA {
   IP_IO                         *IpIo;
   EFI_SERVICE_BINDING_PROTOCOL  ServiceBinding;
   LIST_ENTRY                    SocketList;
+  BOOLEAN                       RxChecksumOffload;  ///< The device validates the TCP checksum.
+  BOOLEAN                       TxChecksumOffload;  ///< The device computes the TCP checksum.
+  EFI_EVENT                     IpSecNotifyEvent;   ///< Updates the above when IPsec is installed.
+  VOID                          *IpSecRegistration;
 } TCP_SERVICE_DATA;
 
 typedef struct _TCP_PROTO_DATA {
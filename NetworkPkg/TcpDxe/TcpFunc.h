@@ -63,6 +63,17 @@ TcpInitTcbPeer (
   IN     TCP_OPTION *Opt
   );
 
+/**
+  Forget what the peer has SACKed.
+
+  @param[in, out]  Tcb    Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpSackReset (
+  IN OUT TCP_CB *Tcb
+  );
+
 /**
   Try to find one Tcb whose <Ip, Port> equals to <IN Addr, IN Port>.
 
@@ -366,6 +377,20 @@ TcpRetransmit (
   IN TCP_SEQNO Seq
   );
 
+/**
+  Retransmit the first hole the SACK scoreboard deems lost.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+
+  @retval TRUE    A hole was retransmitted.
+  @retval FALSE   No hole to retransmit.
+
+**/
+BOOLEAN
+TcpSackRetransmit (
+  IN OUT TCP_CB *Tcb
+  );
+
 /**
   Check whether to send data/SYN/FIN and piggyback an ACK.
 
@@ -491,6 +516,7 @@ TcpIcmpInput (
                        address.
   @param[in]  Version  IP_VERSION_4 indicates IP4 stack, IP_VERSION_6 indicates
                        IP6 stack.
+  @param[in]  ChecksumValid  The device already validated the checksum.
 
   @retval 0        The segment processed successfully. It is either accepted or
                    discarded. But no connection is reset by the segment.
@@ -502,7 +528,8 @@ TcpInput (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dst,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN BOOLEAN         ChecksumValid
   );
 
 //
@@ -36,7 +36,62 @@ TcpSeqAcceptable (
 }
 
 /**
-  NewReno fast recovery defined in RFC3782.
+  Mark the segments on the SndQue that the peer has SACKed.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+  @param[in]       Option   The options of the received segment.
+
+**/
+VOID
+TcpSackUpdate (
+  IN OUT TCP_CB     *Tcb,
+  IN     TCP_OPTION *Option
+  )
+{
+  LIST_ENTRY      *Entry;
+  TCP_SEG         *Seg;
+  TCP_SACK_BLOCK  *Block;
+  UINT8           Index;
+
+  for (Index = 0; Index < Option->SackNum; Index++) {
+    Block = &Option->Sack[Index];
+
+    //
+    // Ignore the blocks that are malformed, already covered
+    // by the cumulative ACK, or beyond the data sent.
+    //
+    if (TCP_SEQ_GEQ (Block->Left, Block->Right) ||
+        TCP_SEQ_LEQ (Block->Left, Tcb->SndUna) ||
+        TCP_SEQ_GT (Block->Right, TcpGetMaxSndNxt (Tcb)))
+    {
+
+      continue;
+    }
+
+    //
+    // Only segments entirely inside the block are SACKed.
+    //
+    NET_LIST_FOR_EACH (Entry, &Tcb->SndQue) {
+      Seg = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (Entry, NET_BUF, List));
+
+      if (TCP_SEQ_GEQ (Seg->Seq, Block->Right)) {
+        break;
+      }
+
+      if (TCP_SEQ_LEQ (Block->Left, Seg->Seq) && TCP_SEQ_LEQ (Seg->End, Block->Right)) {
+        Seg->Sacked = TRUE;
+      }
+    }
+
+    if (TCP_SEQ_GT (Block->Right, Tcb->SackHigh)) {
+      Tcb->SackHigh = Block->Right;
+    }
+  }
+}
+
+/**
+  NewReno fast recovery defined in RFC6582, using the SACK
+  scoreboard to retransmit more than one hole per round trip.
 
   @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
   @param[in]       Seg      Segment that triggers the fast recovery.
@@ -56,6 +111,15 @@ TcpFastRecover (
   //
   if (Tcb->CongestState != TCP_CONGEST_RECOVER) {
 
+    //
+    // Step 2 of RFC6582: the duplicate ACKs don't cover more than
+    // the recover point, they are most likely caused by the data
+    // retransmitted at the last loss. Don't start over again.
+    //
+    if (TCP_SEQ_LT (Seg->Ack, Tcb->Recover)) {
+      return;
+    }
+
     //
     // Step 1A: Invoking fast retransmission.
     //
@@ -68,9 +132,12 @@ TcpFastRecover (
     TCP_CLEAR_FLG (Tcb->CtrlFlag, TCP_CTRL_RTT_ON);
 
     //
-    // Step 2: Entering fast retransmission
+    // Step 2: Entering fast retransmission. The segment at
+    // SND.UNA is the first hole, the SACK scoreboard looks
+    // for the other ones above it.
     //
     TcpRetransmit (Tcb, Tcb->SndUna);
+    Tcb->SackRxt = Tcb->SndUna + 1;
     Tcb->CWnd = Tcb->Ssthresh + 3 * Tcb->SndMss;
 
     DEBUG (
@@ -90,12 +157,17 @@ TcpFastRecover (
     //
     // Step 3: Fast Recovery,
     // If this is a duplicated ACK, increse Cwnd by SMSS.
+    // When SACK reports another lost segment, spend the
+    // segment that has left the network on its
+    // retransmission instead.
     //
 
     // Step 4 is skipped here only to be executed later
     // by TcpToSendData
     //
-    Tcb->CWnd += Tcb->SndMss;
+    if (!TcpSackRetransmit (Tcb)) {
+      Tcb->CWnd += Tcb->SndMss;
+    }
     DEBUG (
       (EFI_D_INFO,
       "TcpFastRecover: received another duplicated ACK (%d) for TCB %p\n",
@@ -113,11 +185,12 @@ TcpFastRecover (
 
       //
       // Step 5 - Full ACK:
-      // deflate the congestion window, and exit fast recovery
+      // deflate the congestion window, and exit fast recovery.
+      // FlightSize is the data still outstanding after this ACK.
       //
-      FlightSize        = TCP_SUB_SEQ (Tcb->SndNxt, Tcb->SndUna);
+      FlightSize        = TCP_SUB_SEQ (Tcb->SndNxt, Seg->Ack);
 
-      Tcb->CWnd         = MIN (Tcb->Ssthresh, FlightSize + Tcb->SndMss);
+      Tcb->CWnd         = MIN (Tcb->Ssthresh, MAX (FlightSize, Tcb->SndMss) + Tcb->SndMss);
 
       Tcb->CongestState = TCP_CONGEST_OPEN;
       DEBUG (
@@ -135,6 +208,10 @@ TcpFastRecover (
       // , then deflate the CWnd
       //
       TcpRetransmit (Tcb, Seg->Ack);
+      if (TCP_SEQ_LEQ (Tcb->SackRxt, Seg->Ack)) {
+        Tcb->SackRxt = Seg->Ack + 1;
+      }
+
       Acked = TCP_SUB_SEQ (Seg->Ack, Tcb->SndUna);
 
       //
@@ -581,6 +658,14 @@ TcpQueueData (
   Seg   = TCPSEG_NETBUF (Nbuf);
   Head  = &Tcb->RcvQue;
 
+  //
+  // Remember the last out-of-order segment, its block
+  // is the first one to report in the SACK option.
+  //
+  if (TCP_SEQ_GT (Seg->Seq, Tcb->RcvNxt)) {
+    Tcb->SackRecent = Seg->Seq;
+  }
+
   //
   // Fast path to process normal case. That is,
   // no out-of-order segments are received.
@@ -715,6 +800,7 @@ TcpAdjustSndQue (
                        address.
   @param[in]  Version  IP_VERSION_4 indicates IP4 stack. IP_VERSION_6 indicates
                        IP6 stack.
+  @param[in]  ChecksumValid  The device already validated the checksum.
 
   @retval 0        Segment  processed successfully. It is either accepted or
                    discarded. However, no connection is reset by the segment.
@@ -726,7 +812,8 @@ TcpInput (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dst,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN BOOLEAN         ChecksumValid
   )
 {
   TCP_CB      *Tcb;
@@ -756,17 +843,19 @@ TcpInput (
     goto DISCARD;
   }
 
-  if (Version == IP_VERSION_4) {
-    Checksum = NetPseudoHeadChecksum (Src->Addr[0], Dst->Addr[0], 6, 0);
-  } else {
-    Checksum = NetIp6PseudoHeadChecksum (&Src->v6, &Dst->v6, 6, 0);
-  }
+  if (!ChecksumValid) {
+    if (Version == IP_VERSION_4) {
+      Checksum = NetPseudoHeadChecksum (Src->Addr[0], Dst->Addr[0], 6, 0);
+    } else {
+      Checksum = NetIp6PseudoHeadChecksum (&Src->v6, &Dst->v6, 6, 0);
+    }
 
-  Checksum = TcpChecksum (Nbuf, Checksum);
+    Checksum = TcpChecksum (Nbuf, Checksum);
 
-  if (Checksum != 0) {
-    DEBUG ((EFI_D_ERROR, "TcpInput: received a checksum error packet\n"));
-    goto DISCARD;
+    if (Checksum != 0) {
+      DEBUG ((EFI_D_ERROR, "TcpInput: received a checksum error packet\n"));
+      goto DISCARD;
+    }
   }
 
   if (TCP_FLG_ON (Head->Flag, TCP_FLG_SYN)) {
@@ -1218,6 +1307,16 @@ TcpInput (
     Tcb->DupAck = 0;
   }
 
+  //
+  // Update the SACK scoreboard before the fast recovery uses it.
+  //
+  if (TCP_FLG_ON (Option.Flag, TCP_OPTION_RCVD_SACK) &&
+      TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_RCVD_SACK))
+  {
+
+    TcpSackUpdate (Tcb, &Option);
+  }
+
   //
   // Congestion avoidance, fast recovery and fast retransmission.
   //
@@ -1251,6 +1350,10 @@ TcpInput (
     TcpAdjustSndQue (Tcb, Seg->Ack);
     Tcb->SndUna = Seg->Ack;
 
+    if (TCP_SEQ_LT (Tcb->SackHigh, Tcb->SndUna)) {
+      Tcb->SackHigh = Tcb->SndUna;
+    }
+
     if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_URG) &&
         TCP_SEQ_LT (Tcb->SndUp, Seg->Ack))
     {
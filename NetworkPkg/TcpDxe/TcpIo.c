@@ -38,8 +38,20 @@ TcpRxCallback (
   IN VOID                             *Context    OPTIONAL
   )
 {
+  TCP_SERVICE_DATA  *TcpServiceData;
+  BOOLEAN           ChecksumValid;
+
   if (EFI_SUCCESS == Status) {
-    TcpInput (Pkt, &NetSession->Source, &NetSession->Dest, NetSession->IpVersion);
+    //
+    // The device only validates the checksum of unfragmented datagrams.
+    //
+    TcpServiceData = (TCP_SERVICE_DATA *) Context;
+    ChecksumValid  = (BOOLEAN) ((TcpServiceData != NULL) &&
+                                TcpServiceData->RxChecksumOffload &&
+                                (NetSession->IpVersion == IP_VERSION_4) &&
+                                !IP4_IS_FRAGMENTED (NetSession->IpHdr.Ip4Hdr->Fragmentation));
+
+    TcpInput (Pkt, &NetSession->Source, &NetSession->Dest, NetSession->IpVersion, ChecksumValid);
   } else {
     TcpIcmpInput (
       Pkt,
@@ -80,6 +80,9 @@ TcpInitTcbLocal (
   Tcb->SndWl2 = Tcb->Iss;
   Tcb->SndWnd = 536;
 
+  Tcb->Recover  = Tcb->Iss;
+  Tcb->SackHigh = Tcb->Iss;
+
   Tcb->RcvWnd = GET_RCV_BUFFSIZE (Tcb->Sk);
 
   //
@@ -170,6 +173,35 @@ TcpInitTcbPeer (
     //
     Tcb->SndMss -= TCP_OPTION_TS_ALIGNED_LEN;
   }
+
+  if (TCP_FLG_ON (Opt->Flag, TCP_OPTION_RCVD_SACK_PERM) && !TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK)) {
+
+    TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_RCVD_SACK);
+  }
+}
+
+/**
+  Forget what the peer has SACKed. RFC2018 allows the receiver to
+  discard data it SACKed, so the scoreboard is only a hint and must
+  be dropped when the retransmission timer expires.
+
+  @param[in, out]  Tcb    Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpSackReset (
+  IN OUT TCP_CB *Tcb
+  )
+{
+  LIST_ENTRY      *Entry;
+  NET_BUF         *Nbuf;
+
+  NET_LIST_FOR_EACH (Entry, &Tcb->SndQue) {
+    Nbuf = NET_LIST_USER_STRUCT (Entry, NET_BUF, List);
+    TCPSEG_NETBUF (Nbuf)->Sacked = FALSE;
+  }
+
+  Tcb->SackHigh = Tcb->SndUna;
 }
 
 /**
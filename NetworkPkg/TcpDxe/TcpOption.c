@@ -165,6 +165,28 @@ TcpSynBuildOption (
     TcpPutUint32 (Data, TCP_OPTION_WS_FAST | TcpComputeScale (Tcb));
   }
 
+  //
+  // Build SACK permitted option, only when configured
+  // to use SACK, and either we are doing active open
+  // or we have received SACK permitted option from peer.
+  //
+  if (!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK) &&
+      (!TCP_FLG_ON (TCPSEG_NETBUF (Nbuf)->Flag, TCP_FLG_ACK) ||
+        TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_RCVD_SACK))
+      ) {
+
+    Data = NetbufAllocSpace (
+             Nbuf,
+             TCP_OPTION_SACK_PERM_ALIGNED_LEN,
+             NET_BUF_HEAD
+             );
+
+    ASSERT (Data != NULL);
+
+    Len += TCP_OPTION_SACK_PERM_ALIGNED_LEN;
+    TcpPutUint32 (Data, TCP_OPTION_SACK_PERM_FAST);
+  }
+
   //
   // Build the MSS option.
   //
@@ -177,6 +199,102 @@ TcpSynBuildOption (
   return Len;
 }
 
+/**
+  Build the SACK option, reporting the data queued for reassembly.
+
+  Adjacent segments on the RcvQue are merged into a block. As RFC2018
+  requires, the block holding the segment received last comes first,
+  the others follow in sequence order as long as there is room.
+
+  @param[in]  Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Nbuf    Pointer to the buffer to store the options.
+  @param[in]  Room    The option space left in the segment.
+
+  @return             The length of the SACK option, 0 if none is built.
+
+**/
+UINT16
+TcpSackBuildOption (
+  IN TCP_CB  *Tcb,
+  IN NET_BUF *Nbuf,
+  IN UINT16  Room
+  )
+{
+  TCP_SACK_BLOCK  Block[TCP_OPTION_MAX_SACK_BLOCK];
+  UINT32          Max;
+  UINT32          Num;
+  UINT32          Index;
+  LIST_ENTRY      *Entry;
+  TCP_SEG         *Seg;
+  TCP_SEQNO       Left;
+  TCP_SEQNO       Right;
+  UINT8           *Data;
+  UINT16          Len;
+
+  if (Room < 4 + TCP_OPTION_SACK_BLOCK_LEN) {
+    return 0;
+  }
+
+  Max   = MIN ((Room - 4) / TCP_OPTION_SACK_BLOCK_LEN, TCP_OPTION_MAX_SACK_BLOCK);
+  Num   = 0;
+  Entry = Tcb->RcvQue.ForwardLink;
+
+  while (Entry != &Tcb->RcvQue) {
+    Seg   = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (Entry, NET_BUF, List));
+    Left  = Seg->Seq;
+    Right = Seg->End;
+
+    //
+    // The RcvQue is sorted and free of overlaps, merge the
+    // segments that follow each other without a gap.
+    //
+    for (Entry = Entry->ForwardLink; Entry != &Tcb->RcvQue; Entry = Entry->ForwardLink) {
+      Seg = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (Entry, NET_BUF, List));
+      if (Seg->Seq != Right) {
+        break;
+      }
+
+      Right = Seg->End;
+    }
+
+    if (TCP_SEQ_LEQ (Right, Tcb->RcvNxt)) {
+      continue;
+    }
+
+    if (TCP_SEQ_LEQ (Left, Tcb->SackRecent) && TCP_SEQ_LT (Tcb->SackRecent, Right)) {
+
+      Num = MIN (Num + 1, Max);
+      for (Index = Num - 1; Index > 0; Index--) {
+        Block[Index] = Block[Index - 1];
+      }
+      Block[0].Left  = Left;
+      Block[0].Right = Right;
+
+    } else if (Num < Max) {
+
+      Block[Num].Left  = Left;
+      Block[Num].Right = Right;
+      Num++;
+    }
+  }
+
+  if (Num == 0) {
+    return 0;
+  }
+
+  Len  = (UINT16) (4 + Num * TCP_OPTION_SACK_BLOCK_LEN);
+  Data = NetbufAllocSpace (Nbuf, Len, NET_BUF_HEAD);
+  ASSERT (Data != NULL);
+
+  TcpPutUint32 (Data, TCP_OPTION_SACK_FAST | (Len - 2));
+  for (Index = 0; Index < Num; Index++) {
+    TcpPutUint32 (Data + 4 + Index * TCP_OPTION_SACK_BLOCK_LEN, Block[Index].Left);
+    TcpPutUint32 (Data + 8 + Index * TCP_OPTION_SACK_BLOCK_LEN, Block[Index].Right);
+  }
+
+  return Len;
+}
+
 /**
   Build the TCP option in synchronized states.
 
@@ -194,9 +312,11 @@ TcpBuildOption (
 {
   UINT8   *Data;
   UINT16  Len;
+  UINT32  DataLen;
 
   ASSERT ((Tcb != NULL) && (Nbuf != NULL) && (Nbuf->Tcp == NULL));
-  Len = 0;
+  Len     = 0;
+  DataLen = Nbuf->TotalSize;
 
   //
   // Build the Timestamp option.
@@ -219,6 +339,20 @@ TcpBuildOption (
     TcpPutUint32 (Data + 8, Tcb->TsRecent);
   }
 
+  //
+  // Build the SACK option if data is queued for reassembly.
+  // It only goes with segments carrying no data, a full-sized
+  // one leaves no room for it.
+  //
+  if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_RCVD_SACK) &&
+      (DataLen == 0) &&
+      !IsListEmpty (&Tcb->RcvQue) &&
+      !TCP_FLG_ON (TCPSEG_NETBUF (Nbuf)->Flag, TCP_FLG_RST)
+      ) {
+
+    Len = (UINT16) (Len + TcpSackBuildOption (Tcb, Nbuf, (UINT16) (TCP_OPTION_MAX_LEN - Len)));
+  }
+
   return Len;
 }
 
@@ -244,10 +378,12 @@ TcpParseOption (
   UINT8 Cur;
   UINT8 Type;
   UINT8 Len;
+  UINT8 Index;
 
   ASSERT ((Tcp != NULL) && (Option != NULL));
 
-  Option->Flag  = 0;
+  Option->Flag    = 0;
+  Option->SackNum = 0;
 
   TotalLen      = (UINT8) ((Tcp->HeadLen << 2) - sizeof (TCP_HEAD));
   if (TotalLen <= 0) {
@@ -319,6 +455,39 @@ TcpParseOption (
       Cur += TCP_OPTION_TS_LEN;
       break;
 
+    case TCP_OPTION_SACK_PERM:
+      Len = Head[Cur + 1];
+
+      if ((Len != TCP_OPTION_SACK_PERM_LEN) || (TotalLen - Cur < TCP_OPTION_SACK_PERM_LEN)) {
+
+        return -1;
+      }
+
+      TCP_SET_FLG (Option->Flag, TCP_OPTION_RCVD_SACK_PERM);
+
+      Cur += TCP_OPTION_SACK_PERM_LEN;
+      break;
+
+    case TCP_OPTION_SACK:
+      Len = Head[Cur + 1];
+
+      if ((Len < 2 + TCP_OPTION_SACK_BLOCK_LEN) ||
+          ((Len - 2) % TCP_OPTION_SACK_BLOCK_LEN != 0) ||
+          (TotalLen - Cur < Len)) {
+
+        return -1;
+      }
+
+      Option->SackNum = (UINT8) MIN ((Len - 2) / TCP_OPTION_SACK_BLOCK_LEN, TCP_OPTION_MAX_SACK_BLOCK);
+      for (Index = 0; Index < Option->SackNum; Index++) {
+        Option->Sack[Index].Left  = TcpGetUint32 (&Head[Cur + 2 + Index * TCP_OPTION_SACK_BLOCK_LEN]);
+        Option->Sack[Index].Right = TcpGetUint32 (&Head[Cur + 6 + Index * TCP_OPTION_SACK_BLOCK_LEN]);
+      }
+      TCP_SET_FLG (Option->Flag, TCP_OPTION_RCVD_SACK);
+
+      Cur = (UINT8) (Cur + Len);
+      break;
+
     case TCP_OPTION_NOP:
       Cur++;
       break;
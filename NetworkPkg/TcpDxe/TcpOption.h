@@ -23,12 +23,18 @@
 #define TCP_OPTION_NOP             1  ///< No-Option.
 #define TCP_OPTION_MSS             2  ///< Maximum Segment Size
 #define TCP_OPTION_WS              3  ///< Window scale
+#define TCP_OPTION_SACK_PERM       4  ///< SACK permitted
+#define TCP_OPTION_SACK            5  ///< Selective acknowledgment
 #define TCP_OPTION_TS              8  ///< Timestamp
 #define TCP_OPTION_MSS_LEN         4  ///< Length of MSS option
 #define TCP_OPTION_WS_LEN          3  ///< Length of window scale option
+#define TCP_OPTION_SACK_PERM_LEN   2  ///< Length of SACK permitted option
+#define TCP_OPTION_SACK_BLOCK_LEN  8  ///< Length of each block in a SACK option
 #define TCP_OPTION_TS_LEN          10 ///< Length of timestamp option
 #define TCP_OPTION_WS_ALIGNED_LEN  4  ///< Length of window scale option, aligned
+#define TCP_OPTION_SACK_PERM_ALIGNED_LEN 4 ///< Length of SACK permitted option, aligned
 #define TCP_OPTION_TS_ALIGNED_LEN  12 ///< Length of timestamp option, aligned
+#define TCP_OPTION_MAX_LEN         40 ///< Max length of the option field
 
 //
 // recommend format of timestamp window scale
@@ -45,25 +51,47 @@
 
 #define TCP_OPTION_MSS_FAST  ((TCP_OPTION_MSS << 24) | (TCP_OPTION_MSS_LEN << 16))
 
+#define TCP_OPTION_SACK_PERM_FAST ((TCP_OPTION_NOP << 24)       | \
+                                   (TCP_OPTION_NOP << 16)       | \
+                                   (TCP_OPTION_SACK_PERM << 8)  | \
+                                   (TCP_OPTION_SACK_PERM_LEN))
+
+#define TCP_OPTION_SACK_FAST ((TCP_OPTION_NOP << 24) | \
+                              (TCP_OPTION_NOP << 16) | \
+                              (TCP_OPTION_SACK << 8))
+
 //
 // Other misc definations
 //
 #define TCP_OPTION_RCVD_MSS        0x01
 #define TCP_OPTION_RCVD_WS         0x02
 #define TCP_OPTION_RCVD_TS         0x04
+#define TCP_OPTION_RCVD_SACK_PERM  0x08
+#define TCP_OPTION_RCVD_SACK       0x10
 #define TCP_OPTION_MAX_WS          14      ///< Maxium window scale value
 #define TCP_OPTION_MAX_WIN         0xffff  ///< Max window size in TCP header
+#define TCP_OPTION_MAX_SACK_BLOCK  4       ///< Max blocks in a SACK option
+
+///
+/// A block of data received out of order, as carried by a SACK option.
+///
+typedef struct _TCP_SACK_BLOCK {
+  TCP_SEQNO Left;   ///< First sequence number of the block.
+  TCP_SEQNO Right;  ///< The sequence of the last byte + 1.
+} TCP_SACK_BLOCK;
 
 ///
 /// The structure to store the parse option value.
 /// ParseOption only parses the options, doesn't process them.
 ///
 typedef struct _TCP_OPTION {
-  UINT8   Flag;     ///< Flag such as TCP_OPTION_RCVD_MSS
-  UINT8   WndScale; ///< The WndScale received
-  UINT16  Mss;      ///< The Mss received
-  UINT32  TSVal;    ///< The TSVal field in a timestamp option
-  UINT32  TSEcr;    ///< The TSEcr field in a timestamp option
+  UINT8           Flag;     ///< Flag such as TCP_OPTION_RCVD_MSS
+  UINT8           WndScale; ///< The WndScale received
+  UINT16          Mss;      ///< The Mss received
+  UINT32          TSVal;    ///< The TSVal field in a timestamp option
+  UINT32          TSEcr;    ///< The TSEcr field in a timestamp option
+  UINT8           SackNum;  ///< The number of blocks in a SACK option
+  TCP_SACK_BLOCK  Sack[TCP_OPTION_MAX_SACK_BLOCK]; ///< The blocks of a SACK option
 } TCP_OPTION;
 
 /**
@@ -94,6 +122,23 @@ TcpSynBuildOption (
   IN NET_BUF *Nbuf
   );
 
+/**
+  Build the SACK option, reporting the data queued for reassembly.
+
+  @param[in]  Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Nbuf    Pointer to the buffer to store the options.
+  @param[in]  Room    The option space left in the segment.
+
+  @return             The length of the SACK option, 0 if none is built.
+
+**/
+UINT16
+TcpSackBuildOption (
+  IN TCP_CB  *Tcb,
+  IN NET_BUF *Nbuf,
+  IN UINT16  Room
+  );
+
 /**
   Build the TCP option in synchronized states.
 
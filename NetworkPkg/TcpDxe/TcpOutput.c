@@ -286,11 +286,12 @@ TcpTransmitSegment (
   IN     NET_BUF *Nbuf
   )
 {
-  UINT16    Len;
-  TCP_HEAD  *Head;
-  TCP_SEG   *Seg;
-  BOOLEAN   Syn;
-  UINT32    DataLen;
+  UINT16            Len;
+  TCP_HEAD          *Head;
+  TCP_SEG           *Seg;
+  BOOLEAN           Syn;
+  UINT32            DataLen;
+  TCP_SERVICE_DATA  *TcpService;
 
   ASSERT ((Nbuf != NULL) && (Nbuf->Tcp == NULL) && (TcpVerifySegment (Nbuf) != 0));
 
@@ -373,7 +374,15 @@ TcpTransmitSegment (
 
   Head->Flag      = Seg->Flag;
   Head->Urg       = NTOHS (Seg->Urg);
-  Head->Checksum  = TcpChecksum (Nbuf, Tcb->HeadSum);
+
+  //
+  // Leave the checksum to the device if the segment goes out unfragmented.
+  //
+  TcpService = ((TCP_PROTO_DATA *) Tcb->Sk->ProtoReserved)->TcpService;
+  if (!TcpService->TxChecksumOffload ||
+      (Nbuf->TotalSize > (UINT32) Tcb->RcvMss + sizeof (TCP_HEAD))) {
+    Head->Checksum = TcpChecksum (Nbuf, Tcb->HeadSum);
+  }
 
   //
   // Update the TCP session's control information.
@@ -708,6 +717,87 @@ OnError:
   return -1;
 }
 
+/**
+  Retransmit the first hole the SACK scoreboard deems lost, much as
+  NextSeg () of RFC6675 does. A hole is deemed lost once more than two
+  full-sized segments above it have been SACKed. Each hole is only
+  retransmitted once during a fast recovery, SackRxt records how far
+  the retransmission has got.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+
+  @retval TRUE    A hole was retransmitted.
+  @retval FALSE   No hole to retransmit, the send window does not cover
+                  it, or the retransmission failed.
+
+**/
+BOOLEAN
+TcpSackRetransmit (
+  IN OUT TCP_CB *Tcb
+  )
+{
+  LIST_ENTRY      *Entry;
+  TCP_SEG         *Seg;
+  UINT32          SackedAbove;
+
+  if (!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_RCVD_SACK) ||
+      TCP_SEQ_LEQ (Tcb->SackHigh, Tcb->SackRxt)
+      ) {
+
+    return FALSE;
+  }
+
+  SackedAbove = 0;
+  NET_LIST_FOR_EACH (Entry, &Tcb->SndQue) {
+    Seg = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (Entry, NET_BUF, List));
+
+    if (Seg->Sacked && TCP_SEQ_GEQ (Seg->Seq, Tcb->SackRxt)) {
+      SackedAbove += TCP_SUB_SEQ (Seg->End, Seg->Seq);
+    }
+  }
+
+  NET_LIST_FOR_EACH (Entry, &Tcb->SndQue) {
+    Seg = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (Entry, NET_BUF, List));
+
+    if (TCP_SEQ_LT (Seg->Seq, Tcb->SackRxt)) {
+      continue;
+    }
+
+    if (SackedAbove <= 2 * (UINT32) Tcb->SndMss) {
+      break;
+    }
+
+    if (Seg->Sacked) {
+      SackedAbove -= TCP_SUB_SEQ (Seg->End, Seg->Seq);
+      continue;
+    }
+
+    //
+    // TcpRetransmit () sends nothing, yet succeeds, when the send window
+    // does not reach the hole. Leave the hole for a later ACK instead.
+    //
+    if (TCP_SEQ_LT (Tcb->SndWl2 + Tcb->SndWnd, Seg->End)) {
+      break;
+    }
+
+    DEBUG (
+      (EFI_D_INFO,
+      "TcpSackRetransmit: retransmit hole at %d for TCB %p\n",
+      Seg->Seq,
+      Tcb)
+      );
+
+    if (TcpRetransmit (Tcb, Seg->Seq) != 0) {
+      break;
+    }
+
+    Tcb->SackRxt = Seg->End;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
 /**
   Verify that all the segments in SndQue are in good shape.
 
@@ -78,6 +78,8 @@
 #define TCP_CTRL_TIMER_ON        0x1000 ///< At least one of the timer is on.
 #define TCP_CTRL_RTT_ON          0x2000 ///< The RTT measurement is on.
 #define TCP_CTRL_ACK_NOW         0x4000 ///< Send the ACK now, don't delay.
+#define TCP_CTRL_NO_SACK         0x8000 ///< Disable selective ACK option.
+#define TCP_CTRL_RCVD_SACK       0x10000 ///< Received a SACK permitted option in syn.
 
 //
 // Timer related values
@@ -223,6 +225,7 @@ typedef struct _TCP_SEG {
   UINT8     Flag; ///< TCP header flags.
   UINT16    Urg;  ///< Valid if URG flag is set.
   UINT32    Wnd;  ///< TCP window size field.
+  BOOLEAN   Sacked; ///< SACKed by the peer, only valid on the SndQue.
 } TCP_SEG;
 
 ///
@@ -315,6 +318,13 @@ struct _TCP_CONTROL_BLOCK {
   UINT8             LossTimes;    ///< Number of retxmit timeouts in a row.
   TCP_SEQNO         LossRecover;  ///< Recover point for retxmit.
 
+  //
+  // RFC2018 and RFC6675 variables, about selective acknowledgment.
+  //
+  TCP_SEQNO         SackRecent;   ///< Seq of the last out-of-order segment received.
+  TCP_SEQNO         SackHigh;     ///< Highest sequence SACKed by the peer + 1.
+  TCP_SEQNO         SackRxt;      ///< Holes from here on are not retxmitted yet.
+
   //
   // configuration parameters, for EFI_TCP4_PROTOCOL specification
   //
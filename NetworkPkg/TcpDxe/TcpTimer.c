@@ -208,6 +208,9 @@ TcpRexmitTimeout (
 
   Tcb->CWnd         = Tcb->SndMss;
   Tcb->LossRecover  = Tcb->SndNxt;
+  Tcb->Recover      = Tcb->SndNxt;
+
+  TcpSackReset (Tcb);
 
   Tcb->LossTimes++;
   if ((Tcb->LossTimes > Tcb->MaxRexmit) && !TCP_TIMER_ON (Tcb->EnabledTimer, TCP_TIMER_CONNECT)) {